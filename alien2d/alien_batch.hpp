@@ -0,0 +1,875 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_BATCH_HPP
+#define ALIEN_BATCH_HPP
+
+#include <algorithm>
+
+#include "base.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "quadtree.hpp"
+#include "slot_map.hpp"
+
+namespace Alien {
+using SpriteHandle = Handle<struct SpriteTag>;
+
+struct SpriteInstance {
+  Math::Vec2 position{0.0f, 0.0f};
+  f32 rotation{0.0f};
+  // Size of the quad in pixels
+  Math::Vec2 scale{1.0f, 1.0f};
+  // Normalized, (0.5, 0.5) rotates around the center
+  Math::Vec2 pivot{0.5f, 0.5f};
+  // u0, v0, u1, v1
+  Math::Vec4 uvRect{0.0f, 0.0f, 1.0f, 1.0f};
+  // RGBA8, red in the lowest byte
+  u32 color{0xFFFFFFFF};
+};
+
+// Read-only view of the sprite columns starting at some sprite.
+struct SpriteColumns {
+  const f32 *x, *y, *rotation, *scaleX, *scaleY, *pivotX, *pivotY;
+  const f32 *u0, *v0, *u1, *v1;
+  const u32 *color;
+
+  SpriteColumns offset(u32 first) const {
+    return {x + first,      y + first,      rotation + first, scaleX + first,
+            scaleY + first, pivotX + first, pivotY + first,   u0 + first,
+            v0 + first,     u1 + first,     v1 + first,       color + first};
+  }
+};
+
+// Output of the quad kernel. The streams are not interleaved, every sprite
+// writes 4 corners: 8 positions (13.3 fixed point pixels), 8 unorm16
+// texture coordinates and 4 RGBA8 colors, 48 bytes instead of 80 with
+// floats. Corners are in order top-left, top-right, bottom-right,
+// bottom-left of the unrotated quad.
+struct SpriteVertexStreams {
+  i16 *positions;
+  u16 *texCoords;
+  u32 *colors;
+
+  static constexpr u32 Positions = 8;
+  static constexpr u32 TexCoords = 8;
+  static constexpr u32 Colors = 4;
+
+  // One vertex of each stream, they describe the attribute layouts
+  struct Position {
+    i16 position[2];
+  };
+  struct TexCoord {
+    u16 texCoord[2];
+  };
+  struct Color {
+    u32 color;
+  };
+};
+
+template <>
+struct VertexLayout<SpriteVertexStreams::Position> {
+  static constexpr VertexAttribute attributes[] = {ALIEN_VERTEX_ATTRIBUTE(
+      SpriteVertexStreams::Position, position, "POS", e_Short2)};
+};
+
+template <>
+struct VertexLayout<SpriteVertexStreams::TexCoord> {
+  static constexpr VertexAttribute attributes[] = {ALIEN_VERTEX_ATTRIBUTE(
+      SpriteVertexStreams::TexCoord, texCoord, "TEXCOORD", e_UShort2Norm)};
+};
+
+template <>
+struct VertexLayout<SpriteVertexStreams::Color> {
+  static constexpr VertexAttribute attributes[] = {ALIEN_VERTEX_ATTRIBUTE(
+      SpriteVertexStreams::Color, color, "COL", e_UByte4Norm)};
+};
+
+// One sprite for vertex pulling, 32 bytes instead of the 48 bytes of four
+// packed vertices. The vertex shader reads it from a texture buffer and
+// builds the corners from gl_VertexID, so there is no index buffer and no
+// attribute setup.
+struct SpriteRecord {
+  f32 x, y, rotation;
+  // 12.4 fixed point pixels, negative values mirror the sprite
+  i16 width, height;
+  // unorm16
+  u16 pivotX, pivotY;
+  u16 u0, v0, u1, v1;
+  u32 color;
+};
+static_assert(sizeof(SpriteRecord) == 32);
+
+namespace Kernel {
+// Records are a plain repack of the columns, memory bound even when it is
+// scalar.
+inline void pack_sprite_records(const SpriteColumns &in, u32 count,
+                                SpriteRecord *out) {
+  auto pack_size = [](f32 pixels) {
+    return (i16)std::lrint(
+        std::fmin(std::fmax(pixels * 16.0f, -32768.0f), 32767.0f));
+  };
+  for (u32 i = 0; i < count; ++i) {
+    auto &r = out[i];
+    r.x = in.x[i];
+    r.y = in.y[i];
+    r.rotation = in.rotation[i];
+    r.width = pack_size(in.scaleX[i]);
+    r.height = pack_size(in.scaleY[i]);
+    r.pivotX = Primitive::pack_unorm16(in.pivotX[i]);
+    r.pivotY = Primitive::pack_unorm16(in.pivotY[i]);
+    r.u0 = Primitive::pack_unorm16(in.u0[i]);
+    r.v0 = Primitive::pack_unorm16(in.v0[i]);
+    r.u1 = Primitive::pack_unorm16(in.u1[i]);
+    r.v1 = Primitive::pack_unorm16(in.v1[i]);
+    r.color = in.color[i];
+  }
+}
+
+// Scalar reference of the quad kernel, also used for the tails.
+inline void generate_sprite_quads_scalar(const SpriteColumns &in, u32 count,
+                                         SpriteVertexStreams out) {
+  for (u32 i = 0; i < count; ++i) {
+    f32 s, c;
+    Math::fast_sincos(in.rotation[i], s, c);
+
+    auto lx0 = -in.pivotX[i] * in.scaleX[i];
+    auto lx1 = (1.0f - in.pivotX[i]) * in.scaleX[i];
+    auto ly0 = -in.pivotY[i] * in.scaleY[i];
+    auto ly1 = (1.0f - in.pivotY[i]) * in.scaleY[i];
+    const f32 lx[4] = {lx0, lx1, lx1, lx0};
+    const f32 ly[4] = {ly0, ly0, ly1, ly1};
+
+    auto p = out.positions + i * SpriteVertexStreams::Positions;
+    for (u32 k = 0; k < 4; ++k) {
+      p[k * 2 + 0] =
+          Primitive::pack_position(in.x[i] + (c * lx[k] - s * ly[k]));
+      p[k * 2 + 1] =
+          Primitive::pack_position(in.y[i] + (s * lx[k] + c * ly[k]));
+    }
+
+    auto u0 = Primitive::pack_unorm16(in.u0[i]);
+    auto v0 = Primitive::pack_unorm16(in.v0[i]);
+    auto u1 = Primitive::pack_unorm16(in.u1[i]);
+    auto v1 = Primitive::pack_unorm16(in.v1[i]);
+    auto t = out.texCoords + i * SpriteVertexStreams::TexCoords;
+    t[0] = u0, t[1] = v0, t[2] = u1, t[3] = v0;
+    t[4] = u1, t[5] = v1, t[6] = u0, t[7] = v1;
+
+    auto col = out.colors + i * SpriteVertexStreams::Colors;
+    col[0] = col[1] = col[2] = col[3] = in.color[i];
+  }
+}
+
+#if defined(ALIEN_MATH_SSE2)
+inline void sincos_sse2(__m128 x, __m128 &s, __m128 &c) {
+  using namespace Math::SinCos;
+  auto q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TwoOverPi)));
+  auto qf = _mm_cvtepi32_ps(q);
+  auto r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(PiOver2A)));
+  r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PiOver2B)));
+  r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PiOver2C)));
+  auto r2 = _mm_mul_ps(r, r);
+
+  auto sp = _mm_add_ps(_mm_set1_ps(S2), _mm_mul_ps(r2, _mm_set1_ps(S3)));
+  sp = _mm_add_ps(_mm_set1_ps(S1), _mm_mul_ps(r2, sp));
+  auto sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+
+  auto cp = _mm_add_ps(_mm_set1_ps(C2), _mm_mul_ps(r2, _mm_set1_ps(C3)));
+  cp = _mm_add_ps(_mm_set1_ps(C1), _mm_mul_ps(r2, cp));
+  auto cr = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2));
+  cr = _mm_add_ps(cr, _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+
+  auto one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+  auto swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+  auto sinSign = _mm_slli_epi32(_mm_and_si128(q, two), 30);
+  auto cosSign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30);
+  auto sv = _mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr));
+  auto cv = _mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr));
+  s = _mm_xor_ps(sv, _mm_castsi128_ps(sinSign));
+  c = _mm_xor_ps(cv, _mm_castsi128_ps(cosSign));
+}
+
+// Packing helpers, values are clamped before the conversion so the
+// results agree with the scalar kernel.
+inline __m128i scale_to_int_sse2(__m128 v, f32 scale, f32 lo, f32 hi) {
+  v = _mm_mul_ps(v, _mm_set1_ps(scale));
+  v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+  return _mm_cvtps_epi32(v);
+}
+
+inline __m128i pack_positions_sse2(__m128 a, __m128 b) {
+  return _mm_packs_epi32(
+      scale_to_int_sse2(a, Primitive::PositionScale, -32768.0f, 32767.0f),
+      scale_to_int_sse2(b, Primitive::PositionScale, -32768.0f, 32767.0f));
+}
+
+// There is no unsigned 32 -> 16 pack in SSE2, the values are biased into
+// the signed range and flipped back.
+inline __m128i pack_unorm16_sse2(__m128 a, __m128 b) {
+  auto bias = _mm_set1_epi32(32768);
+  auto ia = scale_to_int_sse2(a, Primitive::TexCoordScale, 0.0f, 65535.0f);
+  auto ib = scale_to_int_sse2(b, Primitive::TexCoordScale, 0.0f, 65535.0f);
+  auto packed =
+      _mm_packs_epi32(_mm_sub_epi32(ia, bias), _mm_sub_epi32(ib, bias));
+  return _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000));
+}
+#endif
+
+// Four sprites per iteration with SSE2, the scalar kernel elsewhere.
+inline void generate_sprite_quads_baseline(const SpriteColumns &in, u32 count,
+                                           SpriteVertexStreams out) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  auto one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= count; i += 4) {
+    auto x = _mm_loadu_ps(in.x + i);
+    auto y = _mm_loadu_ps(in.y + i);
+    auto sx = _mm_loadu_ps(in.scaleX + i);
+    auto sy = _mm_loadu_ps(in.scaleY + i);
+    auto px = _mm_loadu_ps(in.pivotX + i);
+    auto py = _mm_loadu_ps(in.pivotY + i);
+
+    __m128 s, c;
+    sincos_sse2(_mm_loadu_ps(in.rotation + i), s, c);
+
+    auto lx0 = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), px), sx);
+    auto lx1 = _mm_mul_ps(_mm_sub_ps(one, px), sx);
+    auto ly0 = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), py), sy);
+    auto ly1 = _mm_mul_ps(_mm_sub_ps(one, py), sy);
+
+    auto cx0 = _mm_mul_ps(c, lx0), cx1 = _mm_mul_ps(c, lx1);
+    auto sx0 = _mm_mul_ps(s, lx0), sx1 = _mm_mul_ps(s, lx1);
+    auto cy0 = _mm_mul_ps(c, ly0), cy1 = _mm_mul_ps(c, ly1);
+    auto sy0 = _mm_mul_ps(s, ly0), sy1 = _mm_mul_ps(s, ly1);
+
+    auto x0 = _mm_add_ps(x, _mm_sub_ps(cx0, sy0));
+    auto y0 = _mm_add_ps(y, _mm_add_ps(sx0, cy0));
+    auto x1 = _mm_add_ps(x, _mm_sub_ps(cx1, sy0));
+    auto y1 = _mm_add_ps(y, _mm_add_ps(sx1, cy0));
+    auto x2 = _mm_add_ps(x, _mm_sub_ps(cx1, sy1));
+    auto y2 = _mm_add_ps(y, _mm_add_ps(sx1, cy1));
+    auto x3 = _mm_add_ps(x, _mm_sub_ps(cx0, sy1));
+    auto y3 = _mm_add_ps(y, _mm_add_ps(sx0, cy1));
+    _MM_TRANSPOSE4_PS(x0, y0, x1, y1);
+    _MM_TRANSPOSE4_PS(x2, y2, x3, y3);
+
+    // Sprite k has its first four values in one register, the rest in the
+    // register of the second transpose
+    auto p = (__m128i *)(out.positions + i * 8);
+    _mm_storeu_si128(p + 0, pack_positions_sse2(x0, x2));
+    _mm_storeu_si128(p + 1, pack_positions_sse2(y0, y2));
+    _mm_storeu_si128(p + 2, pack_positions_sse2(x1, x3));
+    _mm_storeu_si128(p + 3, pack_positions_sse2(y1, y3));
+
+    auto u0 = _mm_loadu_ps(in.u0 + i), v0 = _mm_loadu_ps(in.v0 + i);
+    auto u1 = _mm_loadu_ps(in.u1 + i), v1 = _mm_loadu_ps(in.v1 + i);
+    auto ua = u0, va = v0, ub = u1, vb = v0;
+    auto uc = u1, vc = v1, ud = u0, vd = v1;
+    _MM_TRANSPOSE4_PS(ua, va, ub, vb);
+    _MM_TRANSPOSE4_PS(uc, vc, ud, vd);
+
+    auto t = (__m128i *)(out.texCoords + i * 8);
+    _mm_storeu_si128(t + 0, pack_unorm16_sse2(ua, uc));
+    _mm_storeu_si128(t + 1, pack_unorm16_sse2(va, vc));
+    _mm_storeu_si128(t + 2, pack_unorm16_sse2(ub, ud));
+    _mm_storeu_si128(t + 3, pack_unorm16_sse2(vb, vd));
+
+    auto col = _mm_loadu_si128((const __m128i *)(in.color + i));
+    auto dst = (__m128i *)(out.colors + i * 4);
+    _mm_storeu_si128(dst + 0, _mm_shuffle_epi32(col, _MM_SHUFFLE(0, 0, 0, 0)));
+    _mm_storeu_si128(dst + 1, _mm_shuffle_epi32(col, _MM_SHUFFLE(1, 1, 1, 1)));
+    _mm_storeu_si128(dst + 2, _mm_shuffle_epi32(col, _MM_SHUFFLE(2, 2, 2, 2)));
+    _mm_storeu_si128(dst + 3, _mm_shuffle_epi32(col, _MM_SHUFFLE(3, 3, 3, 3)));
+  }
+#endif
+
+  if (i < count)
+    generate_sprite_quads_scalar(
+        in.offset(i), count - i,
+        {out.positions + i * 8, out.texCoords + i * 8, out.colors + i * 4});
+}
+
+#if defined(ALIEN_CPU_X86)
+ALIEN_TARGET_AVX2 inline void sincos_avx2(__m256 x, __m256 &s, __m256 &c) {
+  using namespace Math::SinCos;
+  auto q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TwoOverPi)));
+  auto qf = _mm256_cvtepi32_ps(q);
+  auto r = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(PiOver2A)));
+  r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(PiOver2B)));
+  r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(PiOver2C)));
+  auto r2 = _mm256_mul_ps(r, r);
+
+  auto sp = _mm256_add_ps(_mm256_set1_ps(S2),
+                          _mm256_mul_ps(r2, _mm256_set1_ps(S3)));
+  sp = _mm256_add_ps(_mm256_set1_ps(S1), _mm256_mul_ps(r2, sp));
+  auto sr = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sp));
+
+  auto cp = _mm256_add_ps(_mm256_set1_ps(C2),
+                          _mm256_mul_ps(r2, _mm256_set1_ps(C3)));
+  cp = _mm256_add_ps(_mm256_set1_ps(C1), _mm256_mul_ps(r2, cp));
+  auto cr = _mm256_sub_ps(_mm256_set1_ps(1.0f),
+                          _mm256_mul_ps(_mm256_set1_ps(0.5f), r2));
+  cr = _mm256_add_ps(cr, _mm256_mul_ps(_mm256_mul_ps(r2, r2), cp));
+
+  // Odd quadrants swap sine and cosine, the sign comes from bit 1 of q
+  // for the sine and of q + 1 for the cosine.
+  auto one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+  auto swap = _mm256_castsi256_ps(
+      _mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+  auto sinSign = _mm256_slli_epi32(_mm256_and_si256(q, two), 30);
+  auto cosSign =
+      _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), two), 30);
+  s = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap),
+                    _mm256_castsi256_ps(sinSign));
+  c = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap),
+                    _mm256_castsi256_ps(cosSign));
+}
+
+// Rows r[0..7] become columns, r[j] holds element j of every input row.
+ALIEN_TARGET_AVX2 inline void transpose8_avx2(__m256 r[8]) {
+  auto t0 = _mm256_unpacklo_ps(r[0], r[1]);
+  auto t1 = _mm256_unpackhi_ps(r[0], r[1]);
+  auto t2 = _mm256_unpacklo_ps(r[2], r[3]);
+  auto t3 = _mm256_unpackhi_ps(r[2], r[3]);
+  auto t4 = _mm256_unpacklo_ps(r[4], r[5]);
+  auto t5 = _mm256_unpackhi_ps(r[4], r[5]);
+  auto t6 = _mm256_unpacklo_ps(r[6], r[7]);
+  auto t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+  auto u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  auto u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  auto u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  auto u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  auto u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  auto u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  auto u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  auto u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+  r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+  r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+  r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+  r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+  r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+  r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+  r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+  r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+ALIEN_TARGET_AVX2 inline __m256i scale_to_int_avx2(__m256 v, f32 scale,
+                                                  f32 lo, f32 hi) {
+  v = _mm256_mul_ps(v, _mm256_set1_ps(scale));
+  v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(lo)), _mm256_set1_ps(hi));
+  return _mm256_cvtps_epi32(v);
+}
+
+// a and b hold one sprite each, the packs work per 128-bit lane so the
+// 64-bit blocks are put back in sprite order.
+ALIEN_TARGET_AVX2 inline __m256i pack_positions_avx2(__m256 a, __m256 b) {
+  auto packed = _mm256_packs_epi32(
+      scale_to_int_avx2(a, Primitive::PositionScale, -32768.0f, 32767.0f),
+      scale_to_int_avx2(b, Primitive::PositionScale, -32768.0f, 32767.0f));
+  return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+ALIEN_TARGET_AVX2 inline __m256i pack_unorm16_avx2(__m256 a, __m256 b) {
+  auto packed = _mm256_packus_epi32(
+      scale_to_int_avx2(a, Primitive::TexCoordScale, 0.0f, 65535.0f),
+      scale_to_int_avx2(b, Primitive::TexCoordScale, 0.0f, 65535.0f));
+  return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Eight sprites per iteration. Corner math is done in SoA form and the
+// results are transposed so every sprite's corners are stored with one
+// 32-byte store per stream.
+ALIEN_TARGET_AVX2 inline void generate_sprite_quads_avx2(
+    const SpriteColumns &in, u32 count, SpriteVertexStreams out) {
+  u32 i = 0;
+  auto one = _mm256_set1_ps(1.0f);
+  for (; i + 8 <= count; i += 8) {
+    auto x = _mm256_loadu_ps(in.x + i);
+    auto y = _mm256_loadu_ps(in.y + i);
+    auto sx = _mm256_loadu_ps(in.scaleX + i);
+    auto sy = _mm256_loadu_ps(in.scaleY + i);
+    auto px = _mm256_loadu_ps(in.pivotX + i);
+    auto py = _mm256_loadu_ps(in.pivotY + i);
+
+    __m256 s, c;
+    sincos_avx2(_mm256_loadu_ps(in.rotation + i), s, c);
+
+    // Local corner offsets relative to the pivot
+    auto lx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), px), sx);
+    auto lx1 = _mm256_mul_ps(_mm256_sub_ps(one, px), sx);
+    auto ly0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), py), sy);
+    auto ly1 = _mm256_mul_ps(_mm256_sub_ps(one, py), sy);
+
+    auto cx0 = _mm256_mul_ps(c, lx0), cx1 = _mm256_mul_ps(c, lx1);
+    auto sx0 = _mm256_mul_ps(s, lx0), sx1 = _mm256_mul_ps(s, lx1);
+    auto cy0 = _mm256_mul_ps(c, ly0), cy1 = _mm256_mul_ps(c, ly1);
+    auto sy0 = _mm256_mul_ps(s, ly0), sy1 = _mm256_mul_ps(s, ly1);
+
+    __m256 p[8] = {
+        _mm256_add_ps(x, _mm256_sub_ps(cx0, sy0)),
+        _mm256_add_ps(y, _mm256_add_ps(sx0, cy0)),
+        _mm256_add_ps(x, _mm256_sub_ps(cx1, sy0)),
+        _mm256_add_ps(y, _mm256_add_ps(sx1, cy0)),
+        _mm256_add_ps(x, _mm256_sub_ps(cx1, sy1)),
+        _mm256_add_ps(y, _mm256_add_ps(sx1, cy1)),
+        _mm256_add_ps(x, _mm256_sub_ps(cx0, sy1)),
+        _mm256_add_ps(y, _mm256_add_ps(sx0, cy1)),
+    };
+    transpose8_avx2(p);
+    auto dstPositions = (__m256i *)(out.positions + i * 8);
+    for (u32 k = 0; k < 4; ++k)
+      _mm256_storeu_si256(dstPositions + k,
+                          pack_positions_avx2(p[k * 2], p[k * 2 + 1]));
+
+    auto u0 = _mm256_loadu_ps(in.u0 + i), v0 = _mm256_loadu_ps(in.v0 + i);
+    auto u1 = _mm256_loadu_ps(in.u1 + i), v1 = _mm256_loadu_ps(in.v1 + i);
+    __m256 t[8] = {u0, v0, u1, v0, u1, v1, u0, v1};
+    transpose8_avx2(t);
+    auto dstTexCoords = (__m256i *)(out.texCoords + i * 8);
+    for (u32 k = 0; k < 4; ++k)
+      _mm256_storeu_si256(dstTexCoords + k,
+                          pack_unorm16_avx2(t[k * 2], t[k * 2 + 1]));
+
+    // Every color is repeated for the four corners
+    auto col = _mm256_loadu_si256((const __m256i *)(in.color + i));
+    auto dst = (__m256i *)(out.colors + i * 4);
+    _mm256_storeu_si256(dst + 0, _mm256_permutevar8x32_epi32(
+                                     col, _mm256_setr_epi32(0, 0, 0, 0, 1, 1,
+                                                            1, 1)));
+    _mm256_storeu_si256(dst + 1, _mm256_permutevar8x32_epi32(
+                                     col, _mm256_setr_epi32(2, 2, 2, 2, 3, 3,
+                                                            3, 3)));
+    _mm256_storeu_si256(dst + 2, _mm256_permutevar8x32_epi32(
+                                     col, _mm256_setr_epi32(4, 4, 4, 4, 5, 5,
+                                                            5, 5)));
+    _mm256_storeu_si256(dst + 3, _mm256_permutevar8x32_epi32(
+                                     col, _mm256_setr_epi32(6, 6, 6, 6, 7, 7,
+                                                            7, 7)));
+  }
+
+  if (i < count)
+    generate_sprite_quads_baseline(
+        in.offset(i), count - i,
+        {out.positions + i * 8, out.texCoords + i * 8, out.colors + i * 4});
+}
+
+ALIEN_TARGET_AVX512 inline void sincos_avx512(__m512 x, __m512 &s,
+                                              __m512 &c) {
+  using namespace Math::SinCos;
+  auto q = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(TwoOverPi)));
+  auto qf = _mm512_cvtepi32_ps(q);
+  auto r = _mm512_sub_ps(x, _mm512_mul_ps(qf, _mm512_set1_ps(PiOver2A)));
+  r = _mm512_sub_ps(r, _mm512_mul_ps(qf, _mm512_set1_ps(PiOver2B)));
+  r = _mm512_sub_ps(r, _mm512_mul_ps(qf, _mm512_set1_ps(PiOver2C)));
+  auto r2 = _mm512_mul_ps(r, r);
+
+  auto sp = _mm512_add_ps(_mm512_set1_ps(S2),
+                          _mm512_mul_ps(r2, _mm512_set1_ps(S3)));
+  sp = _mm512_add_ps(_mm512_set1_ps(S1), _mm512_mul_ps(r2, sp));
+  auto sr = _mm512_add_ps(r, _mm512_mul_ps(_mm512_mul_ps(r, r2), sp));
+
+  auto cp = _mm512_add_ps(_mm512_set1_ps(C2),
+                          _mm512_mul_ps(r2, _mm512_set1_ps(C3)));
+  cp = _mm512_add_ps(_mm512_set1_ps(C1), _mm512_mul_ps(r2, cp));
+  auto cr = _mm512_sub_ps(_mm512_set1_ps(1.0f),
+                          _mm512_mul_ps(_mm512_set1_ps(0.5f), r2));
+  cr = _mm512_add_ps(cr, _mm512_mul_ps(_mm512_mul_ps(r2, r2), cp));
+
+  auto one = _mm512_set1_epi32(1), two = _mm512_set1_epi32(2);
+  auto swap = _mm512_test_epi32_mask(q, one);
+  auto sinSign = _mm512_slli_epi32(_mm512_and_si512(q, two), 30);
+  auto cosSign =
+      _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(q, one), two), 30);
+  s = _mm512_xor_ps(_mm512_mask_blend_ps(swap, sr, cr),
+                    _mm512_castsi512_ps(sinSign));
+  c = _mm512_xor_ps(_mm512_mask_blend_ps(swap, cr, sr),
+                    _mm512_castsi512_ps(cosSign));
+}
+
+// r[k] holds value k of 16 sprites, out[m] gets the 8 values of sprites
+// 2m and 2m + 1. Same in-lane steps as the 8x8 transpose, then two 128-bit
+// lane shuffles.
+ALIEN_TARGET_AVX512 inline void transpose16_avx512(const __m512 r[8],
+                                                   __m512 out[8]) {
+  auto t0 = _mm512_unpacklo_ps(r[0], r[1]);
+  auto t1 = _mm512_unpackhi_ps(r[0], r[1]);
+  auto t2 = _mm512_unpacklo_ps(r[2], r[3]);
+  auto t3 = _mm512_unpackhi_ps(r[2], r[3]);
+  auto t4 = _mm512_unpacklo_ps(r[4], r[5]);
+  auto t5 = _mm512_unpackhi_ps(r[4], r[5]);
+  auto t6 = _mm512_unpacklo_ps(r[6], r[7]);
+  auto t7 = _mm512_unpackhi_ps(r[6], r[7]);
+
+  // Lane l of u[k] holds values 0..3 of sprite 4l + k, u[k + 4] values 4..7
+  __m512 u[8] = {
+      _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm512_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm512_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2)),
+  };
+
+  // w[k] holds lanes 0, 1 of u[k] and u[k + 4], w[k + 4] lanes 2, 3
+  __m512 w[8];
+  for (u32 k = 0; k < 4; ++k) {
+    w[k] = _mm512_shuffle_f32x4(u[k], u[k + 4], _MM_SHUFFLE(1, 0, 1, 0));
+    w[k + 4] = _mm512_shuffle_f32x4(u[k], u[k + 4], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+
+  for (u32 half = 0; half < 2; ++half) {
+    auto w0 = w[half * 4], w1 = w[half * 4 + 1];
+    auto w2 = w[half * 4 + 2], w3 = w[half * 4 + 3];
+    out[half * 4 + 0] = _mm512_shuffle_f32x4(w0, w1, 0x88);
+    out[half * 4 + 1] = _mm512_shuffle_f32x4(w2, w3, 0x88);
+    out[half * 4 + 2] = _mm512_shuffle_f32x4(w0, w1, 0xDD);
+    out[half * 4 + 3] = _mm512_shuffle_f32x4(w2, w3, 0xDD);
+  }
+}
+
+ALIEN_TARGET_AVX512 inline __m512i scale_to_int_avx512(__m512 v, f32 scale,
+                                                      f32 lo, f32 hi) {
+  v = _mm512_mul_ps(v, _mm512_set1_ps(scale));
+  v = _mm512_min_ps(_mm512_max_ps(v, _mm512_set1_ps(lo)), _mm512_set1_ps(hi));
+  return _mm512_cvtps_epi32(v);
+}
+
+// Sixteen sprites per iteration, same layout as the AVX2 version.
+ALIEN_TARGET_AVX512 inline void generate_sprite_quads_avx512(
+    const SpriteColumns &in, u32 count, SpriteVertexStreams out) {
+  u32 i = 0;
+  auto one = _mm512_set1_ps(1.0f);
+  for (; i + 16 <= count; i += 16) {
+    auto x = _mm512_loadu_ps(in.x + i);
+    auto y = _mm512_loadu_ps(in.y + i);
+    auto sx = _mm512_loadu_ps(in.scaleX + i);
+    auto sy = _mm512_loadu_ps(in.scaleY + i);
+    auto px = _mm512_loadu_ps(in.pivotX + i);
+    auto py = _mm512_loadu_ps(in.pivotY + i);
+
+    __m512 s, c;
+    sincos_avx512(_mm512_loadu_ps(in.rotation + i), s, c);
+
+    auto lx0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_setzero_ps(), px), sx);
+    auto lx1 = _mm512_mul_ps(_mm512_sub_ps(one, px), sx);
+    auto ly0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_setzero_ps(), py), sy);
+    auto ly1 = _mm512_mul_ps(_mm512_sub_ps(one, py), sy);
+
+    auto cx0 = _mm512_mul_ps(c, lx0), cx1 = _mm512_mul_ps(c, lx1);
+    auto sx0 = _mm512_mul_ps(s, lx0), sx1 = _mm512_mul_ps(s, lx1);
+    auto cy0 = _mm512_mul_ps(c, ly0), cy1 = _mm512_mul_ps(c, ly1);
+    auto sy0 = _mm512_mul_ps(s, ly0), sy1 = _mm512_mul_ps(s, ly1);
+
+    __m512 p[8] = {
+        _mm512_add_ps(x, _mm512_sub_ps(cx0, sy0)),
+        _mm512_add_ps(y, _mm512_add_ps(sx0, cy0)),
+        _mm512_add_ps(x, _mm512_sub_ps(cx1, sy0)),
+        _mm512_add_ps(y, _mm512_add_ps(sx1, cy0)),
+        _mm512_add_ps(x, _mm512_sub_ps(cx1, sy1)),
+        _mm512_add_ps(y, _mm512_add_ps(sx1, cy1)),
+        _mm512_add_ps(x, _mm512_sub_ps(cx0, sy1)),
+        _mm512_add_ps(y, _mm512_add_ps(sx0, cy1)),
+    };
+    __m512 o[8];
+    transpose16_avx512(p, o);
+    auto dstPositions = (__m256i *)(out.positions + i * 8);
+    for (u32 k = 0; k < 8; ++k)
+      _mm256_storeu_si256(
+          dstPositions + k,
+          _mm512_cvtsepi32_epi16(scale_to_int_avx512(
+              o[k], Primitive::PositionScale, -32768.0f, 32767.0f)));
+
+    auto u0 = _mm512_loadu_ps(in.u0 + i), v0 = _mm512_loadu_ps(in.v0 + i);
+    auto u1 = _mm512_loadu_ps(in.u1 + i), v1 = _mm512_loadu_ps(in.v1 + i);
+    __m512 t[8] = {u0, v0, u1, v0, u1, v1, u0, v1};
+    transpose16_avx512(t, o);
+    auto dstTexCoords = (__m256i *)(out.texCoords + i * 8);
+    for (u32 k = 0; k < 8; ++k)
+      _mm256_storeu_si256(
+          dstTexCoords + k,
+          _mm512_cvtusepi32_epi16(scale_to_int_avx512(
+              o[k], Primitive::TexCoordScale, 0.0f, 65535.0f)));
+
+    auto col = _mm512_loadu_si512(in.color + i);
+    auto dst = (__m512i *)(out.colors + i * 4);
+    auto index = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3,
+                                   3, 3);
+    for (u32 k = 0; k < 4; ++k) {
+      _mm512_storeu_si512(dst + k, _mm512_permutexvar_epi32(index, col));
+      index = _mm512_add_epi32(index, _mm512_set1_epi32(4));
+    }
+  }
+
+  if (i < count)
+    generate_sprite_quads_avx2(
+        in.offset(i), count - i,
+        {out.positions + i * 8, out.texCoords + i * 8, out.colors + i * 4});
+}
+#endif
+
+// Writes the 4 corners of count sprites.
+inline void generate_sprite_quads(const SpriteColumns &in, u32 count,
+                                  SpriteVertexStreams out) {
+  using Fn = void (*)(const SpriteColumns &, u32, SpriteVertexStreams);
+  static const auto kernel =
+      Cpu::select<Fn>(ALIEN_CPU_VARIANTS(generate_sprite_quads));
+  kernel(in, count, out);
+}
+}  // namespace Kernel
+
+// Sprites stored as structure of arrays so the quad kernel can stream over
+// them. Handles stay valid while other sprites are removed, the columns are
+// kept in the same dense order as the slot map. A loose quadtree indexes
+// the sprites so only the ones in view are batched.
+class SpriteBatch {
+ public:
+  SpriteHandle add(const SpriteInstance &sprite) {
+    auto handle = m_Sprites.insert(sprite.color);
+    m_X.push_back(sprite.position.x);
+    m_Y.push_back(sprite.position.y);
+    m_Rotation.push_back(sprite.rotation);
+    m_ScaleX.push_back(sprite.scale.x);
+    m_ScaleY.push_back(sprite.scale.y);
+    m_PivotX.push_back(sprite.pivot.x);
+    m_PivotY.push_back(sprite.pivot.y);
+    m_U0.push_back(sprite.uvRect.x);
+    m_V0.push_back(sprite.uvRect.y);
+    m_U1.push_back(sprite.uvRect.z);
+    m_V1.push_back(sprite.uvRect.w);
+    m_TreeItems.push_back(m_Tree.insert(bounds(size() - 1), handle.value));
+    return handle;
+  }
+
+  bool remove(SpriteHandle handle) {
+    auto index = m_Sprites.index_of(handle);
+    if (index == SpriteSlots::InvalidIndex) return false;
+
+    // Mirror the swap-remove of the slot map
+    m_Tree.remove(m_TreeItems[index]);
+    for_each_column([index](auto &column) {
+      column[index] = column.back();
+      column.pop_back();
+    });
+    m_TreeItems[index] = m_TreeItems.back();
+    m_TreeItems.pop_back();
+    m_Sprites.erase(handle);
+    return true;
+  }
+
+  bool set_transform(SpriteHandle handle, Math::Vec2 position, f32 rotation,
+                     Math::Vec2 scale) {
+    auto index = m_Sprites.index_of(handle);
+    if (index == SpriteSlots::InvalidIndex) return false;
+
+    m_X[index] = position.x;
+    m_Y[index] = position.y;
+    m_Rotation[index] = rotation;
+    m_ScaleX[index] = scale.x;
+    m_ScaleY[index] = scale.y;
+    m_Tree.update(m_TreeItems[index], bounds(index));
+    return true;
+  }
+
+  bool set_position(SpriteHandle handle, Math::Vec2 position) {
+    auto index = m_Sprites.index_of(handle);
+    if (index == SpriteSlots::InvalidIndex) return false;
+
+    m_X[index] = position.x;
+    m_Y[index] = position.y;
+    m_Tree.update(m_TreeItems[index], bounds(index));
+    return true;
+  }
+
+  bool set_color(SpriteHandle handle, u32 color) {
+    auto sprite = m_Sprites.get(handle);
+    if (!sprite) return false;
+
+    *sprite = color;
+    return true;
+  }
+
+  void clear() {
+    m_Sprites.clear();
+    for_each_column([](auto &column) { column.clear(); });
+    m_TreeItems.clear();
+    m_Tree.reset(m_Tree.world_bounds());
+  }
+
+  // Sprites outside of the bounds are still culled, but tested one by one
+  // on every query.
+  void set_world_bounds(const Math::Vec4 &worldBounds,
+                        u32 maxDepth = LooseQuadtree::DefaultDepth) {
+    m_Tree.reset(worldBounds, maxDepth);
+    for (u32 i = 0; i < size(); ++i)
+      m_TreeItems[i] = m_Tree.insert(bounds(i), m_Sprites.handle_at(i).value);
+  }
+
+  // Dense indices of the sprites overlapping the rect, in dense order so
+  // they are drawn in the same order as without culling.
+  template <typename Indices>
+  void cull(const Math::Vec4 &rect, Indices &out) const {
+    out.clear();
+    m_Tree.query(rect, [&](u32 value) {
+      SpriteHandle handle;
+      handle.value = value;
+      out.push_back(m_Sprites.index_of(handle));
+    });
+    std::sort(out.begin(), out.end());
+  }
+
+  u32 size() const { return m_Sprites.size(); }
+
+  // Dense index of the sprite, the columns can be written directly by
+  // systems which update many sprites at once.
+  u32 index_of(SpriteHandle handle) const { return m_Sprites.index_of(handle); }
+
+  f32 *x() { return m_X.data(); }
+  f32 *y() { return m_Y.data(); }
+  f32 *rotation() { return m_Rotation.data(); }
+
+  // Call after writing positions directly, the quadtree does not see the
+  // columns change.
+  void refresh_bounds(u32 first, u32 count) {
+    for (auto i = first; i < first + count; ++i)
+      m_Tree.update(m_TreeItems[i], bounds(i));
+  }
+
+  SpriteColumns columns() const {
+    return {m_X.data(),      m_Y.data(),      m_Rotation.data(),
+            m_ScaleX.data(), m_ScaleY.data(), m_PivotX.data(),
+            m_PivotY.data(), m_U0.data(),     m_V0.data(),
+            m_U1.data(),     m_V1.data(),     m_Sprites.data()};
+  }
+
+  // Write the vertices of the sprites [first, first + count)
+  void generate(u32 first, u32 count, SpriteVertexStreams out) const {
+    Kernel::generate_sprite_quads(columns().offset(first), count, out);
+  }
+
+  // Write the vertex pulling records of the sprites [first, first + count)
+  void generate(u32 first, u32 count, SpriteRecord *out) const {
+    Kernel::pack_sprite_records(columns().offset(first), count, out);
+  }
+
+ private:
+  using SpriteSlots = SlotMap<u32, SpriteTag>;
+  using Column = Memory::Vector<f32, Memory::e_Renderer>;
+
+  template <typename F>
+  void for_each_column(F &&f) {
+    for (auto column : {&m_X, &m_Y, &m_Rotation, &m_ScaleX, &m_ScaleY,
+                        &m_PivotX, &m_PivotY, &m_U0, &m_V0, &m_U1, &m_V1})
+      f(*column);
+  }
+
+  // Square around the position which holds the quad at any rotation.
+  Math::Vec4 bounds(u32 index) const {
+    auto px = std::max(m_PivotX[index], 1.0f - m_PivotX[index]);
+    auto py = std::max(m_PivotY[index], 1.0f - m_PivotY[index]);
+    auto rx = px * m_ScaleX[index], ry = py * m_ScaleY[index];
+    auto r = std::sqrt(rx * rx + ry * ry);
+    return Math::Vec4(m_X[index] - r, m_Y[index] - r, m_X[index] + r,
+                      m_Y[index] + r);
+  }
+
+  // Values of the slot map are the colors
+  SpriteSlots m_Sprites;
+  Column m_X, m_Y, m_Rotation;
+  Column m_ScaleX, m_ScaleY;
+  Column m_PivotX, m_PivotY;
+  Column m_U0, m_V0, m_U1, m_V1;
+
+  LooseQuadtree m_Tree;
+  Memory::Vector<QuadtreeHandle, Memory::e_Renderer> m_TreeItems;
+};
+
+// Copy of some sprites of a batch, e.g. the visible ones, in the given
+// order. Positions are moved by -origin so the 13.3 fixed point vertices
+// stay in range however far from the world origin the camera is.
+class SpriteSelection {
+ public:
+  void assign(const SpriteColumns &in, const u32 *indices, u32 count,
+              Math::Vec2 origin) {
+    for_each_column([count](auto &column) { column.resize(count); });
+    m_Color.resize(count);
+    for (u32 i = 0; i < count; ++i) {
+      auto k = indices[i];
+      m_X[i] = in.x[k] - origin.x;
+      m_Y[i] = in.y[k] - origin.y;
+      m_Rotation[i] = in.rotation[k];
+      m_ScaleX[i] = in.scaleX[k];
+      m_ScaleY[i] = in.scaleY[k];
+      m_PivotX[i] = in.pivotX[k];
+      m_PivotY[i] = in.pivotY[k];
+      m_U0[i] = in.u0[k];
+      m_V0[i] = in.v0[k];
+      m_U1[i] = in.u1[k];
+      m_V1[i] = in.v1[k];
+      m_Color[i] = in.color[k];
+    }
+  }
+
+  u32 size() const { return (u32)m_Color.size(); }
+
+  SpriteColumns columns() const {
+    return {m_X.data(),      m_Y.data(),      m_Rotation.data(),
+            m_ScaleX.data(), m_ScaleY.data(), m_PivotX.data(),
+            m_PivotY.data(), m_U0.data(),     m_V0.data(),
+            m_U1.data(),     m_V1.data(),     m_Color.data()};
+  }
+
+  void generate(u32 first, u32 count, SpriteVertexStreams out) const {
+    Kernel::generate_sprite_quads(columns().offset(first), count, out);
+  }
+
+  void generate(u32 first, u32 count, SpriteRecord *out) const {
+    Kernel::pack_sprite_records(columns().offset(first), count, out);
+  }
+
+ private:
+  using Column = Memory::Vector<f32, Memory::e_Renderer>;
+
+  template <typename F>
+  void for_each_column(F &&f) {
+    for (auto column : {&m_X, &m_Y, &m_Rotation, &m_ScaleX, &m_ScaleY,
+                        &m_PivotX, &m_PivotY, &m_U0, &m_V0, &m_U1, &m_V1})
+      f(*column);
+  }
+
+  Column m_X, m_Y, m_Rotation;
+  Column m_ScaleX, m_ScaleY;
+  Column m_PivotX, m_PivotY;
+  Column m_U0, m_V0, m_U1, m_V1;
+  Memory::Vector<u32, Memory::e_Renderer> m_Color;
+};
+}  // namespace Alien
+
+#endif
@@ -67,6 +67,8 @@ added later as well.
 #endif
 #endif
 
+#include "base.hpp"
+
 #ifdef _WIN32
 #include <Windows.h>
 #include <d3d11.h>
@@ -75,12 +77,57 @@ added later as well.
 #include <wingdi.h>
 #endif
 
-#include "base.hpp"
+#include <array>
+
 #include "common.hpp"
 #include "math.hpp"
+#include "vertex_layout.hpp"
 
 #ifdef ALIEN_DX11
 namespace Extension::DX11 {
+// DX11 side of the vertex formats, see vertex_layout.hpp.
+constexpr DXGI_FORMAT dxgi_vertex_format(Alien::VertexFormat format) {
+  switch (format) {
+    case Alien::e_Float2:
+      return DXGI_FORMAT_R32G32_FLOAT;
+    case Alien::e_Float3:
+      return DXGI_FORMAT_R32G32B32_FLOAT;
+    case Alien::e_Float4:
+      return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    // DXGI has no unnormalized integer to float conversion (no SSCALED), so
+    // the shader input is int2 and converts with float() itself
+    case Alien::e_Short2:
+      return DXGI_FORMAT_R16G16_SINT;
+    case Alien::e_Short2Norm:
+      return DXGI_FORMAT_R16G16_SNORM;
+    case Alien::e_UShort2Norm:
+      return DXGI_FORMAT_R16G16_UNORM;
+    default:
+      return DXGI_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+// Input layout of a vertex type, built at compile time.
+template <typename Vertex>
+constexpr auto input_layout() {
+  static_assert(Alien::is_valid_vertex_layout<Vertex>(),
+                "Vertex attributes overlap or do not fit the vertex!");
+  constexpr auto &attributes = Alien::VertexLayout<Vertex>::attributes;
+
+  std::array<D3D11_INPUT_ELEMENT_DESC, Alien::vertex_attribute_count<Vertex>()>
+      desc{};
+  for (std::size_t i = 0; i < desc.size(); ++i) {
+    desc[i] = {attributes[i].semantic,
+               0,
+               dxgi_vertex_format(attributes[i].format),
+               0,
+               attributes[i].offset,
+               D3D11_INPUT_PER_VERTEX_DATA,
+               0};
+  }
+  return desc;
+}
+
 class App;
 struct DX11PhysicalDevice {
   friend class App;
@@ -401,15 +448,12 @@ struct DX11PhysicalDevice {
     // Input layout creation
     ID3D11InputLayout* inputLayout;
     {
-      D3D11_INPUT_ELEMENT_DESC inputElementDesc[] = {
-          {"POS", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0,
-           D3D11_INPUT_PER_VERTEX_DATA, 0},
-          {"COL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0,
-           D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}};
+      static constexpr auto inputElementDesc =
+          input_layout<Alien::Primitive::PackedVertex>();
 
       HRESULT hResult = m_Device->CreateInputLayout(
-          inputElementDesc, ARRAYSIZE(inputElementDesc), vs->GetBufferPointer(),
-          vs->GetBufferSize(), &inputLayout);
+          inputElementDesc.data(), (UINT)inputElementDesc.size(),
+          vs->GetBufferPointer(), vs->GetBufferSize(), &inputLayout);
       assert(SUCCEEDED(hResult));
       vs->Release();
     }
@@ -420,13 +464,16 @@ struct DX11PhysicalDevice {
     u32 stride;
     u32 offset;
     {
-      f32 vertexData[] = {// x, y, r, g, b, a
-                          -0.5f, 0.5f, 0.f,  1.f,  0.f,   1.f,   0.5f, -0.5f,
-                          1.f,   0.f,  0.f,  1.f,  -0.5f, -0.5f, 0.f,  0.f,
-                          1.f,   1.f,  0.5f, 0.5f, 1.f,   1.f,   0.f,  1.f};
-
-      stride = 6 * sizeof(f32);
-      numVers = sizeof(vertexData) / stride;
+      // snorm16 positions, unorm16 texture coordinates and RGBA8 colors
+      using Alien::Primitive::pack_rgba8;
+      const Alien::Primitive::PackedVertex vertexData[] = {
+          {{-16384, 16384}, {0, 0}, pack_rgba8(0.f, 1.f, 0.f, 1.f)},
+          {{16384, -16384}, {65535, 65535}, pack_rgba8(1.f, 0.f, 0.f, 1.f)},
+          {{-16384, -16384}, {0, 65535}, pack_rgba8(0.f, 0.f, 1.f, 1.f)},
+          {{16384, 16384}, {65535, 0}, pack_rgba8(1.f, 1.f, 0.f, 1.f)}};
+
+      stride = sizeof(Alien::Primitive::PackedVertex);
+      numVers = ARRAYSIZE(vertexData);
       offset = 0;
 
       D3D11_BUFFER_DESC vertexBufferDesc = {};
@@ -443,7 +490,7 @@ struct DX11PhysicalDevice {
 
     // Create index buffer
     ID3D11Buffer* indexBuffer;
-    u32 indexData[] = {0, 1, 2, 0, 3, 1};
+    u16 indexData[] = {0, 1, 2, 0, 3, 1};
     {
       D3D11_BUFFER_DESC indexBufferDesc = {};
       indexBufferDesc.ByteWidth = sizeof(indexData);
@@ -514,7 +561,7 @@ struct DX11PhysicalDevice {
 
     // Set the index buffer
     m_DeviceContext->IASetIndexBuffer(bufferDescriptor->indexBuffer,
-                                      DXGI_FORMAT_R32_UINT, 0);
+                                      DXGI_FORMAT_R16_UINT, 0);
 
     // Draw call
     if (bufferDescriptor->indexCount == 0) {
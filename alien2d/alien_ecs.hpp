@@ -0,0 +1,505 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_ECS_HPP
+#define ALIEN_ECS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+#include "base.hpp"
+#include "jobs.hpp"
+#include "memory.hpp"
+#include "slot_map.hpp"
+
+// Archetype ECS. Entities with the same component set share an archetype
+// whose rows live in fixed size chunks, one contiguous column per
+// component, so systems stream over plain arrays. Components must be
+// trivially copyable, rows are moved between chunks with memcpy.
+namespace Alien::Ecs {
+using Entity = Handle<struct EntityTag>;
+using ComponentId = u32;
+using ComponentMask = u64;
+
+static constexpr u32 MaxComponents = 64;
+static constexpr u32 ChunkBytes = 16 * 1024;
+// Chunks come from the default operator new
+static constexpr u32 MaxComponentAlignment = 16;
+
+namespace Detail {
+struct ComponentInfo {
+  u32 size;
+  u32 alignment;
+};
+
+inline ComponentInfo ComponentInfos[MaxComponents];
+inline std::atomic<u32> ComponentCount{0};
+}  // namespace Detail
+
+namespace Detail {
+template <typename T>
+ComponentId register_component() {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Components must be trivially copyable!");
+  static_assert(alignof(T) <= MaxComponentAlignment,
+                "Component is over-aligned!");
+
+  static const ComponentId id = [] {
+    auto id = ComponentCount.fetch_add(1, std::memory_order_relaxed);
+    assert(id < MaxComponents && "Too many component types!");
+    ComponentInfos[id] = {sizeof(T), alignof(T)};
+    return id;
+  }();
+  return id;
+}
+}  // namespace Detail
+
+// Ids are handed out on first use, in no particular order. T and const T
+// are the same component.
+template <typename T>
+ComponentId component_id() {
+  return Detail::register_component<std::remove_cv_t<T>>();
+}
+
+template <typename... Ts>
+ComponentMask component_mask() {
+  return ((1ull << component_id<Ts>()) | ... | 0ull);
+}
+
+// Rows of one component set. Every chunk but the last one is full.
+struct Archetype {
+  static constexpr u32 InvalidOffset = 0xFFFFFFFF;
+
+  explicit Archetype(ComponentMask componentMask) : mask(componentMask) {
+    offsets.fill(InvalidOffset);
+
+    u32 rowBytes = sizeof(Entity);
+    for_each_component(mask, [&](ComponentId id) {
+      rowBytes += Detail::ComponentInfos[id].size;
+    });
+
+    // Alignment padding between the columns may not fit, shrink until it
+    // does
+    capacity = ChunkBytes / rowBytes;
+    while (capacity > 0 && layout(capacity) > ChunkBytes) --capacity;
+    assert(capacity > 0 && "Components do not fit in a chunk!");
+    layout(capacity);
+  }
+
+  u32 chunk_count() const { return (count + capacity - 1) / capacity; }
+  u32 chunk_size(u32 chunk) const {
+    return std::min(capacity, count - chunk * capacity);
+  }
+
+  Entity *entities(u32 chunk) { return (Entity *)chunks[chunk].data(); }
+  u8 *column(u32 chunk, ComponentId id) {
+    return chunks[chunk].data() + offsets[id];
+  }
+
+  Entity &entity_at(u32 row) {
+    return entities(row / capacity)[row % capacity];
+  }
+  u8 *component_at(u32 row, ComponentId id) {
+    return column(row / capacity, id) +
+           (row % capacity) * Detail::ComponentInfos[id].size;
+  }
+
+  template <typename F>
+  static void for_each_component(ComponentMask mask, F &&f) {
+    for (; mask; mask &= mask - 1) f((ComponentId)std::countr_zero(mask));
+  }
+
+  ComponentMask mask;
+  // Rows per chunk and in all chunks
+  u32 capacity{0};
+  u32 count{0};
+  // Column offsets in the chunk, the entity column is at zero
+  std::array<u32, MaxComponents> offsets;
+  // Chunks are kept when the archetype shrinks and reused when it grows
+  std::vector<Memory::Vector<u8, Memory::e_Game>> chunks;
+
+  // Archetype after adding or removing a component, filled on first use
+  std::array<Archetype *, MaxComponents> addEdges{};
+  std::array<Archetype *, MaxComponents> removeEdges{};
+
+ private:
+  // Lays out the columns for n rows, returns the bytes used.
+  u32 layout(u32 n) {
+    u32 offset = n * sizeof(Entity);
+    for_each_component(mask, [&](ComponentId id) {
+      const auto &info = Detail::ComponentInfos[id];
+      offset = (offset + info.alignment - 1) & ~(info.alignment - 1);
+      offsets[id] = offset;
+      offset += n * info.size;
+    });
+    return offset;
+  }
+};
+
+// Archetypes matching a query, extended as new archetypes appear.
+struct QueryCache {
+  ComponentMask mask;
+  std::vector<Archetype *> archetypes;
+};
+
+// Iterates the entities which have all of Ts. A const component is only
+// read. Adding or removing components or entities while iterating moves
+// rows between chunks, record them in a CommandBuffer instead.
+template <typename... Ts>
+class Query {
+ public:
+  explicit Query(QueryCache &cache) : m_Cache(&cache) {}
+
+  // Calls f(count, entities, columns...) for every non-empty chunk.
+  template <typename F>
+  void each_chunk(F &&f) const {
+    for (auto *archetype : m_Cache->archetypes) {
+      for (u32 c = 0; c < archetype->chunk_count(); ++c)
+        call_chunk(*archetype, c, f);
+    }
+  }
+
+  // Calls f(components...) for every entity.
+  template <typename F>
+  void each(F &&f) const {
+    each_chunk([&](u32 count, const Entity *, Ts *...columns) {
+      for (u32 i = 0; i < count; ++i) f(columns[i]...);
+    });
+  }
+
+  // Like each_chunk with the chunks spread over the job system. f must
+  // be safe to call from several threads at once. Queries sharing a cache
+  // may run at the same time, so the chunk list is built per call.
+  template <typename F>
+  void parallel_each_chunk(F &&f,
+                           JobSystem &jobs = JobSystem::instance()) const {
+    std::vector<ChunkRef> chunks;
+    for (auto *archetype : m_Cache->archetypes) {
+      for (u32 c = 0; c < archetype->chunk_count(); ++c)
+        chunks.push_back({archetype, c});
+    }
+
+    jobs.parallel_for((u32)chunks.size(), 1, [&](u32 begin, u32 end) {
+      for (auto i = begin; i < end; ++i)
+        call_chunk(*chunks[i].archetype, chunks[i].chunk, f);
+    });
+  }
+
+  template <typename F>
+  void parallel_each(F &&f, JobSystem &jobs = JobSystem::instance()) const {
+    parallel_each_chunk(
+        [&](u32 count, const Entity *, Ts *...columns) {
+          for (u32 i = 0; i < count; ++i) f(columns[i]...);
+        },
+        jobs);
+  }
+
+  u32 count() const {
+    u32 n = 0;
+    for (auto *archetype : m_Cache->archetypes) n += archetype->count;
+    return n;
+  }
+
+ private:
+  struct ChunkRef {
+    Archetype *archetype;
+    u32 chunk;
+  };
+
+  template <typename F>
+  static void call_chunk(Archetype &archetype, u32 chunk, F &f) {
+    f(archetype.chunk_size(chunk), (const Entity *)archetype.entities(chunk),
+      (Ts *)archetype.column(chunk, component_id<Ts>())...);
+  }
+
+  QueryCache *m_Cache;
+};
+
+class CommandBuffer;
+
+class World {
+  friend class CommandBuffer;
+
+ public:
+  World() { m_Empty = archetype(0); }
+
+  World(const World &) = delete;
+  World &operator=(const World &) = delete;
+
+  template <typename... Ts>
+  Entity create(const Ts &...components) {
+    auto mask = component_mask<Ts...>();
+    assert(std::popcount(mask) == sizeof...(Ts) && "Duplicate components!");
+
+    auto entity = create_with(mask);
+    auto &location = *m_Entities.get(entity);
+    (std::memcpy(location.archetype->component_at(location.row,
+                                                  component_id<Ts>()),
+                 &components, sizeof(Ts)),
+     ...);
+    return entity;
+  }
+
+  void destroy(Entity entity) {
+    auto *location = m_Entities.get(entity);
+    if (!location) return;
+
+    remove_row(*location->archetype, location->row);
+    m_Entities.erase(entity);
+  }
+
+  bool alive(Entity entity) const { return m_Entities.contains(entity); }
+  u32 size() const { return m_Entities.size(); }
+
+  // Overwrites the component when the entity already has it.
+  template <typename T>
+  void add(Entity entity, const T &component) {
+    add_component(entity, component_id<T>(), &component);
+  }
+
+  template <typename T>
+  void remove(Entity entity) {
+    remove_component(entity, component_id<T>());
+  }
+
+  // Returns nullptr when the entity is stale or lacks the component. The
+  // pointer is valid until the next structural change.
+  template <typename T>
+  T *get(Entity entity) {
+    auto *location = m_Entities.get(entity);
+    auto id = component_id<T>();
+    if (!location || !(location->archetype->mask & (1ull << id)))
+      return nullptr;
+    return (T *)location->archetype->component_at(location->row, id);
+  }
+
+  template <typename T>
+  bool has(Entity entity) const {
+    auto *location = m_Entities.get(entity);
+    return location &&
+           (location->archetype->mask & (1ull << component_id<T>()));
+  }
+
+  // Queries are cached per component set, asking again is a lookup.
+  template <typename... Ts>
+  Query<Ts...> query() {
+    auto mask = component_mask<Ts...>();
+    auto &cache = m_Queries[mask];
+    if (!cache) {
+      cache = std::make_unique<QueryCache>();
+      cache->mask = mask;
+      for (auto &[archetypeMask, archetype] : m_Archetypes) {
+        if ((archetypeMask & mask) == mask)
+          cache->archetypes.push_back(archetype.get());
+      }
+    }
+    return Query<Ts...>(*cache);
+  }
+
+ private:
+  struct Location {
+    Archetype *archetype;
+    u32 row;
+  };
+
+  Archetype *archetype(ComponentMask mask) {
+    auto &archetype = m_Archetypes[mask];
+    if (archetype) return archetype.get();
+
+    archetype = std::make_unique<Archetype>(mask);
+    for (auto &[queryMask, cache] : m_Queries) {
+      if ((mask & queryMask) == queryMask)
+        cache->archetypes.push_back(archetype.get());
+    }
+    return archetype.get();
+  }
+
+  // The components of the new row are left uninitialized.
+  Entity create_with(ComponentMask mask) {
+    auto *target = mask ? archetype(mask) : m_Empty;
+    auto entity = m_Entities.insert({target, 0});
+    m_Entities.get(entity)->row = push_row(*target, entity);
+    return entity;
+  }
+
+  void add_component(Entity entity, ComponentId id, const void *data) {
+    auto *location = m_Entities.get(entity);
+    if (!location) return;
+
+    auto *source = location->archetype;
+    if (!(source->mask & (1ull << id))) {
+      auto *&target = source->addEdges[id];
+      if (!target) target = archetype(source->mask | (1ull << id));
+      move_row(*location, *target);
+    }
+    std::memcpy(location->archetype->component_at(location->row, id), data,
+                Detail::ComponentInfos[id].size);
+  }
+
+  void remove_component(Entity entity, ComponentId id) {
+    auto *location = m_Entities.get(entity);
+    if (!location || !(location->archetype->mask & (1ull << id))) return;
+
+    auto *&target = location->archetype->removeEdges[id];
+    if (!target) target = archetype(location->archetype->mask & ~(1ull << id));
+    move_row(*location, *target);
+  }
+
+  u32 push_row(Archetype &archetype, Entity entity) {
+    auto row = archetype.count++;
+    if (row / archetype.capacity == archetype.chunks.size())
+      archetype.chunks.emplace_back(ChunkBytes);
+    archetype.entity_at(row) = entity;
+    return row;
+  }
+
+  // Fills the hole with the last row so the chunks stay packed.
+  void remove_row(Archetype &archetype, u32 row) {
+    auto last = --archetype.count;
+    if (row == last) return;
+
+    auto moved = archetype.entity_at(last);
+    archetype.entity_at(row) = moved;
+    Archetype::for_each_component(archetype.mask, [&](ComponentId id) {
+      std::memcpy(archetype.component_at(row, id),
+                  archetype.component_at(last, id),
+                  Detail::ComponentInfos[id].size);
+    });
+    m_Entities.get(moved)->row = row;
+  }
+
+  // Copies the shared components, the new ones are left to the caller.
+  void move_row(Location &location, Archetype &target) {
+    auto &source = *location.archetype;
+    auto entity = source.entity_at(location.row);
+    auto row = push_row(target, entity);
+    Archetype::for_each_component(
+        source.mask & target.mask, [&](ComponentId id) {
+          std::memcpy(target.component_at(row, id),
+                      source.component_at(location.row, id),
+                      Detail::ComponentInfos[id].size);
+        });
+
+    // remove_row only rewrites the row of the entity it moves
+    remove_row(source, location.row);
+    location = {&target, row};
+  }
+
+  SlotMap<Location, EntityTag> m_Entities;
+  std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> m_Archetypes;
+  std::unordered_map<ComponentMask, std::unique_ptr<QueryCache>> m_Queries;
+  Archetype *m_Empty;
+};
+
+// Records structural changes while queries are running and applies them
+// in order on playback. Recording is thread safe, so the jobs of a
+// parallel iteration can share one buffer.
+class CommandBuffer {
+ public:
+  template <typename... Ts>
+  void create(const Ts &...components) {
+    std::lock_guard lock(m_Mutex);
+    m_Commands.push_back({e_Create, 0, component_mask<Ts...>(), {}, 0});
+    (record_component({}, component_id<Ts>(), &components), ...);
+  }
+
+  void destroy(Entity entity) {
+    std::lock_guard lock(m_Mutex);
+    m_Commands.push_back({e_Destroy, 0, 0, entity, 0});
+  }
+
+  template <typename T>
+  void add(Entity entity, const T &component) {
+    std::lock_guard lock(m_Mutex);
+    record_component(entity, component_id<T>(), &component);
+  }
+
+  template <typename T>
+  void remove(Entity entity) {
+    std::lock_guard lock(m_Mutex);
+    m_Commands.push_back({e_Remove, component_id<T>(), 0, entity, 0});
+  }
+
+  bool empty() const { return m_Commands.empty(); }
+
+  // Commands on entities destroyed in the meantime are skipped.
+  void playback(World &world) {
+    Entity created;
+    for (const auto &command : m_Commands) {
+      switch (command.type) {
+        case e_Create:
+          created = world.create_with(command.mask);
+          break;
+        case e_Destroy:
+          world.destroy(command.entity);
+          break;
+        case e_Add:
+          world.add_component(command.entity ? command.entity : created,
+                              command.component,
+                              m_Payload.data() + command.payload);
+          break;
+        case e_Remove:
+          world.remove_component(command.entity, command.component);
+          break;
+      }
+    }
+    m_Commands.clear();
+    m_Payload.clear();
+  }
+
+ private:
+  enum CommandType { e_Create, e_Destroy, e_Add, e_Remove };
+
+  struct Command {
+    CommandType type;
+    ComponentId component;
+    ComponentMask mask;
+    // Invalid for the components of the last created entity
+    Entity entity;
+    u32 payload;
+  };
+
+  void record_component(Entity entity, ComponentId id, const void *data) {
+    auto offset = (u32)m_Payload.size();
+    auto size = Detail::ComponentInfos[id].size;
+    m_Payload.resize(offset + size);
+    std::memcpy(m_Payload.data() + offset, data, size);
+    m_Commands.push_back({e_Add, id, 0, entity, offset});
+  }
+
+  std::mutex m_Mutex;
+  Memory::Vector<Command, Memory::e_Game> m_Commands;
+  Memory::Vector<u8, Memory::e_Game> m_Payload;
+};
+}  // namespace Alien::Ecs
+
+#endif
@@ -33,9 +33,12 @@ THE SOFTWARE.
 #include "alien_dx11.hpp"
 #else
 #include "alien_gl.hpp"
+#include "texture_stream.hpp"
 #endif
 
+#include "alien_batch.hpp"
 #include "common.hpp"
+#include "memory.hpp"
 
 namespace Alien {
 struct IRenderable {
@@ -52,6 +55,12 @@ struct RenderQueueInfo {
   u32 zOrder;
 };
 
+// How batched sprites reach the GPU. Vertex streams upload four packed
+// vertices per sprite and draw with a static index buffer. Vertex pulling
+// uploads one 32-byte record per sprite and the vertex shader builds the
+// quad from gl_VertexID.
+enum SpriteBatchMode { e_VertexStreams, e_VertexPulling };
+
 struct Renderer {
   static Renderer& instance() {
     static Renderer ins;
@@ -62,6 +71,23 @@ struct Renderer {
     for (auto& i : m_RenderQueue) {
       i.sprite->on_release();
     }
+
+#ifndef ALIEN_DX11
+    if (Context && m_BatchVertexArray) {
+      Context->release_vertex_array(m_BatchVertexArray);
+      Context->release_program(m_BatchProgram);
+    }
+    if (Context && m_RecordBuffer.vertexArray) {
+      Context->release_vertex_array(m_RecordBuffer.vertexArray);
+      Context->release_texture(m_RecordBuffer.records);
+      Context->release_program(m_RecordProgram);
+    }
+    if (Context && m_WhiteTexture) Context->release_texture(m_WhiteTexture);
+    m_Streamer.reset();
+
+    // Deleting is deferred by the context, make sure nothing leaks
+    if (Context) Context->flush_releases();
+#endif
   }
 
   void init() {
@@ -70,13 +96,61 @@ struct Renderer {
     }
   }
 
+  // Starts a new frame and draws every queued renderable.
   void draw() {
+    Memory::next_frame();
+#ifdef ALIEN_DX11
+    Context->physicalDevice.next_frame();
+#else
+    Context->next_frame();
+    if (m_Streamer) m_Streamer->update();
+#endif
+
     for (auto& i : m_RenderQueue) {
       i.sprite->on_draw();
     }
+
+    flush_sprites();
+  }
+
+  // Batched sprites, drawn after the render queue with one draw call per
+  // MaxBatchSprites sprites. Only the sprites in view are drawn.
+  SpriteBatch& sprites() { return m_SpriteBatch; }
+
+#ifndef ALIEN_DX11
+  // Texture sampled by the batched sprites, their uvRects point into it.
+  // Without one the sprites are drawn in their flat color.
+  void set_sprite_texture(TextureHandle texture) {
+    m_SpriteTexture = texture;
+    m_SpriteStream = {};
+  }
+  TextureHandle sprite_texture() const { return m_SpriteTexture; }
+
+  // Streams textures in the background, updated at the start of each
+  // frame. Created on first use, the context has to be set by then.
+  TextureStreamer& streamer() {
+    if (!m_Streamer) m_Streamer = std::make_unique<TextureStreamer>(*Context);
+    return *m_Streamer;
   }
 
+  // Sprites show the placeholder until the streamed texture is resident.
+  void set_sprite_texture(StreamHandle texture) {
+    m_SpriteStream = texture;
+    m_SpriteTexture = {};
+  }
+#endif
+
+  // World position shown at the top-left corner of the viewport.
+  void set_camera(Math::Vec2 position) { m_Camera = position; }
+  Math::Vec2 camera() const { return m_Camera; }
+
+  void set_sprite_batch_mode(SpriteBatchMode mode) { m_BatchMode = mode; }
+  SpriteBatchMode sprite_batch_mode() const { return m_BatchMode; }
+
   void resize_viewport(u32 w, u32 h) {
+    m_ViewportWidth = w;
+    m_ViewportHeight = h;
+
 #ifdef ALIEN_DX11
     Context->physicalDevice.set_viewport(w,h);
 #else
@@ -102,13 +176,193 @@ struct Renderer {
  private:
   Renderer() = default;
 
+  static constexpr u32 MaxBatchSprites = 16384;
+
+  void flush_sprites() {
+#ifndef ALIEN_DX11
+    if (m_SpriteBatch.size() == 0) return;
+
+    Math::Vec4 view(m_Camera.x, m_Camera.y,
+                    m_Camera.x + (f32)m_ViewportWidth,
+                    m_Camera.y + (f32)m_ViewportHeight);
+    m_SpriteBatch.cull(view, m_VisibleIndices);
+    m_VisibleSprites.assign(m_SpriteBatch.columns(), m_VisibleIndices.data(),
+                            (u32)m_VisibleIndices.size(), m_Camera);
+    auto count = m_VisibleSprites.size();
+    if (count == 0) return;
+
+    if (!m_WhiteTexture) {
+      u32 white = 0xFFFFFFFF;
+      m_WhiteTexture = Context->create_texture(1, 1, &white);
+    }
+    auto texture = m_SpriteTexture;
+    if (m_SpriteStream) texture = streamer().texture(m_SpriteStream);
+    if (!texture) texture = m_WhiteTexture;
+
+    if (m_BatchMode == e_VertexPulling) {
+      if (!m_RecordBuffer.vertexArray) init_sprite_records();
+
+      for (u32 first = 0; first < count; first += MaxBatchSprites) {
+        auto n = std::min(MaxBatchSprites, count - first);
+        m_VisibleSprites.generate(first, n, m_BatchRecords.data());
+        Context->draw_sprite_records(m_RecordBuffer, m_RecordProgram, texture,
+                                     m_BatchRecords.data(), n,
+                                     (f32)m_ViewportWidth,
+                                     (f32)m_ViewportHeight);
+      }
+      return;
+    }
+
+    if (!m_BatchVertexArray) init_sprite_batch();
+
+    SpriteVertexStreams streams{m_BatchPositions.data(),
+                                m_BatchTexCoords.data(), m_BatchColors.data()};
+    for (u32 first = 0; first < count; first += MaxBatchSprites) {
+      auto n = std::min(MaxBatchSprites, count - first);
+      m_VisibleSprites.generate(first, n, streams);
+      Context->draw_sprite_batch(m_BatchVertexArray, m_BatchProgram, texture,
+                                 streams, n, (f32)m_ViewportWidth,
+                                 (f32)m_ViewportHeight);
+    }
+#endif
+  }
+
+#ifndef ALIEN_DX11
+  static constexpr const char* BatchFragmentSrc = R"(
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D uTexture;
+
+in vec2 vertexUV;
+in vec4 vertexColor;
+
+void main()
+{
+    FragColor = texture(uTexture, vertexUV) * vertexColor;
+})";
+
+  ProgramHandle create_batch_program(const std::string& vertexSrc) {
+    std::string vertexShaderSrc, fragShaderSrc;
+    GLuint vertShader, fragShader;
+    Context->compile_vertex_shader(vertexSrc, vertexShaderSrc, vertShader);
+    Context->compile_pixel_shader(BatchFragmentSrc, fragShaderSrc, fragShader);
+    return Context->create_program(vertShader, fragShader);
+  }
+
+  void init_sprite_batch() {
+    const std::string vertexSrc = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos; // 13.3 fixed point pixels, top-left origin
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec4 aCol;
+
+uniform vec2 uViewport;
+
+out vec2 vertexUV;
+out vec4 vertexColor;
+
+void main()
+{
+  vertexUV = aUV;
+  vertexColor = aCol;
+  vec2 ndc = aPos * 0.125 / uViewport * 2.0 - 1.0;
+  gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+})";
+
+    m_BatchProgram = create_batch_program(vertexSrc);
+    m_BatchVertexArray = Context->create_sprite_batch_buffer(MaxBatchSprites);
+
+    m_BatchPositions.resize(MaxBatchSprites * SpriteVertexStreams::Positions);
+    m_BatchTexCoords.resize(MaxBatchSprites * SpriteVertexStreams::TexCoords);
+    m_BatchColors.resize(MaxBatchSprites * SpriteVertexStreams::Colors);
+  }
+
+  void init_sprite_records() {
+    // Decodes the SpriteRecord layout, two RGBA32UI texels per sprite
+    const std::string vertexSrc = R"(
+#version 330 core
+uniform usamplerBuffer uSprites;
+uniform vec2 uViewport;
+
+out vec2 vertexUV;
+out vec4 vertexColor;
+
+// Top-left, top-right, bottom-right, bottom-left as two triangles
+const vec2 corners[6] = vec2[6](vec2(0.0, 0.0), vec2(1.0, 0.0),
+                                vec2(1.0, 1.0), vec2(0.0, 0.0),
+                                vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+vec2 unorm16x2(uint v)
+{
+  return vec2(v & 0xFFFFu, v >> 16u) / 65535.0;
+}
+
+void main()
+{
+  int sprite = gl_VertexID / 6;
+  vec2 corner = corners[gl_VertexID % 6];
+  uvec4 a = texelFetch(uSprites, sprite * 2);
+  uvec4 b = texelFetch(uSprites, sprite * 2 + 1);
+
+  vec2 position = uintBitsToFloat(a.xy);
+  float rotation = uintBitsToFloat(a.z);
+  vec2 size = vec2(int(a.w << 16u) >> 16, int(a.w) >> 16) / 16.0;
+  vec2 pivot = unorm16x2(b.x);
+
+  vec2 local = (corner - pivot) * size;
+  float s = sin(rotation), c = cos(rotation);
+  vec2 pixel = position + vec2(c * local.x - s * local.y,
+                               s * local.x + c * local.y);
+
+  vertexUV = mix(unorm16x2(b.y), unorm16x2(b.z), corner);
+  vertexColor = vec4(b.w & 0xFFu, (b.w >> 8u) & 0xFFu, (b.w >> 16u) & 0xFFu,
+                     b.w >> 24u) / 255.0;
+  vec2 ndc = pixel / uViewport * 2.0 - 1.0;
+  gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+})";
+
+    m_RecordProgram = create_batch_program(vertexSrc);
+    m_RecordBuffer = Context->create_sprite_record_buffer(MaxBatchSprites);
+    m_BatchRecords.resize(MaxBatchSprites);
+  }
+#endif
+
 #ifndef ALIEN_DX11
   static inline Alien::GLContext* Context{nullptr};
 #else
   static inline Alien::DX11Context* Context{nullptr};
 #endif
 
-  std::vector<RenderQueueInfo> m_RenderQueue;
+  Memory::Vector<RenderQueueInfo, Memory::e_Renderer> m_RenderQueue;
+
+  SpriteBatch m_SpriteBatch;
+  SpriteBatchMode m_BatchMode{e_VertexStreams};
+  Math::Vec2 m_Camera{0.0f, 0.0f};
+  // Culling output of the frame, camera relative
+  Memory::Vector<u32, Memory::e_Renderer> m_VisibleIndices;
+  SpriteSelection m_VisibleSprites;
+  u32 m_ViewportWidth{800};
+  u32 m_ViewportHeight{600};
+
+#ifndef ALIEN_DX11
+  ProgramHandle m_BatchProgram;
+  VertexArrayHandle m_BatchVertexArray;
+
+  // Kernel output of one draw call, uploaded as it is
+  Memory::Vector<i16, Memory::e_Renderer> m_BatchPositions;
+  Memory::Vector<u16, Memory::e_Renderer> m_BatchTexCoords;
+  Memory::Vector<u32, Memory::e_Renderer> m_BatchColors;
+
+  TextureHandle m_SpriteTexture;
+  TextureHandle m_WhiteTexture;
+  StreamHandle m_SpriteStream;
+  std::unique_ptr<TextureStreamer> m_Streamer;
+
+  ProgramHandle m_RecordProgram;
+  GLContext::SpriteRecordBuffer m_RecordBuffer;
+  Memory::Vector<SpriteRecord, Memory::e_Renderer> m_BatchRecords;
+#endif
 };
 
 }  // namespace Alien
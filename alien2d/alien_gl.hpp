@@ -65,20 +65,30 @@ added later as well.
 #endif
 #endif
 
+#include "base.hpp"
+
 #ifdef _WIN32
 //#include <wingdi.h>
 #include <windows.h>
 #endif
 #include <gl/GL.h>
 
+#include <deque>
 #include <fstream>
+#include <future>
+#include <span>
+#include <utility>
 
-#include "base.hpp"
 #include "common.hpp"
 #include "gl/glcorearb.h"
 #include "gl/glext.h"
 #include "gl/wglext.h"
+#include "alien_batch.hpp"
+#include "image.hpp"
 #include "math.hpp"
+#include "memory.hpp"
+#include "mpsc_queue.hpp"
+#include "vertex_layout.hpp"
 
 #ifndef ALIEN_DX11
 
@@ -103,17 +113,24 @@ PFNGLGETSTRINGPROC glGetString;
 PFNGLGETERRORPROC glGetError;
 
 // -- glcorearb
+// GL 1.1 entry points (glBindTexture, glGenTextures, ...) are exported by
+// opengl32 and declared in <gl/GL.h>, call them as ::glBindTexture.
 PFNGLVIEWPORTPROC glViewport;
 PFNGLCLEARPROC glClear;
 PFNGLCLEARCOLORPROC glClearColor;
 PFNGLGENBUFFERSPROC glGenBuffers;
 PFNGLDELETEBUFFERSPROC glDeleteBuffers;
 PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
+PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
 PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
 PFNGLBUFFERDATAPROC glBufferData;
 PFNGLBINDBUFFERARBPROC glBindBuffer;
 PFNGLBUFFERSUBDATAPROC glBufferSubData;
+PFNGLBUFFERSTORAGEPROC glBufferStorage;
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer;
 PFNGLTEXIMAGE2DPROC glTexImage2D;
+PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
 PFNGLACTIVETEXTUREPROC glActiveTexture;
 PFNGLTEXPARAMETERIPROC glTexParameteri;
 PFNGLTEXPARAMETERFPROC glTexParameterf;
@@ -134,6 +151,10 @@ PFNGLGETSHADERIVPROC glGetShaderiv;
 PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
 PFNGLGETPROGRAMIVPROC glGetProgramiv;
 PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog;
+PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+PFNGLUNIFORM2FPROC glUniform2f;
+PFNGLUNIFORM1IPROC glUniform1i;
+PFNGLTEXBUFFERPROC glTexBuffer;
 PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
 PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
 PFNGLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstanced;
@@ -145,6 +166,9 @@ PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers;
 PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D;
 PFNGLRENDERBUFFERSTORAGEPROC glRenderbufferStorage;
 PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer;
+PFNGLFENCESYNCPROC glFenceSync;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+PFNGLDELETESYNCPROC glDeleteSync;
 
 static void *get_proc(const char *procName) {
   void *proc = (void *)wglGetProcAddress(procName);
@@ -168,11 +192,19 @@ static void load_gl_funcs() {
   glGenBuffers = (PFNGLGENBUFFERSPROC)get_proc("glGenBuffers");
   glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)get_proc("glDeleteBuffers");
   glGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)get_proc("glGenVertexArrays");
+  glDeleteVertexArrays =
+      (PFNGLDELETEVERTEXARRAYSPROC)get_proc("glDeleteVertexArrays");
   glBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)get_proc("glBindVertexArray");
   glBufferData = (PFNGLBUFFERDATAPROC)get_proc("glBufferData");
   glBindBuffer = (PFNGLBINDBUFFERPROC)get_proc("glBindBuffer");
   glBufferSubData = (PFNGLBUFFERSUBDATAPROC)get_proc("glBufferSubData");
+  // GL 4.4 or ARB_buffer_storage, null when the driver has neither
+  glBufferStorage = (PFNGLBUFFERSTORAGEPROC)get_proc("glBufferStorage");
+  glMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)get_proc("glMapBufferRange");
+  glUnmapBuffer = (PFNGLUNMAPBUFFERPROC)get_proc("glUnmapBuffer");
   glTexImage2D = (PFNGLTEXIMAGE2DPROC)get_proc("glTexImage2D");
+  glCompressedTexImage2D =
+      (PFNGLCOMPRESSEDTEXIMAGE2DPROC)get_proc("glCompressedTexImage2D");
   glActiveTexture = (PFNGLACTIVETEXTUREPROC)get_proc("glActiveTexture");
   glTexParameteri = (PFNGLTEXPARAMETERIPROC)get_proc("glTexParameteri");
   glTexParameterf = (PFNGLTEXPARAMETERFPROC)get_proc("glTexParameterf");
@@ -193,6 +225,11 @@ static void load_gl_funcs() {
   glGetProgramiv = (PFNGLGETPROGRAMIVPROC)get_proc("glGetProgramiv");
   glGetProgramInfoLog =
       (PFNGLGETPROGRAMINFOLOGPROC)get_proc("glGetProgramInfoLog");
+  glGetUniformLocation =
+      (PFNGLGETUNIFORMLOCATIONPROC)get_proc("glGetUniformLocation");
+  glUniform2f = (PFNGLUNIFORM2FPROC)get_proc("glUniform2f");
+  glUniform1i = (PFNGLUNIFORM1IPROC)get_proc("glUniform1i");
+  glTexBuffer = (PFNGLTEXBUFFERPROC)get_proc("glTexBuffer");
   glDeleteProgram = (PFNGLDELETEPROGRAMPROC)get_proc("glDeleteProgram");
   glVertexAttribPointer =
       (PFNGLVERTEXATTRIBPOINTERPROC)get_proc("glVertexAttribPointer");
@@ -202,6 +239,9 @@ static void load_gl_funcs() {
       (PFNGLDRAWELEMENTSINSTANCEDPROC)get_proc("glDrawElementsInstanced");
   glBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)get_proc("glBindFramebuffer");
   glBlitFramebuffer = (PFNGLBLITFRAMEBUFFERPROC)get_proc("glBlitFramebuffer");
+  glFenceSync = (PFNGLFENCESYNCPROC)get_proc("glFenceSync");
+  glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)get_proc("glClientWaitSync");
+  glDeleteSync = (PFNGLDELETESYNCPROC)get_proc("glDeleteSync");
 }
 
 // Load GL context funcs
@@ -231,6 +271,54 @@ static void check_gl_error(const char *stmt, const char *fn, int l) {
 
 namespace Alien {
 using namespace Extension::GL;
+
+// GL side of the vertex formats, see vertex_layout.hpp.
+constexpr GLenum gl_vertex_type(VertexFormat format) {
+  switch (format) {
+    case e_Short2:
+    case e_Short2Norm:
+      return GL_SHORT;
+    case e_UShort2Norm:
+      return GL_UNSIGNED_SHORT;
+    case e_UByte4Norm:
+      return GL_UNSIGNED_BYTE;
+    default:
+      return GL_FLOAT;
+  }
+}
+
+constexpr GLboolean gl_vertex_normalized(VertexFormat format) {
+  return format == e_Short2Norm || format == e_UShort2Norm ||
+                 format == e_UByte4Norm
+             ? GL_TRUE
+             : GL_FALSE;
+}
+
+// GL side of the texture formats, see image.hpp.
+constexpr GLenum gl_texture_format(TextureFormat format) {
+  switch (format) {
+    case e_BC1:
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case e_BC3:
+      return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+      return GL_RGBA8;
+  }
+}
+
+// Bytes of one level in GPU memory, BC formats are 4x4 blocks.
+constexpr u64 gl_texture_bytes(GLenum format, u32 width, u32 height) {
+  auto blocks = (u64)((width + 3) / 4) * ((height + 3) / 4);
+  switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      return blocks * 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      return blocks * 16;
+    default:
+      return (u64)width * height * 4;
+  }
+}
+
 class GLContext {
  public:
   GLContext() = default;
@@ -449,9 +537,20 @@ class GLContext {
     return true;
   }
 
-  // create program
-  bool create_program(GLuint &program, GLuint vertShader, GLuint fragShader) {
-    program = glCreateProgram();
+  // Compile GL vertex shader from memory, e.g. a mapped pack entry. The
+  // length goes to GL with the source, so it is used in place.
+  bool compile_vertex_shader(std::span<const u8> src, GLuint &vertShader) {
+    return compile_shader(GL_VERTEX_SHADER, src, vertShader);
+  }
+
+  // Compile GL frag shader from memory, see above.
+  bool compile_pixel_shader(std::span<const u8> src, GLuint &fragShader) {
+    return compile_shader(GL_FRAGMENT_SHADER, src, fragShader);
+  }
+
+  // Create program, returns an invalid handle when linking fails
+  ProgramHandle create_program(GLuint vertShader, GLuint fragShader) {
+    GLuint program = glCreateProgram();
     CHECK(glAttachShader(program, vertShader));
     CHECK(glAttachShader(program, fragShader));
     CHECK(glLinkProgram(program));
@@ -470,10 +569,211 @@ class GLContext {
       glDeleteShader(vertShader);
       glDeleteShader(fragShader);
 
-      return false;
+      return {};
     }
 
-    return true;
+    return m_Programs.insert(
+        Extra::ProgramObject{program, vertShader, fragShader});
+  }
+
+  // Create buffer object and upload the data if there is any
+  BufferHandle create_buffer(GLenum target, u32 size, const void *data,
+                             GLenum usage) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferData(target, size, data, usage);
+    Memory::track_gpu_buffer(size);
+
+    return m_Buffers.insert(Extra::BufferObject{buffer, target, size});
+  }
+
+  // Create 2D texture (RGBA8 pixels can be null to allocate only)
+  TextureHandle create_texture(u32 width, u32 height, const void *pixels,
+                               GLenum format = GL_RGBA8) {
+    GLuint texture;
+    ::glGenTextures(1, &texture);
+    ::glBindTexture(GL_TEXTURE_2D, texture);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                                   GL_LINEAR);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                                   GL_LINEAR);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                                   GL_CLAMP_TO_EDGE);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                                   GL_CLAMP_TO_EDGE);
+    Extension::GL::glTexImage2D(GL_TEXTURE_2D, 0, format, (GLsizei)width,
+                                (GLsizei)height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                                pixels);
+    Memory::track_gpu_texture((i64)width * height * 4);
+
+    return m_Textures.insert(
+        Extra::TextureObject{texture, width, height, format, 1});
+  }
+
+  // Texture with levels (mipmaps) already made, largest first and back to
+  // back in data: RGBA8 pixels, or BC blocks which are uploaded as they
+  // are. Empty data only allocates the levels. Invalid handle when data
+  // does not hold every level.
+  TextureHandle create_texture(TextureFormat format, u32 width, u32 height,
+                               u32 levels, std::span<const u8> data) {
+    auto glFormat = gl_texture_format(format);
+    u64 total = 0;
+    for (u32 i = 0; i < levels; ++i)
+      total += gl_texture_bytes(glFormat, std::max(width >> i, 1u),
+                                std::max(height >> i, 1u));
+    if (width == 0 || height == 0 || levels == 0 ||
+        (!data.empty() && total != data.size()))
+      return {};
+
+    GLuint texture;
+    ::glGenTextures(1, &texture);
+    ::glBindTexture(GL_TEXTURE_2D, texture);
+    Extension::GL::glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+        levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                                   GL_LINEAR);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                                   GL_CLAMP_TO_EDGE);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                                   GL_CLAMP_TO_EDGE);
+    Extension::GL::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                                   (GLint)levels - 1);
+    auto level = data.empty() ? nullptr : data.data();
+    for (u32 i = 0; i < levels; ++i) {
+      auto w = std::max(width >> i, 1u), h = std::max(height >> i, 1u);
+      auto size = gl_texture_bytes(glFormat, w, h);
+      if (glFormat == GL_RGBA8)
+        Extension::GL::glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8,
+                                    (GLsizei)w, (GLsizei)h, 0, GL_RGBA,
+                                    GL_UNSIGNED_BYTE, level);
+      else
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, glFormat, (GLsizei)w,
+                               (GLsizei)h, 0, (GLsizei)size, level);
+      if (level) level += size;
+    }
+    Memory::track_gpu_texture((i64)total);
+
+    return m_Textures.insert(
+        Extra::TextureObject{texture, width, height, glFormat, levels});
+  }
+
+  // Texture view of a buffer for texelFetch in shaders. Height is zero, the
+  // memory belongs to the buffer and is tracked there.
+  TextureHandle create_texture_buffer(BufferHandle buffer, GLenum format) {
+    auto bufferObject = m_Buffers.get(buffer);
+    if (!bufferObject) return {};
+
+    GLuint texture;
+    ::glGenTextures(1, &texture);
+    ::glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, bufferObject->buffer);
+
+    return m_Textures.insert(
+        Extra::TextureObject{texture, bufferObject->size, 0, format, 1});
+  }
+
+  const Extra::ProgramObject *get_program(ProgramHandle handle) const {
+    return m_Programs.get(handle);
+  }
+
+  const Extra::BufferObject *get_buffer(BufferHandle handle) const {
+    return m_Buffers.get(handle);
+  }
+
+  const Extra::TextureObject *get_texture(TextureHandle handle) const {
+    return m_Textures.get(handle);
+  }
+
+  const Extra::BufferDescriptor *get_vertex_array(
+      VertexArrayHandle handle) const {
+    return m_VertexArrays.get(handle);
+  }
+
+  // Release functions can be called from any thread. The handle becomes
+  // stale at the start of the next frame and the GL objects are deleted
+  // once the GPU finished the frames which may still use them.
+  void release_program(ProgramHandle handle) {
+    queue_release({PendingRelease::e_Program, handle.value});
+  }
+
+  void release_buffer(BufferHandle handle) {
+    queue_release({PendingRelease::e_Buffer, handle.value});
+  }
+
+  void release_texture(TextureHandle handle) {
+    queue_release({PendingRelease::e_Texture, handle.value});
+  }
+
+  // Also releases the vertex and index buffers of the vertex array.
+  void release_vertex_array(VertexArrayHandle handle) {
+    queue_release({PendingRelease::e_VertexArray, handle.value});
+  }
+
+  // Blocks until every released resource has been deleted. Should be called
+  // before the context goes away.
+  void flush_releases() {
+    process_requests();
+    collect_releases();
+    reclaim_releases(true);
+  }
+
+  // Requests below can be made from any thread. They are executed by the
+  // thread which owns the context at the start of the next frame, and the
+  // returned future becomes ready once the resource is created.
+  void submit(std::function<void(GLContext &)> command) {
+    m_Requests.push(std::move(command));
+  }
+
+  std::future<BufferHandle> request_buffer(GLenum target, std::vector<u8> data,
+                                           GLenum usage = GL_STATIC_DRAW) {
+    auto promise = std::make_shared<std::promise<BufferHandle>>();
+    auto future = promise->get_future();
+    submit([=, data = std::move(data)](GLContext &ctx) {
+      promise->set_value(ctx.create_buffer(target, (u32)data.size(),
+                                           data.data(), usage));
+    });
+    return future;
+  }
+
+  std::future<TextureHandle> request_texture(u32 width, u32 height,
+                                             std::vector<u8> pixels) {
+    auto promise = std::make_shared<std::promise<TextureHandle>>();
+    auto future = promise->get_future();
+    submit([=, pixels = std::move(pixels)](GLContext &ctx) {
+      promise->set_value(ctx.create_texture(
+          width, height, pixels.empty() ? nullptr : pixels.data()));
+    });
+    return future;
+  }
+
+  // Invalid handle is returned when compiling or linking fails.
+  std::future<ProgramHandle> request_program(std::string vertexSrc,
+                                             std::string fragSrc) {
+    auto promise = std::make_shared<std::promise<ProgramHandle>>();
+    auto future = promise->get_future();
+    submit([=](GLContext &ctx) {
+      std::string vertShaderSrc, fragShaderSrc;
+      GLuint vertShader, fragShader;
+      if (!ctx.compile_vertex_shader(vertexSrc, vertShaderSrc, vertShader)) {
+        promise->set_value({});
+        return;
+      }
+      if (!ctx.compile_pixel_shader(fragSrc, fragShaderSrc, fragShader)) {
+        glDeleteShader(vertShader);
+        promise->set_value({});
+        return;
+      }
+      promise->set_value(ctx.create_program(vertShader, fragShader));
+    });
+    return future;
+  }
+
+  // Execute the requests which were made by the other threads (GL thread
+  // only). Called at the start of every frame.
+  void process_requests() {
+    m_Requests.drain([this](auto &command) { command(*this); });
   }
 
 //  https://stackoverflow.com/questions/35414826/draw-opengl-renderbuffer-to-screen
@@ -481,63 +781,401 @@ class GLContext {
 
   }
 
-  std::unique_ptr<Extra::BufferDescriptor> create_quad_buffer(GLuint program) {
-    GLuint VBO, VAO, IBO;
+  VertexArrayHandle create_quad_buffer(ProgramHandle program) {
+    GLuint VAO;
 
     // Create vertex array
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
-    // Create vertex buffer
-    glGenBuffers(1, &VBO);
-    static GLfloat vertexData[] = {
-        // x, y, r, g, b, a
-        -0.5f, 0.5f,  0.f, 1.f, 0.f, 1.f, 0.5f, -0.5f, 1.f, 0.f, 0.f, 1.f,
-        -0.5f, -0.5f, 0.f, 0.f, 1.f, 1.f, 0.5f, 0.5f,  1.f, 1.f, 0.f, 1.f};
+    // Create vertex buffer and upload quad vertex data into server. Packed
+    // vertices: snorm16 positions, unorm16 texture coordinates and RGBA8
+    // colors, 12 bytes instead of 24.
+    using Primitive::pack_rgba8;
+    static const Primitive::PackedVertex vertexData[] = {
+        {{-16384, 16384}, {0, 0}, pack_rgba8(0.f, 1.f, 0.f, 1.f)},
+        {{16384, -16384}, {65535, 65535}, pack_rgba8(1.f, 0.f, 0.f, 1.f)},
+        {{-16384, -16384}, {0, 65535}, pack_rgba8(0.f, 0.f, 1.f, 1.f)},
+        {{16384, 16384}, {65535, 0}, pack_rgba8(1.f, 1.f, 0.f, 1.f)}};
+    auto VBO = create_buffer(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData,
+                             GL_STATIC_DRAW);
+
+    // Create index buffer and upload index data into server
+    const GLushort indexData[] = {0, 1, 2, 0, 3, 1};
+    auto IBO = create_buffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(indexData),
+                             indexData, GL_STATIC_DRAW);
+
+    set_vertex_layout<Primitive::PackedVertex>();
+
+    auto stride = (u32)sizeof(Primitive::PackedVertex);
+    return m_VertexArrays.insert(Extra::BufferDescriptor(
+        VAO, VBO, IBO, stride, 0, ARRAYSIZE(vertexData), ARRAYSIZE(indexData)));
+  }
+
+  // Attribute setup of the bound vertex array, derived from the vertex
+  // layout. Attribute i goes to location firstLocation + i, bufferOffset is
+  // where the vertices start in the bound GL_ARRAY_BUFFER. Every call has
+  // constant arguments, there is no loop over the layout at runtime.
+  template <typename Vertex>
+  void set_vertex_layout(u32 firstLocation = 0, uintptr_t bufferOffset = 0) {
+    static_assert(is_valid_vertex_layout<Vertex>(),
+                  "Vertex attributes overlap or do not fit the vertex!");
+    constexpr auto &attributes = VertexLayout<Vertex>::attributes;
+
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((glEnableVertexAttribArray(firstLocation + (u32)I),
+        glVertexAttribPointer(
+            firstLocation + (u32)I,
+            (GLint)vertex_format_components(attributes[I].format),
+            gl_vertex_type(attributes[I].format),
+            gl_vertex_normalized(attributes[I].format), sizeof(Vertex),
+            (GLvoid *)(bufferOffset + attributes[I].offset))),
+       ...);
+    }(std::make_index_sequence<vertex_attribute_count<Vertex>()>{});
+  }
+
+  // Vertex array for the sprite batches. Vertex streams are not interleaved:
+  // positions, texture coordinates and colors each fill one block of the
+  // buffer, so the quad kernel output can be uploaded as it is. Indices are
+  // 16-bit, so a batch has at most 16384 sprites.
+  VertexArrayHandle create_sprite_batch_buffer(u32 maxSprites) {
+    assert(maxSprites * 4 <= 65536 && "Sprite batch needs 32-bit indices!");
 
-    // Upload quad vertex data into server
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData,
-                 GL_STATIC_DRAW);
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
 
-    // Create index buffer
-    glGenBuffers(1, &IBO);
-    GLuint indexData[] = {0, 1, 2, 0, 3, 1};
+    auto positionBytes =
+        maxSprites * SpriteVertexStreams::Positions * (u32)sizeof(i16);
+    auto texCoordBytes =
+        maxSprites * SpriteVertexStreams::TexCoords * (u32)sizeof(u16);
+    auto colorBytes =
+        maxSprites * SpriteVertexStreams::Colors * (u32)sizeof(u32);
+    auto VBO = create_buffer(GL_ARRAY_BUFFER,
+                             positionBytes + texCoordBytes + colorBytes,
+                             nullptr, GL_STREAM_DRAW);
+
+    // Two triangles per quad, the index buffer never changes
+    std::vector<GLushort> indexData(maxSprites * 6);
+    for (u32 i = 0; i < maxSprites; ++i) {
+      const u32 quad[] = {0, 1, 2, 0, 2, 3};
+      for (u32 k = 0; k < 6; ++k)
+        indexData[i * 6 + k] = (GLushort)(i * 4 + quad[k]);
+    }
+    auto IBO = create_buffer(GL_ELEMENT_ARRAY_BUFFER,
+                             (u32)(indexData.size() * sizeof(GLushort)),
+                             indexData.data(), GL_STATIC_DRAW);
+
+    // 13.3 fixed point positions are scaled in the shader
+    set_vertex_layout<SpriteVertexStreams::Position>(0, 0);
+    set_vertex_layout<SpriteVertexStreams::TexCoord>(1, positionBytes);
+    set_vertex_layout<SpriteVertexStreams::Color>(
+        2, positionBytes + texCoordBytes);
+
+    return m_VertexArrays.insert(Extra::BufferDescriptor(
+        VAO, VBO, IBO, 0, 0, maxSprites * 4, maxSprites * 6));
+  }
 
-    // Upload index data into server
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indexData), indexData,
-                 GL_STATIC_DRAW);
+  // Upload count sprites generated by the quad kernel and draw them, the
+  // program maps pixels to clip space with the viewport uniform.
+  void draw_sprite_batch(VertexArrayHandle vertexArray, ProgramHandle program,
+                         TextureHandle texture,
+                         const SpriteVertexStreams &streams, u32 count,
+                         f32 viewportWidth, f32 viewportHeight) {
+    auto bufferDescriptor = m_VertexArrays.get(vertexArray);
+    auto programObject = m_Programs.get(program);
+    auto textureObject = m_Textures.get(texture);
+    if (!bufferDescriptor || !programObject || !textureObject || count == 0)
+      return;
+
+    auto vbo = m_Buffers.get(bufferDescriptor->VBO);
+    auto maxSprites = bufferDescriptor->vertexCount / 4;
+    assert(count <= maxSprites && "Sprite batch is too big for the buffer!");
+
+    glBindVertexArray(bufferDescriptor->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo->buffer);
+
+    // Orphan the storage so the driver does not wait for the last draw
+    glBufferData(GL_ARRAY_BUFFER, vbo->size, nullptr, GL_STREAM_DRAW);
+
+    auto positionBytes = SpriteVertexStreams::Positions * sizeof(i16);
+    auto texCoordBytes = SpriteVertexStreams::TexCoords * sizeof(u16);
+    auto colorBytes = SpriteVertexStreams::Colors * sizeof(u32);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * positionBytes,
+                    streams.positions);
+    glBufferSubData(GL_ARRAY_BUFFER, maxSprites * positionBytes,
+                    count * texCoordBytes, streams.texCoords);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    maxSprites * (positionBytes + texCoordBytes),
+                    count * colorBytes, streams.colors);
+
+    glUseProgram(programObject->program);
+    glActiveTexture(GL_TEXTURE0);
+    ::glBindTexture(GL_TEXTURE_2D, textureObject->texture);
+    glUniform1i(glGetUniformLocation(programObject->program, "uTexture"), 0);
+    glUniform2f(glGetUniformLocation(programObject->program, "uViewport"),
+                viewportWidth, viewportHeight);
+    glDrawElementsInstanced(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT,
+                            (GLvoid *)0, 1);
+  }
 
-    auto stride = 2;
-    auto offset = 6;
+  // Record buffer for vertex pulling: the vertex array is empty, the
+  // shader reads the SpriteRecords through a RGBA32UI texture buffer, two
+  // texels per sprite.
+  struct SpriteRecordBuffer {
+    VertexArrayHandle vertexArray;
+    TextureHandle records;
+  };
 
-    // Enable and select vertex attributes
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, offset * sizeof(GLfloat),
-                          nullptr);
+  SpriteRecordBuffer create_sprite_record_buffer(u32 maxSprites) {
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, offset * sizeof(GLfloat),
-                          (GLvoid *)(3 * sizeof(GLfloat)));
+    auto buffer = create_buffer(GL_TEXTURE_BUFFER,
+                                maxSprites * (u32)sizeof(SpriteRecord),
+                                nullptr, GL_STREAM_DRAW);
+    auto records = create_texture_buffer(buffer, GL_RGBA32UI);
+    auto vertexArray = m_VertexArrays.insert(
+        Extra::BufferDescriptor(VAO, buffer, BufferHandle{}, 0, 0, 0, 0));
 
-    return std::move(std::make_unique<Extra::BufferDescriptor>(
-        VAO, VBO, IBO, stride, offset,
-        sizeof(vertexData) / stride * sizeof(GLfloat), ARRAYSIZE(indexData)));
+    return {vertexArray, records};
   }
 
+  // One glDrawArrays for count sprites, six vertices each.
+  void draw_sprite_records(const SpriteRecordBuffer &recordBuffer,
+                           ProgramHandle program, TextureHandle texture,
+                           const SpriteRecord *records, u32 count,
+                           f32 viewportWidth, f32 viewportHeight) {
+    auto bufferDescriptor = m_VertexArrays.get(recordBuffer.vertexArray);
+    auto recordTexture = m_Textures.get(recordBuffer.records);
+    auto textureObject = m_Textures.get(texture);
+    auto programObject = m_Programs.get(program);
+    if (!bufferDescriptor || !recordTexture || !textureObject ||
+        !programObject || count == 0)
+      return;
+
+    auto buffer = m_Buffers.get(bufferDescriptor->VBO);
+    assert(count * sizeof(SpriteRecord) <= buffer->size &&
+           "Sprite records do not fit the buffer!");
+
+    // Orphan, then upload only what is drawn
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer->buffer);
+    glBufferData(GL_TEXTURE_BUFFER, buffer->size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof(SpriteRecord),
+                    records);
+
+    glUseProgram(programObject->program);
+    glActiveTexture(GL_TEXTURE0);
+    ::glBindTexture(GL_TEXTURE_2D, textureObject->texture);
+    glUniform1i(glGetUniformLocation(programObject->program, "uTexture"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    ::glBindTexture(GL_TEXTURE_BUFFER, recordTexture->texture);
+    glUniform1i(glGetUniformLocation(programObject->program, "uSprites"), 1);
+    glUniform2f(glGetUniformLocation(programObject->program, "uViewport"),
+                viewportWidth, viewportHeight);
+
+    glBindVertexArray(bufferDescriptor->VAO);
+    ::glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(count * 6));
+  }
+
+  // Frames started so far, counted up by next_frame.
+  u64 frame_index() const { return m_FrameIndex; }
+
   void next_frame() {
+    ++m_FrameIndex;
+    process_requests();
+    reclaim_releases(false);
+    collect_releases();
+
     Extension::GL::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     Extension::GL::glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
   }
 
-  void draw_command(Extra::BufferDescriptor *bufferDescriptor, GLuint program) {
-    glUseProgram(program);
+  void draw_command(VertexArrayHandle vertexArray, ProgramHandle program) {
+    auto bufferDescriptor = m_VertexArrays.get(vertexArray);
+    auto programObject = m_Programs.get(program);
+
+    // Stale handles are skipped rather than drawing with a reused name
+    if (!bufferDescriptor || !programObject) return;
+
+    glUseProgram(programObject->program);
+    glBindVertexArray(bufferDescriptor->VAO);
     glDrawElementsInstanced(GL_TRIANGLES, bufferDescriptor->indexCount,
-                            GL_UNSIGNED_INT, (GLvoid *)0, 1);
+                            GL_UNSIGNED_SHORT, (GLvoid *)0, 1);
   }
 
  private:
+  bool compile_shader(GLenum type, std::span<const u8> src, GLuint &shader) {
+    shader = glCreateShader(type);
+
+    auto shaderSrc = (const GLchar *)src.data();
+    auto length = (GLint)src.size();
+    CHECK(glShaderSource(shader, 1, &shaderSrc, &length));
+    CHECK(glCompileShader(shader));
+
+    GLint isCompiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if (isCompiled == GL_FALSE) {
+      GLint maxLength = 0;
+      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+      std::vector<GLchar> infoLog(maxLength);
+      glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+
+      std::string log(infoLog.begin(), infoLog.end());
+      std::cerr << log << std::endl;
+
+      glDeleteShader(shader);
+      return false;
+    }
+    return true;
+  }
+
+  struct PendingRelease {
+    enum Kind { e_Program, e_Buffer, e_Texture, e_VertexArray };
+
+    Kind kind{e_Program};
+    u32 handle{0};
+  };
+
+  // GL names released in the same frame, deleted together once the fence
+  // which was inserted after that frame is signaled.
+  struct DestructionBatch {
+    GLsync fence{nullptr};
+    u64 frameIndex{0};
+    std::vector<GLuint> programs;
+    std::vector<GLuint> shaders;
+    std::vector<GLuint> buffers;
+    std::vector<GLuint> textures;
+    std::vector<GLuint> vertexArrays;
+  };
+
+  // Frames to wait before deleting when sync objects are not supported
+  static constexpr u64 MaxFramesInFlight = 3;
+
+  void queue_release(PendingRelease release) {
+    m_PendingReleases.push(release);
+  }
+
+  // Every level, as tracked when the texture was created. Zero for texture
+  // buffers, their memory is the buffer's.
+  static u64 texture_bytes(const Extra::TextureObject &texture) {
+    u64 total = 0;
+    for (u32 i = 0; i < texture.levels && texture.height; ++i)
+      total += gl_texture_bytes(texture.format,
+                                std::max(texture.width >> i, 1u),
+                                std::max(texture.height >> i, 1u));
+    return total;
+  }
+
+  // Resolve pending releases to GL names and fence them (GL thread only)
+  void collect_releases() {
+    if (m_PendingReleases.empty()) return;
+
+    DestructionBatch batch;
+    batch.frameIndex = m_FrameIndex;
+
+    auto collect_buffer = [&](BufferHandle handle) {
+      if (auto buffer = m_Buffers.get(handle)) {
+        batch.buffers.push_back(buffer->buffer);
+        Memory::track_gpu_buffer(-(i64)buffer->size);
+        m_Buffers.erase(handle);
+      }
+    };
+
+    m_PendingReleases.drain([&](const PendingRelease &release) {
+      switch (release.kind) {
+        case PendingRelease::e_Program: {
+          ProgramHandle handle;
+          handle.value = release.handle;
+          if (auto program = m_Programs.get(handle)) {
+            batch.programs.push_back(program->program);
+            batch.shaders.push_back(program->vertShader);
+            batch.shaders.push_back(program->fragShader);
+            m_Programs.erase(handle);
+          }
+          break;
+        }
+        case PendingRelease::e_Buffer: {
+          BufferHandle handle;
+          handle.value = release.handle;
+          collect_buffer(handle);
+          break;
+        }
+        case PendingRelease::e_Texture: {
+          TextureHandle handle;
+          handle.value = release.handle;
+          if (auto texture = m_Textures.get(handle)) {
+            batch.textures.push_back(texture->texture);
+            Memory::track_gpu_texture(-(i64)texture_bytes(*texture));
+            m_Textures.erase(handle);
+          }
+          break;
+        }
+        case PendingRelease::e_VertexArray: {
+          VertexArrayHandle handle;
+          handle.value = release.handle;
+          if (auto vertexArray = m_VertexArrays.get(handle)) {
+            batch.vertexArrays.push_back(vertexArray->VAO);
+            collect_buffer(vertexArray->VBO);
+            collect_buffer(vertexArray->IBO);
+            m_VertexArrays.erase(handle);
+          }
+          break;
+        }
+      }
+    });
+
+    if (glFenceSync)
+      batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_DestructionBatches.push_back(std::move(batch));
+  }
+
+  // Delete the batches which the GPU is done with, oldest first
+  void reclaim_releases(bool wait) {
+    while (!m_DestructionBatches.empty()) {
+      auto &batch = m_DestructionBatches.front();
+
+      if (batch.fence) {
+        auto result = glClientWaitSync(batch.fence,
+                                       wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                       wait ? ~0ull : 0);
+        if (result != GL_ALREADY_SIGNALED &&
+            result != GL_CONDITION_SATISFIED && !wait)
+          break;
+        glDeleteSync(batch.fence);
+      } else if (!wait &&
+                 m_FrameIndex - batch.frameIndex < MaxFramesInFlight) {
+        break;
+      }
+
+      if (!batch.vertexArrays.empty())
+        glDeleteVertexArrays((GLsizei)batch.vertexArrays.size(),
+                             batch.vertexArrays.data());
+      if (!batch.buffers.empty())
+        glDeleteBuffers((GLsizei)batch.buffers.size(), batch.buffers.data());
+      if (!batch.textures.empty())
+        ::glDeleteTextures((GLsizei)batch.textures.size(),
+                           batch.textures.data());
+      for (auto program : batch.programs) glDeleteProgram(program);
+      for (auto shader : batch.shaders) glDeleteShader(shader);
+
+      m_DestructionBatches.pop_front();
+    }
+  }
+
+  MpscQueue<std::function<void(GLContext &)>> m_Requests;
+  MpscQueue<PendingRelease> m_PendingReleases;
+  std::deque<DestructionBatch> m_DestructionBatches;
+  u64 m_FrameIndex{0};
+
+  // Resource tables, the metadata is kept in dense arrays and addressed
+  // thru generational handles.
+  SlotMap<Extra::ProgramObject, ProgramTag> m_Programs;
+  SlotMap<Extra::BufferObject, BufferTag> m_Buffers;
+  SlotMap<Extra::TextureObject, TextureTag> m_Textures;
+  SlotMap<Extra::BufferDescriptor, VertexArrayTag> m_VertexArrays;
+
 #ifdef _WIN32
   HWND m_WindowHandle{0};
   HINSTANCE m_Instance;
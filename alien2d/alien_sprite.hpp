@@ -48,22 +48,26 @@ class Sprite : public Alien::IRenderable {
     const std::string vertexSrc = R"(
 /* vertex attributes go here to input to the vertex shader */
 struct vs_in {
-    float3 position_local : POS;
+    float2 position_local : POS;
+    float2 uv : TEXCOORD;
+    float4 color : COL;
 };
 
 /* outputs from vertex shader go here. can be interpolated to pixel shader */
 struct vs_out {
     float4 position_clip : SV_POSITION; // required output of VS
+    float4 color : COL;
 };
 
 vs_out vs_main(vs_in input) {
   vs_out output = (vs_out)0; // zero the memory first
-  output.position_clip = float4(input.position_local, 1.0);
+  output.position_clip = float4(input.position_local, 0.0, 1.0);
+  output.color = input.color;
   return output;
 }
 
 float4 ps_main(vs_out input) : SV_TARGET {
-  return float4( input.position_clip ); // must return an RGBA colour
+  return input.color; // must return an RGBA colour
 })";
 
     // vertex and fragment shaders are combined into only one sources.
@@ -78,15 +82,16 @@ float4 ps_main(vs_out input) : SV_TARGET {
 #else
     const std::string vertexSrc = R"(
 #version 330 core
-layout (location = 0) in vec3 aPos; // the position variable has attribute position 0
-layout (location = 1) in vec3 aCol;
+layout (location = 0) in vec2 aPos; // the position variable has attribute position 0
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec4 aCol;
 
 out vec4 vertexColor; // specify a color output to the fragment shader
 
 void main()
 {
-  vertexColor = vec4(aCol,1.0);
-  gl_Position = vec4(aPos, 1.0f); // see how we directly give a vec3 to vec4's constructor
+  vertexColor = aCol;
+  gl_Position = vec4(aPos, 0.0, 1.0);
 })";
 
     const std::string fragSrc = R"(
@@ -100,32 +105,47 @@ void main()
     FragColor = vertexColor;
 })";
 
-    m_VertexShaderSrc = vertexSrc;
-    m_FragShaderSrc = fragSrc;
+    std::string vertexShaderSrc, fragShaderSrc;
+    GLuint vertShader, fragShader;
 
-    Context->compile_vertex_shader(vertexSrc, m_VertexShaderSrc, m_VertShader);
-    Context->compile_pixel_shader(fragSrc, m_FragShaderSrc, m_FragShader);
-    Context->create_program(m_Program, m_VertShader, m_FragShader);
+    Context->compile_vertex_shader(vertexSrc, vertexShaderSrc, vertShader);
+    Context->compile_pixel_shader(fragSrc, fragShaderSrc, fragShader);
+    m_Program = Context->create_program(vertShader, fragShader);
 
-    m_BufferDesc = std::move(Context->create_quad_buffer(m_Program));
+    m_VertexArray = Context->create_quad_buffer(m_Program);
 #endif
   }
 
   void on_draw() override {
 #ifdef ALIEN_DX11
-    Context->physicalDevice.next_frame();
     Context->physicalDevice.draw_command(m_BufferDesc.get(), m_VertShader,
                                          m_FragShader);
 #else
-    Context->next_frame();
-    Context->draw_command(m_BufferDesc.get(), m_Program);
+    Context->draw_command(m_VertexArray, m_Program);
 #endif
   }
 
-  void on_release() override{
+  void on_release() override {
 #ifdef ALIEN_DX11
-
+    // D3D11 keeps the objects alive until the GPU is done with them, so they
+    // can be released right away.
+    if (m_BufferDesc) {
+      m_BufferDesc->buffer->Release();
+      m_BufferDesc->indexBuffer->Release();
+      m_BufferDesc->inputLayout->Release();
+      m_BufferDesc.reset();
+    }
+    if (m_VertShader) m_VertShader->Release();
+    if (m_FragShader) m_FragShader->Release();
+    if (m_FragShaderBlob) m_FragShaderBlob->Release();
+    m_VertShader = nullptr;
+    m_FragShader = nullptr;
+    m_FragShaderBlob = nullptr;
 #else
+    Context->release_vertex_array(m_VertexArray);
+    Context->release_program(m_Program);
+    m_VertexArray = {};
+    m_Program = {};
 #endif
   }
 
@@ -134,19 +154,16 @@ void main()
   ID3DBlob *m_FragShaderBlob = nullptr;
   ID3D11VertexShader *m_VertShader = nullptr;
   ID3D11PixelShader *m_FragShader = nullptr;
+  std::unique_ptr<Extra::BufferDescriptor> m_BufferDesc;
 
   static inline Alien::DX11Context *Context{nullptr};
 #else
-  std::string m_VertexShaderSrc;
-  std::string m_FragShaderSrc;
-  GLuint m_VertShader;
-  GLuint m_FragShader;
-  GLuint m_Program;
+  // Shaders are owned by the program record in the context
+  ProgramHandle m_Program;
+  VertexArrayHandle m_VertexArray;
 
   static inline Alien::GLContext* Context{nullptr};
 #endif
-
-  std::unique_ptr<Extra::BufferDescriptor> m_BufferDesc;
 };
 }  // namespace Alien
 
@@ -0,0 +1,242 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_TRANSFORM_HPP
+#define ALIEN_TRANSFORM_HPP
+
+#include <algorithm>
+
+#include "base.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "slot_map.hpp"
+
+namespace Alien {
+using TransformHandle = Handle<struct TransformTag>;
+
+// Scene hierarchy of 2D affine transforms stored as flat arrays in
+// depth-first order, so the subtree of a node is the contiguous range
+// [index, subtreeEnd). set_local marks a node dirty; update() recomputes
+// the world matrices of the dirty subtrees only, one depth level after
+// the other and each level in parallel.
+//
+// Structural changes move array entries and cost O(n), except appending a
+// node at the end of the arrays (a root, or a child of the last subtree
+// when a tree is built depth-first) which is O(depth).
+class TransformHierarchy {
+ public:
+  TransformHandle create(const Math::Mat3x2 &local,
+                         TransformHandle parent = {}) {
+    auto parentIndex = index_of(parent);
+    assert((!parent || parentIndex != InvalidIndex) && "Parent is stale!");
+    clear_updated();
+
+    auto count = size();
+    auto pos = count;
+    u32 depth = 0;
+    if (parentIndex != InvalidIndex) {
+      pos = m_SubtreeEnd[parentIndex];
+      depth = m_Depth[parentIndex] + 1;
+    }
+
+    // Indices at and after pos move one slot forward
+    if (pos != count) {
+      for (u32 k = 0; k < count; ++k) {
+        if (m_Parent[k] != InvalidIndex && m_Parent[k] >= pos) ++m_Parent[k];
+        if (m_SubtreeEnd[k] > pos) ++m_SubtreeEnd[k];
+      }
+    }
+    // Ancestors whose range ended exactly at pos now contain the node
+    for (auto a = parentIndex; a != InvalidIndex; a = m_Parent[a]) {
+      if (m_SubtreeEnd[a] == pos) ++m_SubtreeEnd[a];
+    }
+
+    auto handle = m_Nodes.insert(pos);
+    m_Local.insert(m_Local.begin() + pos, local);
+    m_World.insert(m_World.begin() + pos, local);
+    m_Parent.insert(m_Parent.begin() + pos, parentIndex);
+    m_SubtreeEnd.insert(m_SubtreeEnd.begin() + pos, pos + 1);
+    m_Depth.insert(m_Depth.begin() + pos, depth);
+    m_Dirty.insert(m_Dirty.begin() + pos, 0);
+    m_Handles.insert(m_Handles.begin() + pos, handle);
+    reindex(pos + 1);
+
+    mark_dirty(pos);
+    return handle;
+  }
+
+  // Destroys the node and its whole subtree.
+  void destroy(TransformHandle node) {
+    auto index = index_of(node);
+    if (index == InvalidIndex) return;
+
+    clear_updated();
+    auto end = m_SubtreeEnd[index];
+    auto removed = end - index;
+    for (auto k = index; k < end; ++k) m_Nodes.erase(m_Handles[k]);
+
+    auto erase = [&](auto &column) {
+      column.erase(column.begin() + index, column.begin() + end);
+    };
+    erase(m_Local);
+    erase(m_World);
+    erase(m_Parent);
+    erase(m_SubtreeEnd);
+    erase(m_Depth);
+    erase(m_Dirty);
+    erase(m_Handles);
+
+    // Ancestors end at or after end, so they shrink with the rest
+    for (u32 k = 0; k < size(); ++k) {
+      if (m_Parent[k] != InvalidIndex && m_Parent[k] >= end)
+        m_Parent[k] -= removed;
+      if (m_SubtreeEnd[k] >= end) m_SubtreeEnd[k] -= removed;
+    }
+    reindex(index);
+  }
+
+  void set_local(TransformHandle node, const Math::Mat3x2 &local) {
+    auto index = index_of(node);
+    if (index == InvalidIndex) return;
+
+    m_Local[index] = local;
+    mark_dirty(index);
+  }
+
+  const Math::Mat3x2 *local(TransformHandle node) const {
+    auto index = index_of(node);
+    return index == InvalidIndex ? nullptr : &m_Local[index];
+  }
+
+  // World matrix as of the last update().
+  const Math::Mat3x2 *world(TransformHandle node) const {
+    auto index = index_of(node);
+    return index == InvalidIndex ? nullptr : &m_World[index];
+  }
+
+  TransformHandle parent(TransformHandle node) const {
+    auto index = index_of(node);
+    if (index == InvalidIndex || m_Parent[index] == InvalidIndex) return {};
+    return m_Handles[m_Parent[index]];
+  }
+
+  bool contains(TransformHandle node) const { return m_Nodes.contains(node); }
+  u32 size() const { return (u32)m_Local.size(); }
+
+  // Recomputes the world matrices of the dirty subtrees.
+  void update(JobSystem &jobs = JobSystem::instance()) {
+    clear_updated();
+
+    // Subtree ranges are nested or disjoint, so in index order a dirty
+    // node inside the previous range is already covered by it.
+    m_DirtyIndices.clear();
+    for (auto handle : m_DirtyHandles) {
+      auto index = index_of(handle);
+      if (index == InvalidIndex) continue;
+      m_Dirty[index] = 0;
+      m_DirtyIndices.push_back(index);
+    }
+    m_DirtyHandles.clear();
+    std::sort(m_DirtyIndices.begin(), m_DirtyIndices.end());
+
+    u32 coveredEnd = 0;
+    for (auto index : m_DirtyIndices) {
+      if (index < coveredEnd) continue;
+      coveredEnd = m_SubtreeEnd[index];
+      for (auto k = index; k < coveredEnd; ++k) {
+        if (m_Depth[k] >= m_Levels.size()) m_Levels.resize(m_Depth[k] + 1);
+        m_Levels[m_Depth[k]].push_back(k);
+      }
+    }
+
+    // A level only reads the world matrices of the level above
+    for (auto &level : m_Levels) {
+      jobs.parallel_for((u32)level.size(), 4096, [&](u32 begin, u32 end) {
+        for (auto i = begin; i < end; ++i) {
+          auto k = level[i];
+          auto p = m_Parent[k];
+          m_World[k] = p == InvalidIndex ? m_Local[k] : m_World[p] * m_Local[k];
+        }
+      });
+    }
+  }
+
+  // Calls f(handle, world) for every node recomputed by the last update,
+  // e.g. to copy the transforms of moved nodes to their sprites. Creating
+  // or destroying nodes forgets them.
+  template <typename F>
+  void for_each_updated(F &&f) const {
+    for (const auto &level : m_Levels) {
+      for (auto k : level) f(m_Handles[k], m_World[k]);
+    }
+  }
+
+ private:
+  static constexpr u32 InvalidIndex = 0xFFFFFFFF;
+
+  u32 index_of(TransformHandle node) const {
+    auto index = m_Nodes.get(node);
+    return index ? *index : InvalidIndex;
+  }
+
+  void mark_dirty(u32 index) {
+    if (m_Dirty[index]) return;
+    m_Dirty[index] = 1;
+    m_DirtyHandles.push_back(m_Handles[index]);
+  }
+
+  void clear_updated() {
+    for (auto &level : m_Levels) level.clear();
+  }
+
+  // Points the handles of the nodes from first on at their new positions.
+  void reindex(u32 first) {
+    for (auto k = first; k < size(); ++k) *m_Nodes.get(m_Handles[k]) = k;
+  }
+
+  template <typename T>
+  using Column = Memory::Vector<T, Memory::e_Game>;
+
+  // Handle -> position in the columns
+  SlotMap<u32, TransformTag> m_Nodes;
+
+  Column<Math::Mat3x2> m_Local;
+  Column<Math::Mat3x2> m_World;
+  Column<u32> m_Parent;
+  Column<u32> m_SubtreeEnd;
+  Column<u32> m_Depth;
+  Column<u8> m_Dirty;
+  Column<TransformHandle> m_Handles;
+
+  Column<TransformHandle> m_DirtyHandles;
+  Column<u32> m_DirtyIndices;
+  // Recomputed nodes of the last update grouped by depth
+  std::vector<Column<u32>> m_Levels;
+};
+}  // namespace Alien
+
+#endif
@@ -68,14 +68,16 @@ added later as well.
 #endif
 #endif
 
+#include "base.hpp"
+
 #ifdef _WIN32
 #include <Windows.h>
 #endif
 
 #include "alien_dx11.hpp"
 #include "alien_gl.hpp"
-#include "base.hpp"
 #include "math.hpp"
+#include "memory.hpp"
 
 namespace Alien {
 // Queue type
@@ -289,9 +291,12 @@ class App {
 
   AppState m_AppState;
 
-  std::vector<std::function<void(AppState &)>> m_UpdateQueue;
-  std::vector<std::function<void(AppState &)>> m_InitQueue;
-  std::vector<std::function<void(AppState &)>> m_KillQueue;
+  using EventQueue =
+      Memory::Vector<std::function<void(AppState &)>, Memory::e_Events>;
+
+  EventQueue m_UpdateQueue;
+  EventQueue m_InitQueue;
+  EventQueue m_KillQueue;
 
   static inline std::unordered_map<Event,
                                    std::function<void(std::unique_ptr<IEvent>)>>
@@ -0,0 +1,528 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_ATI_HPP
+#define ALIEN_ATI_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+
+// Engine texture format (.ati), lossless RGBA8 made for decode speed.
+// Like QOI there is no entropy coder and one pass decodes the pixels, but
+// the residuals are stored as bit planes of a fixed width per group, so
+// decoding has no per-pixel branches and maps onto SIMD. The image is split
+// in square tiles coded on their own, which decode in parallel.
+//
+// Each pixel is predicted with left + up - upleft (within its tile) and
+// the green residual is subtracted from red and blue. Residuals are zigzag
+// mapped and stored per channel in groups of 16 pixels of a row: a 2 byte
+// header of four 4-bit widths, then for every channel the width low bit
+// planes of pixels 0-7, then of pixels 8-15, one byte each. Little endian:
+//
+//   "ATI1" | width | height | tile size | tile count     u32 each
+//   offsets[tile count + 1]                             u32, from the data
+//   tile data                                           row major tiles
+namespace Alien::Ati {
+struct Info {
+  u32 width;
+  u32 height;
+  u32 tileSize;
+};
+
+static constexpr u32 DefaultTileSize = 128;
+
+namespace Detail {
+static constexpr u8 Magic[4] = {'A', 'T', 'I', '1'};
+static constexpr u32 HeaderSize = 20;
+static constexpr u32 MaxSize = 1u << 16;
+static constexpr u32 GroupPixels = 16;
+// Header plus four channels of 8 planes
+static constexpr u32 MaxGroupBytes = 2 + 4 * 16;
+
+// The low w bytes, for loading w planes at once
+static constexpr u64 PlaneMask[9] = {
+    0x0ull,
+    0xFFull,
+    0xFFFFull,
+    0xFFFFFFull,
+    0xFFFFFFFFull,
+    0xFFFFFFFFFFull,
+    0xFFFFFFFFFFFFull,
+    0xFFFFFFFFFFFFFFull,
+    0xFFFFFFFFFFFFFFFFull};
+
+inline u32 read_le32(const u8 *p) {
+  return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+inline void write_le32(u8 *p, u32 v) {
+  for (u32 i = 0; i < 4; ++i) p[i] = (u8)(v >> (i * 8));
+}
+
+// Targets are little endian, so this is a single load.
+inline u64 read_le64(const u8 *p) {
+  u64 v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+// Small residuals of either sign become small unsigned values.
+inline u8 zigzag(u8 v) { return (u8)(v << 1 ^ (v & 0x80 ? 0xFF : 0)); }
+inline u8 unzigzag(u8 z) { return (u8)(z >> 1 ^ (0 - (z & 1))); }
+
+// Transposes the 8x8 bit matrix in x, bit j of byte i goes to bit i of
+// byte j. Turns 8 values into their bit planes and back.
+inline u64 transpose8(u64 x) {
+  auto t = (x ^ x >> 7) & 0x00AA00AA00AA00AAull;
+  x ^= t ^ t << 7;
+  t = (x ^ x >> 14) & 0x0000CCCC0000CCCCull;
+  x ^= t ^ t << 14;
+  t = (x ^ x >> 28) & 0x00000000F0F0F0F0ull;
+  return x ^ t ^ t << 28;
+}
+
+inline bool valid_widths(const u8 *p) {
+  return (p[0] & 15) <= 8 && p[0] >> 4 <= 8 && (p[1] & 15) <= 8 &&
+         p[1] >> 4 <= 8;
+}
+
+inline u32 group_bytes(const u8 *p) {
+  return 2 + 2 * ((p[0] & 15u) + (p[0] >> 4u) + (p[1] & 15u) + (p[1] >> 4u));
+}
+
+struct Layout {
+  Info info;
+  u32 tilesX;
+  u32 tileCount;
+  const u8 *offsets;
+  const u8 *tiles;
+  u64 tilesSize;
+};
+
+inline bool parse(const u8 *data, u64 size, Layout &layout) {
+  if (size < HeaderSize || std::memcmp(data, Magic, 4) != 0) return false;
+  auto &info = layout.info;
+  info.width = read_le32(data + 4);
+  info.height = read_le32(data + 8);
+  info.tileSize = read_le32(data + 12);
+  layout.tileCount = read_le32(data + 16);
+  if (!info.width || !info.height || info.width > MaxSize ||
+      info.height > MaxSize || info.tileSize < GroupPixels ||
+      info.tileSize > 4096)
+    return false;
+
+  layout.tilesX = (info.width + info.tileSize - 1) / info.tileSize;
+  auto tilesY = (info.height + info.tileSize - 1) / info.tileSize;
+  if (layout.tileCount != layout.tilesX * tilesY) return false;
+
+  auto tableSize = ((u64)layout.tileCount + 1) * 4;
+  if (size - HeaderSize < tableSize) return false;
+  layout.offsets = data + HeaderSize;
+  layout.tiles = layout.offsets + tableSize;
+  layout.tilesSize = size - HeaderSize - tableSize;
+
+  // Offsets have to grow and stay inside the file
+  u32 previous = 0;
+  for (u32 i = 0; i <= layout.tileCount; ++i) {
+    auto offset = read_le32(layout.offsets + (u64)i * 4);
+    if (offset < previous || offset > layout.tilesSize) return false;
+    previous = offset;
+  }
+  return true;
+}
+
+inline void encode_tile(const u8 *pixels, u32 pitch, u32 width, u32 height,
+                        Memory::Vector<u8, Memory::e_Assets> &out) {
+  // Pixels outside the tile predict as zero
+  auto at = [&](i32 x, i32 y, u32 c) -> u8 {
+    return x < 0 || y < 0 ? 0 : pixels[(u64)y * pitch + x * 4 + c];
+  };
+
+  u8 residuals[4][GroupPixels];
+  for (u32 y = 0; y < height; ++y) {
+    for (u32 group = 0; group < width; group += GroupPixels) {
+      std::memset(residuals, 0, sizeof(residuals));
+      for (u32 i = 0; i < GroupPixels && group + i < width; ++i) {
+        i32 x = group + i;
+        u8 r[4];
+        for (u32 c = 0; c < 4; ++c)
+          r[c] = (u8)(at(x, y, c) - at(x - 1, y, c) - at(x, y - 1, c) +
+                      at(x - 1, y - 1, c));
+        r[0] = (u8)(r[0] - r[1]);
+        r[2] = (u8)(r[2] - r[1]);
+        for (u32 c = 0; c < 4; ++c) residuals[c][i] = zigzag(r[c]);
+      }
+
+      u32 widths[4] = {};
+      for (u32 c = 0; c < 4; ++c) {
+        u32 bits = 0;
+        for (auto v : residuals[c]) bits |= v;
+        while (bits >> widths[c]) ++widths[c];
+      }
+      out.push_back((u8)(widths[0] | widths[1] << 4));
+      out.push_back((u8)(widths[2] | widths[3] << 4));
+
+      for (u32 c = 0; c < 4; ++c) {
+        for (u32 half = 0; half < 2; ++half) {
+          auto planes = transpose8(read_le64(residuals[c] + half * 8));
+          for (u32 i = 0; i < widths[c]; ++i)
+            out.push_back((u8)(planes >> (i * 8)));
+        }
+      }
+    }
+  }
+}
+}  // namespace Detail
+
+namespace Kernel {
+// Decodes a row of groups into out; up is the row above with 4 zero bytes
+// before it. Reads up to 8 bytes past the data of the row.
+#if defined(ALIEN_MATH_SSE2)
+inline __m128i transpose8(__m128i x) {
+  auto t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 7)),
+                         _mm_set1_epi64x(0x00AA00AA00AA00AAll));
+  x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 7)));
+  t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 14)),
+                    _mm_set1_epi64x(0x0000CCCC0000CCCCll));
+  x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 14)));
+  t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 28)),
+                    _mm_set1_epi64x(0x00000000F0F0F0F0ll));
+  return _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 28)));
+}
+
+inline const u8 *decode_row(const u8 *p, const u8 *up, u8 *out, u32 groups) {
+  auto zero = _mm_setzero_si128();
+  auto ones = _mm_set1_epi8(1);
+  auto low7 = _mm_set1_epi8(0x7F);
+  auto red = _mm_set1_epi32(0x000000FF), blue = _mm_set1_epi32(0x00FF0000);
+  auto carry = zero;
+  for (u32 group = 0; group < groups; ++group) {
+    u32 widths[4] = {p[0] & 15u, (u32)p[0] >> 4, p[1] & 15u, (u32)p[1] >> 4};
+    p += 2;
+    __m128i channels[4];
+    for (u32 c = 0; c < 4; ++c) {
+      auto mask = Detail::PlaneMask[widths[c]];
+      auto lo = Detail::read_le64(p) & mask;
+      auto hi = Detail::read_le64(p + widths[c]) & mask;
+      channels[c] = transpose8(_mm_set_epi64x((long long)hi, (long long)lo));
+      p += widths[c] * 2;
+    }
+
+    auto rg = _mm_unpacklo_epi8(channels[0], channels[1]);
+    auto ba = _mm_unpacklo_epi8(channels[2], channels[3]);
+    auto rg8 = _mm_unpackhi_epi8(channels[0], channels[1]);
+    auto ba8 = _mm_unpackhi_epi8(channels[2], channels[3]);
+    __m128i pixels[4] = {
+        _mm_unpacklo_epi16(rg, ba), _mm_unpackhi_epi16(rg, ba),
+        _mm_unpacklo_epi16(rg8, ba8), _mm_unpackhi_epi16(rg8, ba8)};
+
+    for (u32 i = 0; i < 4; ++i) {
+      auto offset = (group * 4 + i) * 16;
+      auto z = pixels[i];
+      auto v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), low7),
+                             _mm_sub_epi8(zero, _mm_and_si128(z, ones)));
+      // Green back into red and blue
+      auto green = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 8), red),
+                                _mm_and_si128(_mm_slli_epi32(v, 8), blue));
+      v = _mm_add_epi8(v, green);
+      v = _mm_add_epi8(
+          v, _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(up + offset)),
+                          _mm_loadu_si128((const __m128i *)(up + offset - 4))));
+      // Running sum over the pixels of the row
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+      v = _mm_add_epi8(v, carry);
+      _mm_storeu_si128((__m128i *)(out + offset), v);
+      carry = _mm_shuffle_epi32(v, 0xFF);
+    }
+  }
+  return p;
+}
+#elif defined(ALIEN_MATH_NEON)
+inline uint8x16_t transpose8(uint8x16_t v) {
+  auto x = vreinterpretq_u64_u8(v);
+  auto t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 7)),
+                     vdupq_n_u64(0x00AA00AA00AA00AAull));
+  x = veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 7)));
+  t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 14)),
+                vdupq_n_u64(0x0000CCCC0000CCCCull));
+  x = veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 14)));
+  t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 28)),
+                vdupq_n_u64(0x00000000F0F0F0F0ull));
+  return vreinterpretq_u8_u64(veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 28))));
+}
+
+inline const u8 *decode_row(const u8 *p, const u8 *up, u8 *out, u32 groups) {
+  auto zero = vdupq_n_u8(0);
+  auto red = vreinterpretq_u8_u32(vdupq_n_u32(0x000000FF));
+  auto blue = vreinterpretq_u8_u32(vdupq_n_u32(0x00FF0000));
+  auto carry = zero;
+  for (u32 group = 0; group < groups; ++group) {
+    u32 widths[4] = {p[0] & 15u, (u32)p[0] >> 4, p[1] & 15u, (u32)p[1] >> 4};
+    p += 2;
+    uint8x16_t channels[4];
+    for (u32 c = 0; c < 4; ++c) {
+      auto mask = Detail::PlaneMask[widths[c]];
+      auto lo = Detail::read_le64(p) & mask;
+      auto hi = Detail::read_le64(p + widths[c]) & mask;
+      channels[c] =
+          transpose8(vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(lo),
+                                                       vcreate_u64(hi))));
+      p += widths[c] * 2;
+    }
+
+    auto rg = vzipq_u8(channels[0], channels[1]);
+    auto ba = vzipq_u8(channels[2], channels[3]);
+    auto lo = vzipq_u16(vreinterpretq_u16_u8(rg.val[0]),
+                        vreinterpretq_u16_u8(ba.val[0]));
+    auto hi = vzipq_u16(vreinterpretq_u16_u8(rg.val[1]),
+                        vreinterpretq_u16_u8(ba.val[1]));
+    uint8x16_t pixels[4] = {
+        vreinterpretq_u8_u16(lo.val[0]), vreinterpretq_u8_u16(lo.val[1]),
+        vreinterpretq_u8_u16(hi.val[0]), vreinterpretq_u8_u16(hi.val[1])};
+
+    for (u32 i = 0; i < 4; ++i) {
+      auto offset = (group * 4 + i) * 16;
+      auto z = pixels[i];
+      auto v = veorq_u8(vshrq_n_u8(z, 1),
+                        vsubq_u8(zero, vandq_u8(z, vdupq_n_u8(1))));
+      auto v32 = vreinterpretq_u32_u8(v);
+      auto green =
+          vorrq_u8(vandq_u8(vreinterpretq_u8_u32(vshrq_n_u32(v32, 8)), red),
+                   vandq_u8(vreinterpretq_u8_u32(vshlq_n_u32(v32, 8)), blue));
+      v = vaddq_u8(v, green);
+      v = vaddq_u8(v,
+                   vsubq_u8(vld1q_u8(up + offset), vld1q_u8(up + offset - 4)));
+      v = vaddq_u8(v, vextq_u8(zero, v, 12));
+      v = vaddq_u8(v, vextq_u8(zero, v, 8));
+      v = vaddq_u8(v, carry);
+      vst1q_u8(out + offset, v);
+      carry = vreinterpretq_u8_u32(
+          vdupq_n_u32(vgetq_lane_u32(vreinterpretq_u32_u8(v), 3)));
+    }
+  }
+  return p;
+}
+#else
+inline const u8 *decode_row(const u8 *p, const u8 *up, u8 *out, u32 groups) {
+  u8 left[4] = {};
+  for (u32 group = 0; group < groups; ++group) {
+    u32 widths[4] = {p[0] & 15u, (u32)p[0] >> 4, p[1] & 15u, (u32)p[1] >> 4};
+    p += 2;
+    u64 channels[4][2];
+    for (u32 c = 0; c < 4; ++c) {
+      auto mask = Detail::PlaneMask[widths[c]];
+      channels[c][0] = Detail::transpose8(Detail::read_le64(p) & mask);
+      channels[c][1] =
+          Detail::transpose8(Detail::read_le64(p + widths[c]) & mask);
+      p += widths[c] * 2;
+    }
+
+    for (u32 i = 0; i < Detail::GroupPixels; ++i) {
+      u8 v[4];
+      for (u32 c = 0; c < 4; ++c)
+        v[c] = Detail::unzigzag((u8)(channels[c][i / 8] >> (i % 8 * 8)));
+      v[0] = (u8)(v[0] + v[1]);
+      v[2] = (u8)(v[2] + v[1]);
+      auto offset = (group * Detail::GroupPixels + i) * 4;
+      auto above = up + offset, upLeft = above - 4;
+      for (u32 c = 0; c < 4; ++c) {
+        left[c] = (u8)(left[c] + v[c] + above[c] - upLeft[c]);
+        out[offset + c] = left[c];
+      }
+    }
+  }
+  return p;
+}
+#endif
+}  // namespace Kernel
+
+namespace Detail {
+// Row bytes of a tile, whole groups
+inline u64 row_bytes(u32 width) {
+  return (u64)(width + GroupPixels - 1) / GroupPixels * GroupPixels * 4;
+}
+
+// Scratch of decode_tile: two rows with 16 bytes in front and the data of
+// one row with room to read past it.
+inline u64 tile_scratch_size(u32 tileSize) {
+  return row_bytes(tileSize) * 2 + 32 +
+         (tileSize + GroupPixels - 1) / GroupPixels * MaxGroupBytes + 8;
+}
+
+// Decodes the tile data in [p, end). Bytes up to limit may be read.
+inline bool decode_tile(const u8 *p, const u8 *end, const u8 *limit,
+                        u8 *pixels, u32 pitch, u32 width, u32 height,
+                        u8 *scratch) {
+  auto groups = (width + GroupPixels - 1) / GroupPixels;
+  auto rowBytes = row_bytes(width);
+  u8 *rows[2] = {scratch + 16, scratch + rowBytes + 32};
+  auto tail = scratch + rowBytes * 2 + 32;
+  // Rows start zero, the row above the tile included
+  std::memset(scratch, 0, rowBytes * 2 + 32);
+
+  for (u32 y = 0; y < height; ++y) {
+    // Sizes are checked up front so the kernel needs no checks
+    auto next = p;
+    for (u32 group = 0; group < groups; ++group) {
+      if (end - next < 2 || !valid_widths(next)) return false;
+      auto size = group_bytes(next);
+      if ((u64)(end - next) < size) return false;
+      next += size;
+    }
+    auto data = p;
+    if (limit - next < 8) {
+      std::memcpy(tail, p, (u64)(next - p));
+      std::memset(tail + (next - p), 0, 8);
+      data = tail;
+    }
+
+    auto row = rows[y & 1];
+    Kernel::decode_row(data, rows[(y + 1) & 1], row, groups);
+    std::memcpy(pixels + (u64)y * pitch, row, (u64)width * 4);
+    p = next;
+  }
+  return true;
+}
+}  // namespace Detail
+
+inline bool read_info(const u8 *data, u64 size, Info &info) {
+  Detail::Layout layout;
+  if (!Detail::parse(data, size, layout)) return false;
+  info = layout.info;
+  return true;
+}
+
+// Decodes to RGBA8 rows pitch bytes apart, one tile per job. Every byte of
+// pixels is written once, so it can point straight at mapped upload
+// memory.
+inline bool decode(const u8 *data, u64 size, u8 *pixels, u32 pitch,
+                   JobSystem &jobs = JobSystem::instance()) {
+  Detail::Layout layout;
+  if (!Detail::parse(data, size, layout)) return false;
+
+  const auto &info = layout.info;
+  std::atomic<bool> ok{true};
+  jobs.parallel_for(layout.tileCount, 1, [&](u32 begin, u32 end) {
+    Memory::Vector<u8, Memory::e_Assets> scratch(
+        Detail::tile_scratch_size(info.tileSize));
+    for (auto tile = begin; tile < end; ++tile) {
+      auto x = tile % layout.tilesX * info.tileSize;
+      auto y = tile / layout.tilesX * info.tileSize;
+      auto first = Detail::read_le32(layout.offsets + (u64)tile * 4);
+      auto last = Detail::read_le32(layout.offsets + (u64)tile * 4 + 4);
+      auto out = pixels + (u64)y * pitch + (u64)x * 4;
+      if (!Detail::decode_tile(layout.tiles + first, layout.tiles + last,
+                               data + size, out, pitch,
+                               std::min(info.tileSize, info.width - x),
+                               std::min(info.tileSize, info.height - y),
+                               scratch.data()))
+        ok.store(false, std::memory_order_relaxed);
+    }
+  });
+  return ok.load(std::memory_order_relaxed);
+}
+
+inline bool load(const u8 *data, u64 size, Image &image,
+                 JobSystem &jobs = JobSystem::instance()) {
+  Info info;
+  if (!read_info(data, size, info)) return false;
+
+  image.width = info.width;
+  image.height = info.height;
+  image.pixels.resize((u64)info.width * info.height * 4);
+  return decode(data, size, image.pixels.data(), info.width * 4, jobs);
+}
+
+// Decodes the files in parallel. The tiles of each file are jobs too.
+inline void decode_all(DecodeTask *tasks, u32 count,
+                       JobSystem &jobs = JobSystem::instance()) {
+  jobs.parallel_for(count, 1, [&](u32 begin, u32 end) {
+    for (auto i = begin; i < end; ++i) {
+      auto &task = tasks[i];
+      task.ok = decode(task.data, task.size, task.pixels, task.pitch, jobs);
+    }
+  });
+}
+
+// Encodes RGBA8 rows pitch bytes apart, the tiles in parallel. Meant for
+// offline conversion, see tools/ati_convert.cpp.
+inline bool encode(const u8 *pixels, u32 width, u32 height, u32 pitch,
+                   Memory::Vector<u8, Memory::e_Assets> &out,
+                   u32 tileSize = DefaultTileSize,
+                   JobSystem &jobs = JobSystem::instance()) {
+  if (!width || !height || width > Detail::MaxSize ||
+      height > Detail::MaxSize || tileSize < Detail::GroupPixels ||
+      tileSize > 4096)
+    return false;
+
+  auto tilesX = (width + tileSize - 1) / tileSize;
+  auto tileCount = tilesX * ((height + tileSize - 1) / tileSize);
+  Memory::Vector<Memory::Vector<u8, Memory::e_Assets>, Memory::e_Assets>
+      tiles(tileCount);
+  jobs.parallel_for(tileCount, 1, [&](u32 begin, u32 end) {
+    for (auto tile = begin; tile < end; ++tile) {
+      auto x = tile % tilesX * tileSize, y = tile / tilesX * tileSize;
+      Detail::encode_tile(pixels + (u64)y * pitch + (u64)x * 4, pitch,
+                          std::min(tileSize, width - x),
+                          std::min(tileSize, height - y), tiles[tile]);
+    }
+  });
+
+  u64 total = 0;
+  for (auto &tile : tiles) total += tile.size();
+  if (total > 0xFFFFFFFFull) return false;
+
+  auto tableSize = ((u64)tileCount + 1) * 4;
+  out.resize(Detail::HeaderSize + tableSize + total);
+  auto p = out.data();
+  std::memcpy(p, Detail::Magic, 4);
+  Detail::write_le32(p + 4, width);
+  Detail::write_le32(p + 8, height);
+  Detail::write_le32(p + 12, tileSize);
+  Detail::write_le32(p + 16, tileCount);
+
+  auto table = p + Detail::HeaderSize;
+  auto data = table + tableSize;
+  u32 offset = 0;
+  for (u32 i = 0; i < tileCount; ++i) {
+    Detail::write_le32(table + (u64)i * 4, offset);
+    std::memcpy(data + offset, tiles[i].data(), tiles[i].size());
+    offset += (u32)tiles[i].size();
+  }
+  Detail::write_le32(table + (u64)tileCount * 4, offset);
+  return true;
+}
+}  // namespace Alien::Ati
+
+#endif
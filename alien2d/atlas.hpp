@@ -0,0 +1,659 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_ATLAS_HPP
+#define ALIEN_ATLAS_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "alien_batch.hpp"
+#include "base.hpp"
+#include "image.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "pack.hpp"
+
+// Texture atlas table (.atl), where the images of an atlas ended up in its
+// pages. Names are hashed like pack names, there are no strings at run
+// time. Little endian:
+//
+//   "ATL1" | page count | entry count                   u32 each
+//   pages[page count]                                  u32 width | height
+//   hashes[entry count]                                u64, sorted
+//   entries[entry count]                               in the order of hashes
+//
+// An entry is u16 page | u16 flags | u16 x | y | width | height of the
+// rectangle in the page | u16 source width | height | u16 offset x | y of
+// the rectangle in the source image, before any rotation. Trimmed images
+// are smaller than their source; rotated ones are stored turned 90 degrees
+// clockwise, so their width and height in the page are swapped.
+namespace Alien::Atlas {
+struct Rect {
+  u32 x, y, width, height;
+};
+
+// Where an image is in the atlas, ready to point a sprite at.
+struct Region {
+  u32 page;
+  bool rotated;
+  // u0, v0, u1, v1 of the stored rectangle
+  Math::Vec4 uvRect;
+  // Size of the image before trimming, and the part of it which is stored
+  Math::Vec2 sourceSize;
+  Math::Vec2 offset;
+  Math::Vec2 size;
+};
+
+// Points a sprite at its image in the atlas. The sprite is set up as if it
+// showed the whole source image: scale is its drawn size and pivot is
+// relative to it. Trimming and rotation are folded into scale, pivot and
+// rotation, so this is called once, not on a sprite which was set before.
+// Vertex pulling stores the pivot as unorm16, so trimmed sprites whose
+// pivot falls outside the stored part need vertex streams.
+inline void apply(const Region &region, SpriteInstance &sprite) {
+  auto scaleX = sprite.scale.x / region.sourceSize.x;
+  auto scaleY = sprite.scale.y / region.sourceSize.y;
+  auto pivotX =
+      (sprite.pivot.x * region.sourceSize.x - region.offset.x) / region.size.x;
+  auto pivotY =
+      (sprite.pivot.y * region.sourceSize.y - region.offset.y) / region.size.y;
+
+  sprite.uvRect = region.uvRect;
+  if (!region.rotated) {
+    sprite.scale = {region.size.x * scaleX, region.size.y * scaleY};
+    sprite.pivot = {pivotX, pivotY};
+    return;
+  }
+  // The stored quad is turned back a quarter turn: its x runs along the
+  // source's -y and its y along the source's x
+  sprite.scale = {region.size.y * scaleY, region.size.x * scaleX};
+  sprite.pivot = {1.0f - pivotY, pivotX};
+  sprite.rotation -= Math::Pi * 0.5f;
+}
+
+namespace Detail {
+static constexpr u8 Magic[4] = {'A', 'T', 'L', '1'};
+static constexpr u64 HeaderSize = 12;
+static constexpr u64 PageSize = 8;
+static constexpr u64 EntrySize = 20;
+static constexpr u16 Rotated = 1;
+
+inline u16 read_le16(const u8 *p) { return (u16)(p[0] | p[1] << 8); }
+
+inline void write_le16(u8 *p, u16 v) {
+  p[0] = (u8)v;
+  p[1] = (u8)(v >> 8);
+}
+}  // namespace Detail
+
+// Lookup side of a .atl file. The bytes are copied, so they can come from
+// a pack entry which is closed later.
+class Table {
+ public:
+  bool load(std::span<const u8> data) {
+    using namespace Pack::Detail;
+    m_Pages.clear();
+    m_Hashes.clear();
+    m_Entries.clear();
+
+    auto p = data.data();
+    auto size = (u64)data.size();
+    if (size < Detail::HeaderSize || std::memcmp(p, Detail::Magic, 4) != 0)
+      return false;
+    auto pageCount = (u64)read_le32(p + 4);
+    auto count = (u64)read_le32(p + 8);
+    if (size != Detail::HeaderSize + pageCount * Detail::PageSize +
+                    count * (8 + Detail::EntrySize))
+      return false;
+
+    p += Detail::HeaderSize;
+    for (u64 i = 0; i < pageCount; ++i, p += Detail::PageSize) {
+      u32 width = read_le32(p), height = read_le32(p + 4);
+      if (width == 0 || height == 0) return false;
+      m_Pages.push_back({width, height});
+    }
+    for (u64 i = 0; i < count; ++i, p += 8) {
+      m_Hashes.push_back(read_le64(p));
+      if (i > 0 && m_Hashes[i] <= m_Hashes[i - 1]) return false;
+    }
+    m_Entries.assign(p, p + count * Detail::EntrySize);
+
+    // Rectangles are checked once here, lookups trust them
+    for (u64 i = 0; i < count; ++i) {
+      auto e = m_Entries.data() + i * Detail::EntrySize;
+      auto page = Detail::read_le16(e);
+      if (page >= pageCount) return false;
+      auto &bounds = m_Pages[page];
+      u32 x = Detail::read_le16(e + 4), y = Detail::read_le16(e + 6);
+      u32 w = Detail::read_le16(e + 8), h = Detail::read_le16(e + 10);
+      if (w == 0 || h == 0 || x + w > bounds.width || y + h > bounds.height)
+        return false;
+    }
+    return true;
+  }
+
+  u32 page_count() const { return (u32)m_Pages.size(); }
+  u32 entry_count() const { return (u32)m_Hashes.size(); }
+  u32 page_width(u32 page) const { return m_Pages[page].width; }
+  u32 page_height(u32 page) const { return m_Pages[page].height; }
+
+  bool find(std::string_view name, Region &region) const {
+    return find(Pack::hash_name(name), region);
+  }
+
+  bool find(u64 hash, Region &region) const {
+    auto it = std::lower_bound(m_Hashes.begin(), m_Hashes.end(), hash);
+    if (it == m_Hashes.end() || *it != hash) return false;
+
+    auto e = m_Entries.data() + (it - m_Hashes.begin()) * Detail::EntrySize;
+    u16 v[10];
+    for (u32 i = 0; i < 10; ++i) v[i] = Detail::read_le16(e + i * 2);
+    auto &page = m_Pages[v[0]];
+    auto pageWidth = (f32)page.width, pageHeight = (f32)page.height;
+
+    region.page = v[0];
+    region.rotated = (v[1] & Detail::Rotated) != 0;
+    region.uvRect = {v[2] / pageWidth, v[3] / pageHeight,
+                     (v[2] + v[4]) / pageWidth, (v[3] + v[5]) / pageHeight};
+    region.sourceSize = {(f32)v[6], (f32)v[7]};
+    region.offset = {(f32)v[8], (f32)v[9]};
+    region.size = region.rotated ? Math::Vec2{(f32)v[5], (f32)v[4]}
+                                 : Math::Vec2{(f32)v[4], (f32)v[5]};
+    return true;
+  }
+
+ private:
+  struct Page {
+    u32 width, height;
+  };
+
+  Memory::Vector<Page, Memory::e_Assets> m_Pages;
+  Memory::Vector<u64, Memory::e_Assets> m_Hashes;
+  Memory::Vector<u8, Memory::e_Assets> m_Entries;
+};
+
+// MaxRects bin packer (Jukka Jylanki, "A Thousand Ways to Pack the Bin"):
+// keeps every maximal free rectangle and places each new one by best short
+// side fit. Slower than a skyline but packs tighter, meant for offline use.
+class MaxRects {
+ public:
+  MaxRects(u32 width, u32 height) { m_Free.push_back({0, 0, width, height}); }
+
+  // The placed rectangle is height x width when it was rotated.
+  bool insert(u32 width, u32 height, bool allowRotate, Rect &out,
+              bool &rotated) {
+    u64 bestShort = ~0ull, bestLong = ~0ull;
+    for (auto &free : m_Free) {
+      for (u32 turn = 0; turn < (allowRotate ? 2u : 1u); ++turn) {
+        auto w = turn ? height : width, h = turn ? width : height;
+        if (w > free.width || h > free.height) continue;
+        u64 leftX = free.width - w, leftY = free.height - h;
+        u64 shortSide = std::min(leftX, leftY);
+        u64 longSide = std::max(leftX, leftY);
+        if (shortSide < bestShort ||
+            (shortSide == bestShort && longSide < bestLong)) {
+          bestShort = shortSide;
+          bestLong = longSide;
+          out = {free.x, free.y, w, h};
+          rotated = turn != 0;
+        }
+      }
+    }
+    if (bestShort == ~0ull) return false;
+
+    place(out);
+    m_Used = {std::max(m_Used.x, out.x + out.width),
+              std::max(m_Used.y, out.y + out.height)};
+    return true;
+  }
+
+  // Bounds of everything placed so far
+  u32 used_width() const { return m_Used.x; }
+  u32 used_height() const { return m_Used.y; }
+
+ private:
+  struct Extent {
+    u32 x, y;
+  };
+
+  static bool contains(const Rect &a, const Rect &b) {
+    return b.x >= a.x && b.y >= a.y && b.x + b.width <= a.x + a.width &&
+           b.y + b.height <= a.y + a.height;
+  }
+
+  // Splits every free rectangle which overlaps the placed one into the
+  // up to four maximal pieces around it, then drops contained ones.
+  void place(const Rect &used) {
+    std::vector<Rect> next;
+    for (auto &free : m_Free) {
+      if (used.x >= free.x + free.width || used.x + used.width <= free.x ||
+          used.y >= free.y + free.height || used.y + used.height <= free.y) {
+        next.push_back(free);
+        continue;
+      }
+      if (used.x > free.x)
+        next.push_back({free.x, free.y, used.x - free.x, free.height});
+      if (used.x + used.width < free.x + free.width)
+        next.push_back({used.x + used.width, free.y,
+                        free.x + free.width - used.x - used.width,
+                        free.height});
+      if (used.y > free.y)
+        next.push_back({free.x, free.y, free.width, used.y - free.y});
+      if (used.y + used.height < free.y + free.height)
+        next.push_back({free.x, used.y + used.height, free.width,
+                        free.y + free.height - used.y - used.height});
+    }
+
+    m_Free.clear();
+    for (u64 i = 0; i < next.size(); ++i) {
+      bool redundant = false;
+      for (u64 j = 0; j < next.size() && !redundant; ++j) {
+        // Of two equal rectangles the later one is kept
+        if (i != j && contains(next[j], next[i]))
+          redundant = !contains(next[i], next[j]) || j > i;
+      }
+      if (!redundant) m_Free.push_back(next[i]);
+    }
+  }
+
+  Extent m_Used{0, 0};
+  std::vector<Rect> m_Free;
+};
+
+// Shelf allocator for atlases which change at run time. Rectangles go on
+// shelves, rows as tall as the rectangles on them rounded up to
+// ShelfGranularity, left to right into the free spans of the row. Freed
+// rectangles give their span back; empty shelves merge with empty
+// neighbours and can be taken over by any height, so the page does not
+// fragment into rows of one size.
+class ShelfAllocator {
+ public:
+  static constexpr u32 ShelfGranularity = 4;
+
+  ShelfAllocator(u32 width, u32 height) : m_Width(width), m_Height(height) {}
+
+  bool allocate(u32 width, u32 height, Rect &out) {
+    if (width == 0 || height == 0 || width > m_Width || height > m_Height)
+      return false;
+    auto rowHeight = std::min(
+        (height + ShelfGranularity - 1) / ShelfGranularity * ShelfGranularity,
+        m_Height);
+
+    // Shelves in use which waste at most half a row, else the smallest
+    // empty one
+    u32 best = NoShelf, bestSpan = 0;
+    for (u32 i = 0; i < m_Shelves.size(); ++i) {
+      auto &shelf = m_Shelves[i];
+      if (shelf.height < rowHeight) continue;
+      auto empty = shelf.items == 0;
+      if (!empty && shelf.height > rowHeight + rowHeight / 2) continue;
+      auto span = find_span(shelf, width);
+      if (span == NoShelf) continue;
+      if (best != NoShelf) {
+        auto &other = m_Shelves[best];
+        auto otherEmpty = other.items == 0;
+        if (empty != otherEmpty ? empty : shelf.height >= other.height)
+          continue;
+      }
+      best = i;
+      bestSpan = span;
+    }
+
+    if (best == NoShelf) {
+      if (m_Height - top() < rowHeight) return false;
+      m_Shelves.push_back({top(), rowHeight, 0, {{0, m_Width}}});
+      best = (u32)m_Shelves.size() - 1;
+      bestSpan = 0;
+    } else if (m_Shelves[best].items == 0 &&
+               m_Shelves[best].height > rowHeight) {
+      // Only the height it needs, the rest stays an empty shelf
+      auto &shelf = m_Shelves[best];
+      Shelf rest{shelf.y + rowHeight, shelf.height - rowHeight, 0,
+                 {{0, m_Width}}};
+      shelf.height = rowHeight;
+      m_Shelves.insert(m_Shelves.begin() + best + 1, std::move(rest));
+    }
+
+    auto &shelf = m_Shelves[best];
+    auto &span = shelf.spans[bestSpan];
+    out = {span.x, shelf.y, width, height};
+    span.x += width;
+    span.width -= width;
+    if (span.width == 0) shelf.spans.erase(shelf.spans.begin() + bestSpan);
+    ++shelf.items;
+    m_UsedArea += (u64)width * height;
+    return true;
+  }
+
+  // Takes a rectangle which allocate returned.
+  void free(const Rect &rect) {
+    auto it = std::upper_bound(
+        m_Shelves.begin(), m_Shelves.end(), rect.y,
+        [](u32 y, const Shelf &shelf) { return y < shelf.y; });
+    auto index = (u32)(it - m_Shelves.begin()) - 1;
+    auto &shelf = m_Shelves[index];
+    m_UsedArea -= (u64)rect.width * rect.height;
+
+    if (--shelf.items == 0) {
+      shelf.spans.assign(1, {0, m_Width});
+      merge_empty(index);
+      return;
+    }
+
+    // Spans stay sorted and are joined with their neighbours
+    auto &spans = shelf.spans;
+    auto next = std::lower_bound(
+        spans.begin(), spans.end(), rect.x,
+        [](const Span &span, u32 x) { return span.x < x; });
+    auto pos = next - spans.begin();
+    spans.insert(next, {rect.x, rect.width});
+    if ((u64)pos + 1 < spans.size() &&
+        spans[pos].x + spans[pos].width == spans[pos + 1].x) {
+      spans[pos].width += spans[pos + 1].width;
+      spans.erase(spans.begin() + pos + 1);
+    }
+    if (pos > 0 && spans[pos - 1].x + spans[pos - 1].width == spans[pos].x) {
+      spans[pos - 1].width += spans[pos].width;
+      spans.erase(spans.begin() + pos);
+    }
+  }
+
+  void clear() {
+    m_Shelves.clear();
+    m_UsedArea = 0;
+  }
+
+  // Pixels of the allocated rectangles, and of the page covered by shelves
+  u64 used_area() const { return m_UsedArea; }
+  u64 shelved_area() const { return (u64)top() * m_Width; }
+
+ private:
+  static constexpr u32 NoShelf = 0xFFFFFFFF;
+
+  struct Span {
+    u32 x, width;
+  };
+
+  struct Shelf {
+    u32 y, height;
+    u32 items;
+    std::vector<Span> spans;
+  };
+
+  u32 top() const {
+    return m_Shelves.empty() ? 0
+                             : m_Shelves.back().y + m_Shelves.back().height;
+  }
+
+  static u32 find_span(const Shelf &shelf, u32 width) {
+    for (u32 i = 0; i < shelf.spans.size(); ++i)
+      if (shelf.spans[i].width >= width) return i;
+    return NoShelf;
+  }
+
+  // Joins the empty shelf with empty neighbours, the last one goes back to
+  // the unshelved part of the page.
+  void merge_empty(u32 index) {
+    if (index + 1 < m_Shelves.size() && m_Shelves[index + 1].items == 0) {
+      m_Shelves[index].height += m_Shelves[index + 1].height;
+      m_Shelves.erase(m_Shelves.begin() + index + 1);
+    }
+    if (index > 0 && m_Shelves[index - 1].items == 0) {
+      m_Shelves[index - 1].height += m_Shelves[index].height;
+      m_Shelves.erase(m_Shelves.begin() + index);
+      --index;
+    }
+    if (index + 1 == m_Shelves.size()) m_Shelves.pop_back();
+  }
+
+  u32 m_Width, m_Height;
+  std::vector<Shelf> m_Shelves;
+  u64 m_UsedArea{0};
+};
+
+// Packs images into atlas pages and writes the table. Meant for offline
+// use, see tools/atlas_build.cpp.
+class Builder {
+ public:
+  struct Options {
+    // Pages are at most this big, trimmed to what they use
+    u32 pageSize{2048};
+    // Edge pixels are repeated this far around every image, so filtering
+    // and mips do not pick up the neighbours
+    u32 padding{2};
+    bool trim{true};
+    bool rotate{false};
+  };
+
+  // Takes RGBA8 pixels without row padding. Names have to be unique.
+  void add(std::string name, Image image) {
+    m_Items.push_back({std::move(name), std::move(image)});
+  }
+
+  // Fails when an image does not fit a page or two names share a hash.
+  // Pages are square, so rotating does not help an image to fit.
+  bool build(const Options &options) {
+    m_Pages.clear();
+    m_Placements.clear();
+    m_Placements.resize(m_Items.size());
+
+    auto maxSide = std::min(options.pageSize, 0xFFFFu);
+    Memory::Vector<u32, Memory::e_Assets> order(m_Items.size());
+    for (u32 i = 0; i < order.size(); ++i) {
+      auto &item = m_Items[i];
+      auto &placement = m_Placements[i];
+      if (item.image.width == 0 || item.image.height == 0 ||
+          item.image.width > 0xFFFF || item.image.height > 0xFFFF)
+        return false;
+      placement.trim = options.trim
+                           ? opaque_bounds(item.image)
+                           : Rect{0, 0, item.image.width, item.image.height};
+      order[i] = i;
+    }
+
+    // Big ones first, names keep the output stable
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+      auto &ra = m_Placements[a].trim, &rb = m_Placements[b].trim;
+      auto sa = std::max(ra.width, ra.height);
+      auto sb = std::max(rb.width, rb.height);
+      if (sa != sb) return sa > sb;
+      auto aa = (u64)ra.width * ra.height, ab = (u64)rb.width * rb.height;
+      if (aa != ab) return aa > ab;
+      return m_Items[a].name < m_Items[b].name;
+    });
+
+    std::vector<MaxRects> bins;
+    auto pad = options.padding * 2;
+    for (auto i : order) {
+      auto &placement = m_Placements[i];
+      auto width = placement.trim.width + pad;
+      auto height = placement.trim.height + pad;
+      if (width > maxSide || height > maxSide) return false;
+
+      Rect rect;
+      bool placed = false;
+      for (u32 page = 0; page < bins.size() && !placed; ++page) {
+        placed = bins[page].insert(width, height, options.rotate, rect,
+                                   placement.rotated);
+        placement.page = page;
+      }
+      if (!placed) {
+        if (bins.size() > 0xFFFF) return false;
+        bins.emplace_back(maxSide, maxSide);
+        placement.page = (u32)bins.size() - 1;
+        bins.back().insert(width, height, options.rotate, rect,
+                           placement.rotated);
+      }
+      placement.rect = {rect.x + options.padding, rect.y + options.padding,
+                        rect.width - pad, rect.height - pad};
+    }
+
+    // Multiples of 4 keep the pages block compressible
+    for (auto &bin : bins) {
+      Image page;
+      page.width = (bin.used_width() + 3) & ~3u;
+      page.height = (bin.used_height() + 3) & ~3u;
+      page.pixels.resize((u64)page.width * page.height * 4);
+      m_Pages.push_back(std::move(page));
+    }
+    for (u32 i = 0; i < m_Items.size(); ++i) blit(i, options.padding);
+    return write_table();
+  }
+
+  const std::vector<Image> &pages() const { return m_Pages; }
+  std::span<const u8> table() const { return m_Table; }
+
+ private:
+  struct Item {
+    std::string name;
+    Image image;
+  };
+
+  struct Placement {
+    Rect trim;
+    u32 page;
+    // In the page, without the padding
+    Rect rect;
+    bool rotated;
+  };
+
+  // Smallest rectangle with every pixel which is not fully transparent.
+  // Empty images keep one pixel.
+  static Rect opaque_bounds(const Image &image) {
+    u32 x0 = image.width, y0 = image.height, x1 = 0, y1 = 0;
+    for (u32 y = 0; y < image.height; ++y) {
+      auto row = image.pixels.data() + (u64)y * image.width * 4;
+      for (u32 x = 0; x < image.width; ++x) {
+        if (row[x * 4 + 3] == 0) continue;
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x + 1);
+        y0 = std::min(y0, y);
+        y1 = y + 1;
+      }
+    }
+    if (x1 == 0) return {0, 0, 1, 1};
+    return {x0, y0, x1 - x0, y1 - y0};
+  }
+
+  // Copies the trimmed image into its page and repeats its edges into the
+  // padding.
+  void blit(u32 index, u32 padding) {
+    auto &image = m_Items[index].image;
+    auto &placement = m_Placements[index];
+    auto &page = m_Pages[placement.page];
+    auto &trim = placement.trim;
+    auto &rect = placement.rect;
+    auto pixel = [&](u32 x, u32 y) {
+      return (u32 *)page.pixels.data() + (u64)y * page.width + x;
+    };
+    auto source = (const u32 *)image.pixels.data();
+
+    for (u32 y = 0; y < rect.height; ++y) {
+      auto out = pixel(rect.x, rect.y + y);
+      for (u32 x = 0; x < rect.width; ++x) {
+        // Turned clockwise: page x walks up the source, page y along it
+        auto sx = placement.rotated ? trim.x + y : trim.x + x;
+        auto sy = placement.rotated ? trim.y + trim.height - 1 - x : trim.y + y;
+        std::memcpy(out + x, source + (u64)sy * image.width + sx, 4);
+      }
+    }
+
+    if (padding == 0) return;
+    for (u32 y = 0; y < rect.height; ++y) {
+      auto row = pixel(rect.x, rect.y + y);
+      for (u32 i = 1; i <= padding; ++i) {
+        row[-(i64)i] = row[0];
+        row[rect.width - 1 + i] = row[rect.width - 1];
+      }
+    }
+    auto width = (rect.width + padding * 2) * 4;
+    auto first = pixel(rect.x - padding, rect.y);
+    auto last = pixel(rect.x - padding, rect.y + rect.height - 1);
+    for (u32 i = 1; i <= padding; ++i) {
+      std::memcpy(pixel(rect.x - padding, rect.y - i), first, width);
+      std::memcpy(pixel(rect.x - padding, rect.y + rect.height - 1 + i), last,
+                  width);
+    }
+  }
+
+  bool write_table() {
+    using namespace Pack::Detail;
+    auto count = (u64)m_Items.size();
+    Memory::Vector<u32, Memory::e_Assets> order(count);
+    for (u32 i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+      return Pack::hash_name(m_Items[a].name) <
+             Pack::hash_name(m_Items[b].name);
+    });
+
+    m_Table.assign(Detail::HeaderSize + m_Pages.size() * Detail::PageSize +
+                       count * (8 + Detail::EntrySize),
+                   0);
+    auto p = m_Table.data();
+    std::memcpy(p, Detail::Magic, 4);
+    write_le32(p + 4, (u32)m_Pages.size());
+    write_le32(p + 8, (u32)count);
+    p += Detail::HeaderSize;
+    for (auto &page : m_Pages) {
+      write_le32(p, page.width);
+      write_le32(p + 4, page.height);
+      p += Detail::PageSize;
+    }
+
+    auto entries = p + count * 8;
+    for (u64 i = 0; i < count; ++i) {
+      auto &item = m_Items[order[i]];
+      auto &placement = m_Placements[order[i]];
+      auto hash = Pack::hash_name(item.name);
+      // Equal names collide too
+      if (i > 0 && hash == Pack::hash_name(m_Items[order[i - 1]].name))
+        return false;
+      write_le64(p + i * 8, hash);
+
+      const u32 v[10] = {placement.page,        placement.rotated,
+                         placement.rect.x,      placement.rect.y,
+                         placement.rect.width,  placement.rect.height,
+                         item.image.width,      item.image.height,
+                         placement.trim.x,      placement.trim.y};
+      auto e = entries + i * Detail::EntrySize;
+      for (u32 k = 0; k < 10; ++k) Detail::write_le16(e + k * 2, (u16)v[k]);
+    }
+    return true;
+  }
+
+  std::vector<Item> m_Items;
+  std::vector<Placement> m_Placements;
+  std::vector<Image> m_Pages;
+  Memory::Vector<u8, Memory::e_Assets> m_Table;
+};
+}  // namespace Alien::Atlas
+
+#endif
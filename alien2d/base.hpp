@@ -23,11 +23,22 @@ SOFTWARE.
 */
 #ifdef _WIN32
 #pragma once
-#elif
+#endif
 #ifndef BASE_HPP
 #define BASE_HPP
+
+// Headers include this before <Windows.h>, which would otherwise define
+// min and max macros that break std::min and std::max.
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
 #endif
 #endif
+
+#include <cstdint>
 #include <iostream>
 #include <cassert>
 #include <vector>
@@ -47,8 +58,4 @@ using i64 = long long;
 using f32 = float;
 using f64 = double;
 
-#ifndef _WIN32
-#ifndef BASE_HPP
-#define BASE_HPP
-#endif
 #endif
\ No newline at end of file
@@ -0,0 +1,430 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_BC_HPP
+#define ALIEN_BC_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+
+// Block compressed textures. BC1 (DXT1) stores a 4x4 block of opaque
+// pixels in 8 bytes, BC3 (DXT5) adds 8 bytes of alpha: 1/8 and 1/4 of
+// RGBA8 in memory and on the bus, and the GPU samples them as they are.
+//
+// The encoder is the real-time one (J.M.P. van Waveren, "Real-Time DXT
+// Compression"): the endpoints are the corners of the inset bounding box of
+// the block colors, turned along the strongest channel correlation, and
+// every pixel takes the nearest of the 4 colors by projecting onto the
+// line between them. Fast enough for load time, a little behind the slow
+// encoders in quality.
+//
+// Texture file (.btx), little endian:
+//
+//   "BTX1" | format | width | height | levels          u32 each
+//   levels                                           largest first, blocks
+//                                                    row by row
+namespace Alien::Bc {
+static constexpr u32 BlockSize = 4;
+
+inline u32 block_bytes(TextureFormat format) {
+  return format == e_BC1 ? 8 : 16;
+}
+
+// Bytes of one level, partial blocks at the edges count as whole ones.
+inline u64 level_size(TextureFormat format, u32 width, u32 height) {
+  return (u64)((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+// View of a parsed .btx file.
+struct Texture {
+  TextureFormat format;
+  u32 width;
+  u32 height;
+  u32 levels;
+  // Every level, in order
+  std::span<const u8> data;
+};
+
+namespace Detail {
+static constexpr u8 Magic[4] = {'B', 'T', 'X', '1'};
+static constexpr u32 HeaderSize = 20;
+
+inline u32 read_le32(const u8 *p) {
+  return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+inline void write_le32(u8 *p, u32 v) {
+  for (u32 i = 0; i < 4; ++i) p[i] = (u8)(v >> (i * 8));
+}
+
+inline u16 to_565(u32 r, u32 g, u32 b) {
+  return (u16)((r * 31 + 127) / 255 << 11 | (g * 63 + 127) / 255 << 5 |
+               (b * 31 + 127) / 255);
+}
+
+// Back to 8 bits per channel the way the GPU does it
+inline void from_565(u16 c, i32 rgb[3]) {
+  auto r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = r << 3 | r >> 2;
+  rgb[1] = g << 2 | g >> 4;
+  rgb[2] = b << 3 | b >> 2;
+}
+
+// Bit i moves to bit 2i.
+inline u32 spread_bits(u32 x) {
+  x = (x | x << 8) & 0x00FF00FF;
+  x = (x | x << 4) & 0x0F0F0F0F;
+  x = (x | x << 2) & 0x33333333;
+  return (x | x << 1) & 0x55555555;
+}
+
+// The 4x4 block at (bx, by) in blocks, edge pixels repeated past the
+// image. With skipClear, fully transparent pixels take the color of an
+// opaque one so they do not pull the endpoints.
+inline void load_block(const u8 *pixels, u32 pitch, u32 width, u32 height,
+                       u32 bx, u32 by, bool skipClear, u32 block[16]) {
+  for (u32 y = 0; y < 4; ++y) {
+    auto row = pixels + (u64)std::min(by * 4 + y, height - 1) * pitch;
+    for (u32 x = 0; x < 4; ++x)
+      std::memcpy(block + y * 4 + x, row + std::min(bx * 4 + x, width - 1) * 4,
+                  4);
+  }
+  if (!skipClear) return;
+  u32 fill = 0;
+  for (u32 i = 0; i < 16 && !fill; ++i)
+    if (block[i] >> 24) fill = block[i] & 0xFFFFFF;
+  for (u32 i = 0; i < 16; ++i)
+    if (!(block[i] >> 24)) block[i] = fill;
+}
+
+// Two 565 endpoints of the block from its per channel minimum and maximum.
+// Returns false when they are equal, every index is zero then.
+inline bool color_endpoints(const u32 block[16], u32 lo, u32 hi, u16 &c0,
+                            u16 &c1) {
+  i32 mn[3], mx[3];
+  for (u32 c = 0; c < 3; ++c) {
+    mn[c] = (lo >> (c * 8)) & 0xFF;
+    mx[c] = (hi >> (c * 8)) & 0xFF;
+    // Inset by 1/16 of the range, the box corners are rarely in the block
+    auto inset = (mx[c] - mn[c]) >> 4;
+    mn[c] += inset;
+    mx[c] -= inset;
+  }
+
+  // The box diagonal runs from min to max in every channel. Channels which
+  // fall while the widest one rises get their ends swapped.
+  u32 ref = 0;
+  for (u32 c = 1; c < 3; ++c)
+    if (mx[c] - mn[c] > mx[ref] - mn[ref]) ref = c;
+  i32 center[3];
+  for (u32 c = 0; c < 3; ++c) center[c] = mn[c] + mx[c];
+  i32 cov[3] = {0, 0, 0};
+  for (u32 i = 0; i < 16; ++i) {
+    i32 p[3];
+    for (u32 c = 0; c < 3; ++c)
+      p[c] = (i32)((block[i] >> (c * 8)) & 0xFF) * 2 - center[c];
+    for (u32 c = 0; c < 3; ++c) cov[c] += p[ref] * p[c];
+  }
+  for (u32 c = 0; c < 3; ++c)
+    if (cov[c] < 0) std::swap(mn[c], mx[c]);
+
+  c0 = to_565(mx[0], mx[1], mx[2]);
+  c1 = to_565(mn[0], mn[1], mn[2]);
+  // c0 > c1 picks the 4 color mode of BC1
+  if (c0 < c1) std::swap(c0, c1);
+  return c0 != c1;
+}
+
+// Projection of a pixel onto the endpoint line is compared against these,
+// the level is how many it passes, from c1 (0) to c0 (3).
+struct ColorLine {
+  i32 dir[3];
+  i32 thresholds[3];
+};
+
+inline ColorLine color_line(u16 c0, u16 c1) {
+  ColorLine line;
+  i32 p0[3], p1[3];
+  from_565(c0, p0);
+  from_565(c1, p1);
+  i32 length = 0, base = 0;
+  for (u32 c = 0; c < 3; ++c) {
+    line.dir[c] = p0[c] - p1[c];
+    length += line.dir[c] * line.dir[c];
+    base += p1[c] * line.dir[c];
+  }
+  // 6 dot(p, dir) > 6 dot(p1, dir) + (2k + 1) |dir|^2
+  for (u32 k = 0; k < 3; ++k)
+    line.thresholds[k] = base * 6 + length * (i32)(2 * k + 1);
+  return line;
+}
+
+// Levels to BC1 indices: 0 is c0, 1 is c1, 2 and 3 lie between
+inline u32 color_indices(u32 pass1, u32 pass2, u32 pass3) {
+  auto bit0 = ~pass2 & 0xFFFF;
+  auto bit1 = pass1 & ~pass3;
+  return spread_bits(bit0) | spread_bits(bit1) << 1;
+}
+
+inline void write_color(u8 *out, u16 c0, u16 c1, u32 indices) {
+  out[0] = (u8)c0;
+  out[1] = (u8)(c0 >> 8);
+  out[2] = (u8)c1;
+  out[3] = (u8)(c1 >> 8);
+  write_le32(out + 4, indices);
+}
+
+// Alpha levels run from the minimum (0) to the maximum (7); as BC3
+// indices 0 is the maximum, 1 the minimum and 2..7 the steps from the
+// maximum down.
+inline void write_alpha(u8 *out, u32 lo, u32 hi, const u8 levels[16]) {
+  out[0] = (u8)hi;
+  out[1] = (u8)lo;
+  u64 bits = 0;
+  for (u32 i = 0; i < 16; ++i) {
+    u32 index = (8 - levels[i]) & 7;
+    index ^= index < 2;
+    bits |= (u64)index << (i * 3);
+  }
+  for (u32 i = 0; i < 6; ++i) out[2 + i] = (u8)(bits >> (i * 8));
+}
+}  // namespace Detail
+
+namespace Kernel {
+#if defined(ALIEN_MATH_SSE2)
+// Min and max of every channel over the block.
+inline void block_bounds(const u32 block[16], u32 &lo, u32 &hi) {
+  auto p = (const __m128i *)block;
+  auto r0 = _mm_loadu_si128(p), r1 = _mm_loadu_si128(p + 1);
+  auto r2 = _mm_loadu_si128(p + 2), r3 = _mm_loadu_si128(p + 3);
+  auto mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+  auto mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+  mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+  mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1, 0, 3, 2)));
+  mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+  mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+  lo = (u32)_mm_cvtsi128_si32(mn);
+  hi = (u32)_mm_cvtsi128_si32(mx);
+}
+
+// 6 dot(p, dir) of four pixels, as 32-bit lanes.
+inline __m128i project4(__m128i pixels, __m128i dir) {
+  auto zero = _mm_setzero_si128();
+  auto lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), dir);
+  auto hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), dir);
+  // Lanes hold r*dr + g*dg and b*db of each pixel, add the pairs
+  auto rg = _mm_castps_si128(_mm_shuffle_ps(
+      _mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+  auto b = _mm_castps_si128(_mm_shuffle_ps(
+      _mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+  auto dot = _mm_add_epi32(rg, b);
+  return _mm_add_epi32(_mm_slli_epi32(dot, 2), _mm_slli_epi32(dot, 1));
+}
+
+inline u32 color_block(const u32 block[16], const Detail::ColorLine &line) {
+  auto dir = _mm_set_epi16(0, (i16)line.dir[2], (i16)line.dir[1],
+                           (i16)line.dir[0], 0, (i16)line.dir[2],
+                           (i16)line.dir[1], (i16)line.dir[0]);
+  __m128i dots[4];
+  for (u32 i = 0; i < 4; ++i)
+    dots[i] = project4(_mm_loadu_si128((const __m128i *)block + i), dir);
+
+  u32 pass[3];
+  for (u32 k = 0; k < 3; ++k) {
+    auto t = _mm_set1_epi32(line.thresholds[k]);
+    auto m01 = _mm_packs_epi32(_mm_cmpgt_epi32(dots[0], t),
+                               _mm_cmpgt_epi32(dots[1], t));
+    auto m23 = _mm_packs_epi32(_mm_cmpgt_epi32(dots[2], t),
+                               _mm_cmpgt_epi32(dots[3], t));
+    pass[k] = (u32)_mm_movemask_epi8(_mm_packs_epi16(m01, m23));
+  }
+  return Detail::color_indices(pass[0], pass[1], pass[2]);
+}
+
+inline void alpha_levels(const u32 block[16], u32 lo, u32 hi, u8 out[16]) {
+  auto p = (const __m128i *)block;
+  auto a01 = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(p), 24),
+                             _mm_srli_epi32(_mm_loadu_si128(p + 1), 24));
+  auto a23 = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(p + 2), 24),
+                             _mm_srli_epi32(_mm_loadu_si128(p + 3), 24));
+  // 14 (a - lo) > (2k + 1) (hi - lo), both fit 16 bits
+  auto base = _mm_set1_epi16((i16)lo);
+  auto scale = _mm_set1_epi16(14);
+  a01 = _mm_mullo_epi16(_mm_sub_epi16(a01, base), scale);
+  a23 = _mm_mullo_epi16(_mm_sub_epi16(a23, base), scale);
+  auto l01 = _mm_setzero_si128(), l23 = _mm_setzero_si128();
+  for (u32 k = 0; k < 7; ++k) {
+    auto t = _mm_set1_epi16((i16)((2 * k + 1) * (hi - lo)));
+    l01 = _mm_sub_epi16(l01, _mm_cmpgt_epi16(a01, t));
+    l23 = _mm_sub_epi16(l23, _mm_cmpgt_epi16(a23, t));
+  }
+  _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(l01, l23));
+}
+#else
+inline void block_bounds(const u32 block[16], u32 &lo, u32 &hi) {
+  lo = 0xFFFFFFFF;
+  hi = 0;
+  for (u32 c = 0; c < 32; c += 8) {
+    u32 mn = 0xFF, mx = 0;
+    for (u32 i = 0; i < 16; ++i) {
+      auto v = (block[i] >> c) & 0xFF;
+      mn = std::min(mn, v);
+      mx = std::max(mx, v);
+    }
+    lo = (lo & ~(0xFFu << c)) | mn << c;
+    hi |= mx << c;
+  }
+}
+
+inline u32 color_block(const u32 block[16], const Detail::ColorLine &line) {
+  u32 pass[3] = {0, 0, 0};
+  for (u32 i = 0; i < 16; ++i) {
+    i32 dot = 0;
+    for (u32 c = 0; c < 3; ++c)
+      dot += (i32)((block[i] >> (c * 8)) & 0xFF) * line.dir[c];
+    for (u32 k = 0; k < 3; ++k)
+      pass[k] |= (u32)(dot * 6 > line.thresholds[k]) << i;
+  }
+  return Detail::color_indices(pass[0], pass[1], pass[2]);
+}
+
+inline void alpha_levels(const u32 block[16], u32 lo, u32 hi, u8 out[16]) {
+  for (u32 i = 0; i < 16; ++i) {
+    auto a = (i32)(block[i] >> 24) - (i32)lo;
+    u8 level = 0;
+    for (u32 k = 0; k < 7; ++k)
+      level += a * 14 > (i32)((2 * k + 1) * (hi - lo));
+    out[i] = level;
+  }
+}
+#endif
+}  // namespace Kernel
+
+namespace Detail {
+inline void encode_color(const u32 block[16], u32 lo, u32 hi, u8 *out) {
+  u16 c0, c1;
+  u32 indices = 0;
+  if (color_endpoints(block, lo, hi, c0, c1))
+    indices = Kernel::color_block(block, color_line(c0, c1));
+  write_color(out, c0, c1, indices);
+}
+
+inline void encode_alpha(const u32 block[16], u32 lo, u32 hi, u8 *out) {
+  u8 levels[16] = {};
+  if (lo != hi) Kernel::alpha_levels(block, lo, hi, levels);
+  write_alpha(out, lo, hi, levels);
+}
+}  // namespace Detail
+
+// Encodes RGBA8 pixels with rows pitch bytes apart into level_size bytes
+// of BC1 or BC3 blocks, rows of blocks in parallel. BC1 drops the alpha.
+inline bool encode(TextureFormat format, const u8 *pixels, u32 width,
+                   u32 height, u32 pitch, u8 *out,
+                   JobSystem &jobs = JobSystem::instance()) {
+  if ((format != e_BC1 && format != e_BC3) || width == 0 || height == 0)
+    return false;
+  auto blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  auto bytes = block_bytes(format);
+  auto alpha = format == e_BC3;
+  jobs.parallel_for(blocksY, std::max(1u, 1024 / blocksX),
+                    [&](u32 begin, u32 end) {
+    alignas(16) u32 block[16];
+    for (auto by = begin; by < end; ++by) {
+      auto dst = out + (u64)by * blocksX * bytes;
+      for (u32 bx = 0; bx < blocksX; ++bx, dst += bytes) {
+        Detail::load_block(pixels, pitch, width, height, bx, by, alpha, block);
+        u32 lo, hi;
+        Kernel::block_bounds(block, lo, hi);
+        if (alpha) Detail::encode_alpha(block, lo >> 24, hi >> 24, dst);
+        Detail::encode_color(block, lo, hi, dst + (alpha ? 8 : 0));
+      }
+    }
+  });
+  return true;
+}
+
+inline bool parse(const u8 *data, u64 size, Texture &texture) {
+  if (size < Detail::HeaderSize || std::memcmp(data, Detail::Magic, 4) != 0)
+    return false;
+  texture.format = (TextureFormat)Detail::read_le32(data + 4);
+  texture.width = Detail::read_le32(data + 8);
+  texture.height = Detail::read_le32(data + 12);
+  texture.levels = Detail::read_le32(data + 16);
+  if ((texture.format != e_BC1 && texture.format != e_BC3) ||
+      texture.width == 0 || texture.height == 0 || texture.levels == 0 ||
+      texture.levels > 32)
+    return false;
+
+  u64 total = 0;
+  auto w = texture.width, h = texture.height;
+  for (u32 i = 0; i < texture.levels; ++i) {
+    total += level_size(texture.format, w, h);
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+  }
+  if (size - Detail::HeaderSize != total) return false;
+  texture.data = {data + Detail::HeaderSize, (size_t)total};
+  return true;
+}
+
+// A .btx file of RGBA8 levels back to back, largest first and rows without
+// padding, as Mip::generate leaves them.
+inline bool encode_file(TextureFormat format, const u8 *pixels, u32 width,
+                        u32 height, u32 levels,
+                        Memory::Vector<u8, Memory::e_Assets> &out,
+                        JobSystem &jobs = JobSystem::instance()) {
+  if (levels == 0 || levels > 32) return false;
+  u64 size = 0;
+  for (u32 i = 0; i < levels; ++i)
+    size += level_size(format, std::max(width >> i, 1u),
+                       std::max(height >> i, 1u));
+  out.resize(Detail::HeaderSize + size);
+  auto p = out.data();
+  std::memcpy(p, Detail::Magic, 4);
+  Detail::write_le32(p + 4, format);
+  Detail::write_le32(p + 8, width);
+  Detail::write_le32(p + 12, height);
+  Detail::write_le32(p + 16, levels);
+
+  p += Detail::HeaderSize;
+  for (u32 i = 0; i < levels; ++i) {
+    auto w = std::max(width >> i, 1u), h = std::max(height >> i, 1u);
+    if (!encode(format, pixels, w, h, w * 4, p, jobs)) return false;
+    pixels += (u64)w * h * 4;
+    p += level_size(format, w, h);
+  }
+  return true;
+}
+}  // namespace Alien::Bc
+
+#endif
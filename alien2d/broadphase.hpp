@@ -0,0 +1,302 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_BROADPHASE_HPP
+#define ALIEN_BROADPHASE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include "base.hpp"
+#include "cpu.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "slot_map.hpp"
+
+namespace Alien {
+using BodyHandle = Handle<struct BodyTag>;
+
+struct BodyPair {
+  BodyHandle a, b;
+};
+
+using BodyPairs = Memory::Vector<BodyPair, Memory::e_Game>;
+
+// Body bounds sorted by minX, clamped to finite values. The arrays go on
+// for SweepPadding bodies with infinite minX and minY, so a sweep stops on
+// them and the wide kernels can load past the last body.
+struct SweepColumns {
+  static constexpr u32 SweepPadding = 16;
+
+  const f32 *minX, *maxX, *minY, *maxY;
+  const BodyHandle *bodies;
+};
+
+namespace Kernel {
+// Bodies after i overlap on x as long as their minX is not past the maxX of
+// i, so each one only tests y.
+inline void sweep_pairs_scalar(const SweepColumns &in, u32 begin, u32 end,
+                               BodyPairs &out) {
+  for (auto i = begin; i < end; ++i) {
+    auto maxX = in.maxX[i], minY = in.minY[i], maxY = in.maxY[i];
+    for (auto j = i + 1; in.minX[j] <= maxX; ++j) {
+      if (in.minY[j] <= maxY && in.maxY[j] >= minY)
+        out.push_back({in.bodies[i], in.bodies[j]});
+    }
+  }
+}
+
+// Lanes of hits are the bodies j, j + 1, ... overlapping i.
+inline void emit_pairs(const SweepColumns &in, u32 i, u32 j, u32 hits,
+                       BodyPairs &out) {
+  for (; hits; hits &= hits - 1)
+    out.push_back({in.bodies[i], in.bodies[j + std::countr_zero(hits)]});
+}
+
+inline void sweep_pairs_baseline(const SweepColumns &in, u32 begin, u32 end,
+                                 BodyPairs &out) {
+#if defined(ALIEN_MATH_SSE2)
+  for (auto i = begin; i < end; ++i) {
+    auto maxX = _mm_set1_ps(in.maxX[i]);
+    auto minY = _mm_set1_ps(in.minY[i]);
+    auto maxY = _mm_set1_ps(in.maxY[i]);
+    // Sorted by minX, so the x test passes for a prefix of the lanes
+    for (auto j = i + 1;; j += 4) {
+      auto x = _mm_cmple_ps(_mm_loadu_ps(in.minX + j), maxX);
+      auto y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(in.minY + j), maxY),
+                          _mm_cmpge_ps(_mm_loadu_ps(in.maxY + j), minY));
+      emit_pairs(in, i, j, (u32)_mm_movemask_ps(_mm_and_ps(x, y)), out);
+      if (_mm_movemask_ps(x) != 0xF) break;
+    }
+  }
+#else
+  sweep_pairs_scalar(in, begin, end, out);
+#endif
+}
+
+#if defined(ALIEN_CPU_X86)
+ALIEN_TARGET_AVX2 inline void sweep_pairs_avx2(const SweepColumns &in,
+                                               u32 begin, u32 end,
+                                               BodyPairs &out) {
+  for (auto i = begin; i < end; ++i) {
+    auto maxX = _mm256_set1_ps(in.maxX[i]);
+    auto minY = _mm256_set1_ps(in.minY[i]);
+    auto maxY = _mm256_set1_ps(in.maxY[i]);
+    for (auto j = i + 1;; j += 8) {
+      auto x = _mm256_cmp_ps(_mm256_loadu_ps(in.minX + j), maxX, _CMP_LE_OQ);
+      auto y = _mm256_and_ps(
+          _mm256_cmp_ps(_mm256_loadu_ps(in.minY + j), maxY, _CMP_LE_OQ),
+          _mm256_cmp_ps(_mm256_loadu_ps(in.maxY + j), minY, _CMP_GE_OQ));
+      emit_pairs(in, i, j, (u32)_mm256_movemask_ps(_mm256_and_ps(x, y)), out);
+      if (_mm256_movemask_ps(x) != 0xFF) break;
+    }
+  }
+}
+
+ALIEN_TARGET_AVX512 inline void sweep_pairs_avx512(const SweepColumns &in,
+                                                   u32 begin, u32 end,
+                                                   BodyPairs &out) {
+  for (auto i = begin; i < end; ++i) {
+    auto maxX = _mm512_set1_ps(in.maxX[i]);
+    auto minY = _mm512_set1_ps(in.minY[i]);
+    auto maxY = _mm512_set1_ps(in.maxY[i]);
+    for (auto j = i + 1;; j += 16) {
+      auto x =
+          _mm512_cmp_ps_mask(_mm512_loadu_ps(in.minX + j), maxX, _CMP_LE_OQ);
+      auto y = _mm512_mask_cmp_ps_mask(x, _mm512_loadu_ps(in.minY + j), maxY,
+                                       _CMP_LE_OQ);
+      y = _mm512_mask_cmp_ps_mask(y, _mm512_loadu_ps(in.maxY + j), minY,
+                                  _CMP_GE_OQ);
+      emit_pairs(in, i, j, (u32)y, out);
+      if (x != 0xFFFF) break;
+    }
+  }
+}
+#endif
+
+// Appends the overlapping pairs of the bodies [begin, end) with the bodies
+// sorted after them.
+inline void sweep_pairs(const SweepColumns &in, u32 begin, u32 end,
+                        BodyPairs &out) {
+  using Fn = void (*)(const SweepColumns &, u32, u32, BodyPairs &);
+  static const auto kernel = Cpu::select<Fn>(ALIEN_CPU_VARIANTS(sweep_pairs));
+  kernel(in, begin, end, out);
+}
+}  // namespace Kernel
+
+// Sweep and prune broadphase on the x axis. The order of the last update
+// is kept, bodies move little between frames so an insertion sort puts it
+// back in order in close to linear time. The sorted range is split in
+// slices which are swept on the job system, each into its own pair list,
+// and the lists are joined in order.
+//
+// Bounds are Vec4 with min in xy and max in zw, touching bodies overlap.
+class SweepAndPrune {
+ public:
+  BodyHandle add(const Math::Vec4 &bounds) {
+    auto body = m_Bodies.insert(bounds);
+    m_Order.push_back({bounds.x, body});
+    ++m_Added;
+    return body;
+  }
+
+  // The body leaves the sort order on the next update.
+  bool remove(BodyHandle body) { return m_Bodies.erase(body); }
+
+  bool set_bounds(BodyHandle body, const Math::Vec4 &bounds) {
+    auto current = m_Bodies.get(body);
+    if (!current) return false;
+
+    *current = bounds;
+    return true;
+  }
+
+  const Math::Vec4 *bounds(BodyHandle body) const {
+    return m_Bodies.get(body);
+  }
+
+  u32 size() const { return m_Bodies.size(); }
+
+  // Sorts the bodies and finds every overlapping pair.
+  void update(JobSystem &jobs = JobSystem::instance()) {
+    sort();
+    sweep(jobs);
+  }
+
+  // Pairs of the last update, the body sorted first is a.
+  const BodyPairs &pairs() const { return m_Pairs; }
+
+ private:
+  struct SortEntry {
+    f32 minX;
+    BodyHandle body;
+  };
+
+  static constexpr u32 SliceBodies = 2048;
+
+  void sort() {
+    // Drop the removed bodies and refresh the keys, bodies added since the
+    // last update are at the back
+    auto firstAdded = (u32)m_Order.size() - m_Added;
+    u32 count = 0, kept = 0;
+    for (u32 i = 0; i < m_Order.size(); ++i) {
+      auto bounds = m_Bodies.get(m_Order[i].body);
+      if (!bounds) continue;
+      m_Order[count++] = {bounds->x, m_Order[i].body};
+      if (i < firstAdded) kept = count;
+    }
+    m_Order.resize(count);
+    m_Added = 0;
+
+    // The old order is nearly sorted, the new bodies can land anywhere so
+    // they are sorted on their own and merged in
+    auto less = [](const SortEntry &a, const SortEntry &b) {
+      return a.minX < b.minX;
+    };
+    for (u32 i = 1; i < kept; ++i) {
+      auto entry = m_Order[i];
+      auto j = i;
+      for (; j > 0 && m_Order[j - 1].minX > entry.minX; --j)
+        m_Order[j] = m_Order[j - 1];
+      m_Order[j] = entry;
+    }
+    std::sort(m_Order.begin() + kept, m_Order.end(), less);
+    std::inplace_merge(m_Order.begin(), m_Order.begin() + kept, m_Order.end(),
+                       less);
+
+    auto padded = count + SweepColumns::SweepPadding;
+    for (auto column : {&m_MinX, &m_MaxX, &m_MinY, &m_MaxY})
+      column->resize(padded);
+    m_Sorted.resize(padded);
+    // Only the padding may be infinite, a body with maxX of infinity would
+    // otherwise overlap it and sweep past the end
+    auto finite = [](f32 value) {
+      constexpr auto Max = std::numeric_limits<f32>::max();
+      return std::clamp(value, -Max, Max);
+    };
+    for (u32 i = 0; i < count; ++i) {
+      const auto &bounds = *m_Bodies.get(m_Order[i].body);
+      m_MinX[i] = finite(bounds.x);
+      m_MinY[i] = finite(bounds.y);
+      m_MaxX[i] = finite(bounds.z);
+      m_MaxY[i] = finite(bounds.w);
+      m_Sorted[i] = m_Order[i].body;
+    }
+
+    constexpr auto Inf = std::numeric_limits<f32>::infinity();
+    for (auto i = count; i < padded; ++i) {
+      m_MinX[i] = m_MinY[i] = Inf;
+      m_MaxX[i] = m_MaxY[i] = -Inf;
+      m_Sorted[i] = {};
+    }
+  }
+
+  void sweep(JobSystem &jobs) {
+    auto count = (u32)m_Order.size();
+    SweepColumns columns{m_MinX.data(), m_MaxX.data(), m_MinY.data(),
+                         m_MaxY.data(), m_Sorted.data()};
+
+    auto slices = std::min(jobs.thread_count() * 4,
+                           (count + SliceBodies - 1) / SliceBodies);
+    slices = std::max(slices, 1u);
+    if (m_SlicePairs.size() < slices) m_SlicePairs.resize(slices);
+
+    auto sliceSize = (count + slices - 1) / slices;
+    jobs.parallel_for(slices, 1, [&](u32 first, u32 last) {
+      for (auto s = first; s < last; ++s) {
+        auto &out = m_SlicePairs[s];
+        out.clear();
+        auto begin = std::min(count, s * sliceSize);
+        auto end = std::min(count, begin + sliceSize);
+        Kernel::sweep_pairs(columns, begin, end, out);
+      }
+    });
+
+    m_Pairs.clear();
+    for (u32 s = 0; s < slices; ++s)
+      m_Pairs.insert(m_Pairs.end(), m_SlicePairs[s].begin(),
+                     m_SlicePairs[s].end());
+  }
+
+  using Column = Memory::Vector<f32, Memory::e_Game>;
+
+  SlotMap<Math::Vec4, BodyTag> m_Bodies;
+  // Sort order of the last update, new bodies are appended
+  Memory::Vector<SortEntry, Memory::e_Game> m_Order;
+  u32 m_Added{0};
+
+  // Bounds in sort order, padded for the sweep kernels
+  Column m_MinX, m_MaxX, m_MinY, m_MaxY;
+  Memory::Vector<BodyHandle, Memory::e_Game> m_Sorted;
+
+  std::vector<BodyPairs> m_SlicePairs;
+  BodyPairs m_Pairs;
+};
+}  // namespace Alien
+
+#endif
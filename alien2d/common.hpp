@@ -30,6 +30,8 @@ THE SOFTWARE.
 #endif
 #endif
 
+#include <base.hpp>
+
 #ifdef _WIN32
 #include <Windows.h>
 #ifdef ALIEN_DX11
@@ -40,7 +42,15 @@ THE SOFTWARE.
 #endif
 #endif
 
-#include <base.hpp>
+#include "slot_map.hpp"
+
+namespace Alien {
+// Handles to the GPU resources which are owned by the context.
+using ProgramHandle = Handle<struct ProgramTag>;
+using BufferHandle = Handle<struct BufferTag>;
+using TextureHandle = Handle<struct TextureTag>;
+using VertexArrayHandle = Handle<struct VertexArrayTag>;
+}  // namespace Alien
 
 namespace Extra {
 struct BufferDescriptor {
@@ -60,8 +70,8 @@ struct BufferDescriptor {
   ID3D11Buffer* indexBuffer;
   ID3D11InputLayout* inputLayout;
 #else
-  BufferDescriptor(GLuint vao, GLuint vbo, GLuint ibo, u32 stride, u32 offset,
-                   u32 count, u32 indexCount)
+  BufferDescriptor(GLuint vao, Alien::BufferHandle vbo, Alien::BufferHandle ibo,
+                   u32 stride, u32 offset, u32 count, u32 indexCount)
       : IBO(ibo),
         VBO(vbo),
         VAO(vao),
@@ -70,8 +80,8 @@ struct BufferDescriptor {
         vertexCount(count),
         indexCount(indexCount) {}
 
-  GLuint IBO;
-  GLuint VBO;
+  Alien::BufferHandle IBO;
+  Alien::BufferHandle VBO;
   GLuint VAO;
 #endif
 
@@ -80,6 +90,28 @@ struct BufferDescriptor {
   u32 stride;
   u32 indexCount;
 };
+
+#if !defined(_WIN32) || !defined(ALIEN_DX11)
+struct ProgramObject {
+  GLuint program;
+  GLuint vertShader;
+  GLuint fragShader;
+};
+
+struct BufferObject {
+  GLuint buffer;
+  GLenum target;
+  u32 size;
+};
+
+struct TextureObject {
+  GLuint texture;
+  u32 width;
+  u32 height;
+  GLenum format;
+  u32 levels;
+};
+#endif
 }  // namespace Extra
 
 #ifndef _WIN32
@@ -0,0 +1,180 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_CPU_HPP
+#define ALIEN_CPU_HPP
+
+#include <cstdlib>
+#include <cstring>
+
+#include "base.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define ALIEN_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// Kernels for wider instruction sets are compiled into the same binary with
+// a target attribute, the build itself only needs the baseline ISA. MSVC
+// emits any intrinsic without flags so the attribute is not needed there.
+#if defined(ALIEN_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ALIEN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define ALIEN_TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")))
+#else
+#define ALIEN_TARGET_AVX2
+#define ALIEN_TARGET_AVX512
+#endif
+
+// Baseline, AVX2 and AVX-512 variants of a kernel in the order
+// Cpu::select takes them. Only the baseline exists outside of x86.
+#if defined(ALIEN_CPU_X86)
+#define ALIEN_CPU_VARIANTS(name) name##_baseline, name##_avx2, name##_avx512
+#else
+#define ALIEN_CPU_VARIANTS(name) name##_baseline, nullptr, nullptr
+#endif
+
+// Same for kernels which stop at AVX2.
+#if defined(ALIEN_CPU_X86)
+#define ALIEN_CPU_VARIANTS_AVX2(name) name##_baseline, name##_avx2, nullptr
+#else
+#define ALIEN_CPU_VARIANTS_AVX2(name) name##_baseline, nullptr, nullptr
+#endif
+
+namespace Alien {
+namespace Cpu {
+// Baseline is what the compiler targets without flags: SSE2 on x64, NEON on
+// ARM64, scalar code anywhere else.
+enum Level : u32 { e_Baseline, e_AVX2, e_AVX512 };
+
+struct Features {
+  bool sse2{false};
+  bool avx2{false};
+  bool fma{false};
+  bool avx512f{false};
+  bool avx512dq{false};
+  bool avx512bw{false};
+  bool avx512vl{false};
+  bool neon{false};
+};
+
+inline Features detect_features() {
+  Features f;
+#if defined(ALIEN_CPU_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  auto maxLeaf = info[0];
+
+  __cpuid(info, 1);
+  f.sse2 = (info[3] >> 26) & 1;
+  f.fma = (info[2] >> 12) & 1;
+  bool osxsave = (info[2] >> 27) & 1;
+
+  // The OS has to save the wide registers too, otherwise AVX faults even
+  // when the CPU supports it.
+  u64 xcr0 = osxsave ? _xgetbv(0) : 0;
+  bool ymm = (xcr0 & 0x6) == 0x6;
+  bool zmm = (xcr0 & 0xE6) == 0xE6;
+  f.fma = f.fma && ymm;
+
+  if (maxLeaf >= 7) {
+    __cpuidex(info, 7, 0);
+    f.avx2 = ymm && ((info[1] >> 5) & 1);
+    f.avx512f = zmm && ((info[1] >> 16) & 1);
+    f.avx512dq = zmm && ((info[1] >> 17) & 1);
+    f.avx512bw = zmm && ((info[1] >> 30) & 1);
+    f.avx512vl = zmm && ((info[1] >> 31) & 1);
+  }
+#elif defined(ALIEN_CPU_X86)
+  // Also checks that the OS saves the wide registers
+  __builtin_cpu_init();
+  f.sse2 = __builtin_cpu_supports("sse2");
+  f.avx2 = __builtin_cpu_supports("avx2");
+  f.fma = __builtin_cpu_supports("fma");
+  f.avx512f = __builtin_cpu_supports("avx512f");
+  f.avx512dq = __builtin_cpu_supports("avx512dq");
+  f.avx512bw = __builtin_cpu_supports("avx512bw");
+  f.avx512vl = __builtin_cpu_supports("avx512vl");
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+  f.neon = true;
+#endif
+  return f;
+}
+
+inline const Features &features() {
+  static const Features f = detect_features();
+  return f;
+}
+
+inline const char *level_name(Level level) {
+  switch (level) {
+    case e_AVX2:
+      return "avx2";
+    case e_AVX512:
+      return "avx512";
+    default:
+      return "baseline";
+  }
+}
+
+// Best level of the machine. ALIEN_CPU_LEVEL (baseline, avx2 or avx512) can
+// lower it to compare the kernels or to chase a bug in one of them.
+inline Level level() {
+  static const Level cached = [] {
+    const auto &f = features();
+    auto best = e_Baseline;
+    if (f.avx2 && f.fma) best = e_AVX2;
+    if (best == e_AVX2 && f.avx512f && f.avx512dq && f.avx512bw && f.avx512vl)
+      best = e_AVX512;
+
+    if (auto env = std::getenv("ALIEN_CPU_LEVEL")) {
+      for (auto l : {e_Baseline, e_AVX2, e_AVX512}) {
+        if (std::strcmp(env, level_name(l)) == 0 && l < best) best = l;
+      }
+    }
+    return best;
+  }();
+  return cached;
+}
+
+// Picks the widest variant the machine supports. Kernels keep the result in
+// a function-local static so the check runs once, the first time they are
+// called.
+template <typename Fn>
+Fn select(Fn baseline, Fn avx2, Fn avx512) {
+  auto l = level();
+  if (l >= e_AVX512 && avx512) return avx512;
+  if (l >= e_AVX2 && avx2) return avx2;
+  return baseline;
+}
+}  // namespace Cpu
+}  // namespace Alien
+
+#endif
@@ -0,0 +1,267 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_DYNAMIC_ATLAS_HPP
+#define ALIEN_DYNAMIC_ATLAS_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "alien_gl.hpp"
+#include "atlas.hpp"
+
+#ifndef ALIEN_DX11
+
+namespace Alien {
+// Atlas for images made at run time (glyphs, avatars, generated icons), so
+// they batch with everything else on a few shared pages instead of one
+// texture each. Images are keyed by the caller, placed by a shelf
+// allocator and uploaded on their own with glTexSubImage2D. When every
+// page is full, the least recently used images are evicted; images which
+// were looked up in the current frame are never evicted, their draws are
+// still to come.
+//
+// Everything runs on the thread which owns the context.
+class DynamicAtlas {
+ public:
+  struct Options {
+    u32 pageSize{1024};
+    // Pages are created as they are needed, up to this many
+    u32 maxPages{4};
+    // Edge pixels are repeated this far around every image
+    u32 padding{1};
+  };
+
+  struct Occupancy {
+    u32 items;
+    // Pixels of the images with their padding, of the page covered by
+    // shelves, and of the whole page
+    u64 usedPixels;
+    u64 shelvedPixels;
+    u64 totalPixels;
+  };
+
+  explicit DynamicAtlas(GLContext &context)
+      : DynamicAtlas(context, Options()) {}
+  DynamicAtlas(GLContext &context, Options options)
+      : m_Context(context), m_Options(options) {}
+
+  ~DynamicAtlas() {
+    for (auto &page : m_Pages) m_Context.release_texture(page.texture);
+  }
+
+  DynamicAtlas(const DynamicAtlas &) = delete;
+  DynamicAtlas &operator=(const DynamicAtlas &) = delete;
+
+  // Region of a resident image, which counts as used in this frame.
+  bool find(u64 key, Atlas::Region &region) {
+    auto it = m_Lookup.find(key);
+    if (it == m_Lookup.end()) return false;
+    touch(it->second);
+    region = region_of(m_Items[it->second]);
+    return true;
+  }
+
+  // Uploads RGBA8 pixels with rows pitch bytes apart and returns their
+  // region. An image under the same key is replaced once the new one is
+  // placed, and kept when the insert fails. Fails when the image does not
+  // fit a page, or only would by evicting images in use this frame.
+  bool insert(u64 key, u32 width, u32 height, const u8 *pixels, u32 pitch,
+              Atlas::Region &region) {
+    auto pad = m_Options.padding * 2;
+    if (width == 0 || height == 0 || width + pad > m_Options.pageSize ||
+        height + pad > m_Options.pageSize)
+      return false;
+
+    auto old = m_Lookup.find(key);
+    auto oldIndex = old != m_Lookup.end() ? old->second : NoItem;
+    Atlas::Rect rect;
+    u32 page;
+    while (!allocate(width + pad, height + pad, rect, page)) {
+      // Skip the old image, it is released only once the new one fits
+      auto victim = m_Oldest == oldIndex ? m_Items[oldIndex].next : m_Oldest;
+      if (victim == NoItem ||
+          m_Items[victim].frameIndex == m_Context.frame_index())
+        return false;
+      evict(victim);
+    }
+    if (oldIndex != NoItem) evict(oldIndex);
+
+    auto index = (u32)m_Items.size();
+    if (m_FreeItem != NoItem) {
+      index = m_FreeItem;
+      m_FreeItem = m_Items[index].next;
+    } else {
+      m_Items.emplace_back();
+    }
+    auto &item = m_Items[index];
+    item = {key, page, rect, m_Context.frame_index(), NoItem, NoItem};
+    link_newest(index);
+    m_Lookup.emplace(key, index);
+    ++m_Pages[page].items;
+
+    upload(item, width, height, pixels, pitch);
+    region = region_of(item);
+    return true;
+  }
+
+  void remove(u64 key) {
+    auto it = m_Lookup.find(key);
+    if (it != m_Lookup.end()) evict(it->second);
+  }
+
+  bool contains(u64 key) const { return m_Lookup.count(key) != 0; }
+  u32 item_count() const { return (u32)m_Lookup.size(); }
+
+  u32 page_count() const { return (u32)m_Pages.size(); }
+  TextureHandle page_texture(u32 page) const { return m_Pages[page].texture; }
+
+  Occupancy occupancy(u32 page) const {
+    auto &p = m_Pages[page];
+    auto size = (u64)m_Options.pageSize;
+    return {p.items, p.allocator.used_area(), p.allocator.shelved_area(),
+            size * size};
+  }
+
+ private:
+  static constexpr u32 NoItem = 0xFFFFFFFF;
+
+  // Items are in a list from least to most recently used. Freed items are
+  // chained thru next.
+  struct Item {
+    u64 key;
+    u32 page;
+    // With the padding
+    Atlas::Rect rect;
+    u64 frameIndex;
+    u32 prev, next;
+  };
+
+  struct Page {
+    TextureHandle texture;
+    Atlas::ShelfAllocator allocator;
+    u32 items;
+  };
+
+  bool allocate(u32 width, u32 height, Atlas::Rect &rect, u32 &page) {
+    for (page = 0; page < m_Pages.size(); ++page)
+      if (m_Pages[page].allocator.allocate(width, height, rect)) return true;
+    if (m_Pages.size() >= m_Options.maxPages) return false;
+
+    auto size = m_Options.pageSize;
+    m_Pages.push_back({m_Context.create_texture(size, size, nullptr),
+                       Atlas::ShelfAllocator(size, size), 0});
+    return m_Pages.back().allocator.allocate(width, height, rect);
+  }
+
+  void evict(u32 index) {
+    auto &item = m_Items[index];
+    auto &page = m_Pages[item.page];
+    page.allocator.free(item.rect);
+    --page.items;
+    m_Lookup.erase(item.key);
+    unlink(index);
+    item.next = m_FreeItem;
+    m_FreeItem = index;
+  }
+
+  void unlink(u32 index) {
+    auto &item = m_Items[index];
+    (item.prev != NoItem ? m_Items[item.prev].next : m_Oldest) = item.next;
+    (item.next != NoItem ? m_Items[item.next].prev : m_Newest) = item.prev;
+  }
+
+  void link_newest(u32 index) {
+    auto &item = m_Items[index];
+    item.prev = m_Newest;
+    item.next = NoItem;
+    (m_Newest != NoItem ? m_Items[m_Newest].next : m_Oldest) = index;
+    m_Newest = index;
+  }
+
+  void touch(u32 index) {
+    m_Items[index].frameIndex = m_Context.frame_index();
+    if (index == m_Newest) return;
+    unlink(index);
+    link_newest(index);
+  }
+
+  Atlas::Region region_of(const Item &item) const {
+    auto size = (f32)m_Options.pageSize;
+    auto pad = m_Options.padding;
+    auto &rect = item.rect;
+    auto width = (f32)(rect.width - pad * 2);
+    auto height = (f32)(rect.height - pad * 2);
+    auto x = (f32)(rect.x + pad), y = (f32)(rect.y + pad);
+    return {item.page,
+            false,
+            {x / size, y / size, (x + width) / size, (y + height) / size},
+            {width, height},
+            {0.0f, 0.0f},
+            {width, height}};
+  }
+
+  // Sends the image and its padding as one sub-region.
+  void upload(const Item &item, u32 width, u32 height, const u8 *pixels,
+              u32 pitch) {
+    auto pad = m_Options.padding;
+    auto &rect = item.rect;
+    m_Scratch.resize((u64)rect.width * rect.height);
+    for (u32 y = 0; y < rect.height; ++y) {
+      auto sy = (u32)std::clamp<i64>((i64)y - pad, 0, (i64)height - 1);
+      auto src = pixels + (u64)sy * pitch;
+      auto out = m_Scratch.data() + (u64)y * rect.width;
+      for (u32 x = 0; x < pad; ++x) {
+        std::memcpy(out + x, src, 4);
+        std::memcpy(out + pad + width + x, src + (width - 1) * 4, 4);
+      }
+      std::memcpy(out + pad, src, (u64)width * 4);
+    }
+
+    auto texture = m_Context.get_texture(m_Pages[item.page].texture);
+    ::glBindTexture(GL_TEXTURE_2D, texture->texture);
+    ::glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)rect.x, (GLint)rect.y,
+                      (GLsizei)rect.width, (GLsizei)rect.height, GL_RGBA,
+                      GL_UNSIGNED_BYTE, m_Scratch.data());
+  }
+
+  GLContext &m_Context;
+  Options m_Options;
+  std::vector<Page> m_Pages;
+  Memory::Vector<Item, Memory::e_Assets> m_Items;
+  std::unordered_map<u64, u32> m_Lookup;
+  u32 m_Oldest{NoItem};
+  u32 m_Newest{NoItem};
+  u32 m_FreeItem{NoItem};
+  Memory::Vector<u32, Memory::e_Assets> m_Scratch;
+};
+}  // namespace Alien
+
+#endif
+
+#endif
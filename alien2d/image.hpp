@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_IMAGE_HPP
+#define ALIEN_IMAGE_HPP
+
+#include "base.hpp"
+#include "memory.hpp"
+
+namespace Alien {
+// Layout of texture data. Packs record it per entry, so the upload path is
+// known without touching the data.
+enum TextureFormat : u32 { e_UnknownFormat, e_RGBA8, e_BC1, e_BC3 };
+
+// Decoded image, RGBA8 rows without padding. Ready for
+// GLContext::create_texture.
+struct Image {
+  u32 width{0};
+  u32 height{0};
+  Memory::Vector<u8, Memory::e_Assets> pixels;
+};
+
+// One file of a batch decode. The caller reads the size of the image
+// first and points pixels at the memory it should end up in, e.g. a
+// mapped upload buffer.
+struct DecodeTask {
+  const u8 *data;
+  u64 size;
+  u8 *pixels;
+  // Bytes between the rows of pixels
+  u32 pitch;
+  bool ok;
+};
+}  // namespace Alien
+
+#endif
@@ -0,0 +1,338 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_INFLATE_HPP
+#define ALIEN_INFLATE_HPP
+
+#include <cstring>
+
+#include "base.hpp"
+
+// Deflate decoder (RFC 1950/1951). The output size has to be known up
+// front, which is the case for images, and the whole stream must be in
+// memory. Huffman codes up to FastBits long are decoded with one table
+// lookup, longer ones with a canonical search.
+namespace Alien::Zlib {
+namespace Detail {
+static constexpr u32 FastBits = 10;
+static constexpr u32 FastMask = (1u << FastBits) - 1;
+
+inline u32 reverse_bits(u32 v, u32 count) {
+  v = ((v & 0xAAAA) >> 1) | ((v & 0x5555) << 1);
+  v = ((v & 0xCCCC) >> 2) | ((v & 0x3333) << 2);
+  v = ((v & 0xF0F0) >> 4) | ((v & 0x0F0F) << 4);
+  v = ((v & 0xFF00) >> 8) | ((v & 0x00FF) << 8);
+  return v >> (16 - count);
+}
+
+struct Huffman {
+  // (length << 9) | symbol, zero for the codes longer than FastBits
+  u16 fast[1 << FastBits];
+  u16 firstCode[16];
+  u16 firstSymbol[16];
+  // First code after the codes of the length, left aligned to 16 bits
+  u32 maxCode[17];
+  // Symbols in canonical order
+  u16 symbols[288];
+
+  bool build(const u8 *lengths, u32 count) {
+    u32 counts[16] = {};
+    for (u32 i = 0; i < count; ++i) ++counts[lengths[i]];
+    counts[0] = 0;
+
+    u32 code = 0, symbol = 0;
+    u32 nextCode[16];
+    for (u32 len = 1; len < 16; ++len) {
+      nextCode[len] = code;
+      firstCode[len] = (u16)code;
+      firstSymbol[len] = (u16)symbol;
+      code += counts[len];
+      // Over-subscribed, incomplete codes are allowed
+      if (code > (1u << len)) return false;
+      maxCode[len] = code << (16 - len);
+      code <<= 1;
+      symbol += counts[len];
+    }
+    maxCode[16] = 0x10000;
+
+    std::memset(fast, 0, sizeof(fast));
+    for (u32 i = 0; i < count; ++i) {
+      auto len = lengths[i];
+      if (!len) continue;
+
+      auto slot = nextCode[len] - firstCode[len] + firstSymbol[len];
+      symbols[slot] = (u16)i;
+      if (len <= FastBits) {
+        auto entry = (u16)(len << 9 | i);
+        for (auto j = reverse_bits(nextCode[len], len); j <= FastMask;
+             j += 1u << len)
+          fast[j] = entry;
+      }
+      ++nextCode[len];
+    }
+    return true;
+  }
+};
+
+// LSB first bit buffer. Reading past the end yields zeros, a stream
+// which needs more than a few of them is truncated.
+struct BitReader {
+  const u8 *p, *end;
+  u64 bits{0};
+  u32 count{0};
+  u32 overrun{0};
+
+  void refill() {
+    if (end - p >= 8) {
+      u64 v;
+      std::memcpy(&v, p, 8);
+      bits |= v << count;
+      p += (63 - count) >> 3;
+      count |= 56;
+      return;
+    }
+    while (count <= 56) {
+      if (p < end) {
+        bits |= (u64)*p++ << count;
+      } else {
+        ++overrun;
+      }
+      count += 8;
+    }
+  }
+
+  u32 peek(u32 n) const { return (u32)(bits & ((1ull << n) - 1)); }
+  void consume(u32 n) {
+    bits >>= n;
+    count -= n;
+  }
+  u32 read(u32 n) {
+    auto v = peek(n);
+    consume(n);
+    return v;
+  }
+};
+
+// Needs at least 15 buffered bits. Returns -1 for invalid codes.
+inline i32 decode(BitReader &in, const Huffman &h) {
+  auto entry = h.fast[in.bits & FastMask];
+  if (entry) {
+    in.consume(entry >> 9);
+    return entry & 511;
+  }
+
+  auto k = reverse_bits(in.peek(16), 16);
+  u32 len = FastBits + 1;
+  while (k >= h.maxCode[len]) ++len;
+  if (len == 16) return -1;
+
+  in.consume(len);
+  return h.symbols[(k >> (16 - len)) - h.firstCode[len] + h.firstSymbol[len]];
+}
+
+static constexpr u16 LengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10,
+                                       11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115,
+                                       131, 163, 195, 227, 258};
+static constexpr u8 LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                       1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                       4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr u16 DistBase[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static constexpr u8 DistExtra[30] = {0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
+                                     4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
+                                     9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+struct FixedTables {
+  Huffman lit, dist;
+
+  FixedTables() {
+    u8 lengths[288];
+    std::memset(lengths, 8, 144);
+    std::memset(lengths + 144, 9, 112);
+    std::memset(lengths + 256, 7, 24);
+    std::memset(lengths + 280, 8, 8);
+    lit.build(lengths, 288);
+    std::memset(lengths, 5, 30);
+    dist.build(lengths, 30);
+  }
+};
+
+inline bool read_dynamic_tables(BitReader &in, Huffman &lit, Huffman &dist) {
+  static constexpr u8 Order[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                   11, 4,  12, 3, 13, 2, 14, 1, 15};
+  in.refill();
+  auto litCount = in.read(5) + 257;
+  auto distCount = in.read(5) + 1;
+  auto lengthCount = in.read(4) + 4;
+  if (litCount > 286 || distCount > 30) return false;
+
+  u8 codeLengths[19] = {};
+  for (u32 i = 0; i < lengthCount; ++i) {
+    in.refill();
+    codeLengths[Order[i]] = (u8)in.read(3);
+  }
+  Huffman lengthCode;
+  if (!lengthCode.build(codeLengths, 19)) return false;
+
+  // Literal and distance lengths are one sequence, repeats may cross
+  u8 lengths[286 + 30];
+  u32 total = litCount + distCount;
+  for (u32 n = 0; n < total;) {
+    in.refill();
+    auto symbol = decode(in, lengthCode);
+    if (symbol < 0) return false;
+    if (symbol < 16) {
+      lengths[n++] = (u8)symbol;
+      continue;
+    }
+
+    u8 value = 0;
+    u32 repeat;
+    if (symbol == 16) {
+      if (n == 0) return false;
+      value = lengths[n - 1];
+      repeat = 3 + in.read(2);
+    } else if (symbol == 17) {
+      repeat = 3 + in.read(3);
+    } else {
+      repeat = 11 + in.read(7);
+    }
+    if (n + repeat > total) return false;
+    std::memset(lengths + n, value, repeat);
+    n += repeat;
+  }
+  if (lengths[256] == 0) return false;
+
+  return lit.build(lengths, litCount) &&
+         dist.build(lengths + litCount, distCount);
+}
+
+inline bool inflate_block(BitReader &in, const Huffman &lit,
+                          const Huffman &dist, u8 *begin, u8 *&out,
+                          u8 *end) {
+  for (;;) {
+    // 56 bits cover the longest length and distance with their extras
+    in.refill();
+    auto symbol = decode(in, lit);
+    if (symbol < 256) {
+      if (symbol < 0 || out == end) return false;
+      *out++ = (u8)symbol;
+      continue;
+    }
+    if (symbol == 256) return in.overrun <= 8;
+
+    symbol -= 257;
+    if (symbol >= 29) return false;
+    u32 length = LengthBase[symbol] + in.read(LengthExtra[symbol]);
+
+    auto d = decode(in, dist);
+    if (d < 0 || d >= 30) return false;
+    u32 distance = DistBase[d] + in.read(DistExtra[d]);
+
+    if (distance > (u32)(out - begin) || length > (u32)(end - out))
+      return false;
+
+    auto src = out - distance;
+    if (distance >= 8 && end - out >= (i64)length + 8) {
+      // Every 8 byte step only reads bytes written before
+      for (u32 i = 0; i < length; i += 8) std::memcpy(out + i, src + i, 8);
+    } else if (distance == 1) {
+      std::memset(out, *src, length);
+    } else {
+      for (u32 i = 0; i < length; ++i) out[i] = src[i];
+    }
+    out += length;
+  }
+}
+}  // namespace Detail
+
+// Raw deflate stream into dst. Returns false on corrupt or truncated data
+// and when the output does not fit; written is the size decoded so far.
+inline bool inflate(const u8 *src, u64 srcSize, u8 *dst, u64 dstSize,
+                    u64 &written) {
+  static const Detail::FixedTables fixed;
+
+  Detail::BitReader in{src, src + srcSize};
+  auto out = dst, end = dst + dstSize;
+  Detail::Huffman lit, dist;
+  bool ok = true, last = false;
+  while (ok && !last) {
+    in.refill();
+    last = in.read(1);
+    auto type = in.read(2);
+
+    if (type == 0) {
+      // Stored: byte aligned LEN and NLEN, then the raw bytes
+      in.consume(in.count & 7);
+      auto len = in.read(16), nlen = in.read(16);
+      if ((len ^ 0xFFFF) != nlen || len > (u64)(end - out)) {
+        ok = false;
+        break;
+      }
+      // Drain the bit buffer first, then copy from the stream
+      for (; len && in.count >= 8; --len) *out++ = (u8)in.read(8);
+      if (len == 0) continue;
+      // The refill leaves the bytes at p above count, they are skipped now
+      in.bits = 0;
+      if ((u64)(in.end - in.p) < len) {
+        ok = false;
+        break;
+      }
+      std::memcpy(out, in.p, len);
+      out += len;
+      in.p += len;
+    } else if (type == 1) {
+      ok = Detail::inflate_block(in, fixed.lit, fixed.dist, dst, out, end);
+    } else if (type == 2) {
+      ok = Detail::read_dynamic_tables(in, lit, dist) &&
+           Detail::inflate_block(in, lit, dist, dst, out, end);
+    } else {
+      ok = false;
+    }
+  }
+
+  written = (u64)(out - dst);
+  return ok;
+}
+
+// Zlib wrapped deflate stream, as in PNG. The Adler-32 is not checked.
+inline bool decompress(const u8 *src, u64 srcSize, u8 *dst, u64 dstSize,
+                       u64 &written) {
+  written = 0;
+  if (srcSize < 2) return false;
+
+  auto cmf = src[0], flg = src[1];
+  if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 != 0 ||
+      (flg & 32))
+    return false;
+  return inflate(src + 2, srcSize - 2, dst, dstSize, written);
+}
+}  // namespace Alien::Zlib
+
+#endif
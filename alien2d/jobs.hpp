@@ -0,0 +1,176 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_JOBS_HPP
+#define ALIEN_JOBS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base.hpp"
+
+namespace Alien {
+// Small fork-join thread pool. The thread which calls parallel_for works on
+// the chunks too and runs queued tasks while it waits, so nested calls from
+// inside a task do not deadlock. Background tasks are only run by the
+// workers, after the fork-join tasks.
+class JobSystem {
+ public:
+  static JobSystem &instance() {
+    static JobSystem ins;
+    return ins;
+  }
+
+  explicit JobSystem(u32 workerCount = default_worker_count()) {
+    for (u32 i = 0; i < workerCount; ++i)
+      m_Workers.emplace_back([this] { worker_loop(); });
+  }
+
+  ~JobSystem() {
+    {
+      std::lock_guard lock(m_Mutex);
+      m_Stop = true;
+    }
+    m_Wake.notify_all();
+    for (auto &worker : m_Workers) worker.join();
+  }
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Workers plus the calling thread.
+  u32 thread_count() const { return (u32)m_Workers.size() + 1; }
+
+  // Calls f(begin, end) for [0, count) split in chunks of grain items and
+  // returns when every chunk is done. Runs inline when there is only one
+  // chunk, so small inputs cost nothing.
+  template <typename F>
+  void parallel_for(u32 count, u32 grain, F &&f) {
+    if (count == 0) return;
+    grain = std::max(grain, 1u);
+    auto chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || m_Workers.empty()) {
+      f(0u, count);
+      return;
+    }
+
+    std::atomic<u32> next{0};
+    std::atomic<u32> finishedHelpers{0};
+    auto run = [&] {
+      for (auto chunk = next.fetch_add(1, std::memory_order_relaxed);
+           chunk < chunks;
+           chunk = next.fetch_add(1, std::memory_order_relaxed)) {
+        auto begin = chunk * grain;
+        f(begin, std::min(begin + grain, count));
+      }
+    };
+
+    // Helpers reference this stack frame, so we wait until all of them
+    // have finished, not only until the chunks are taken.
+    auto helpers = std::min(chunks - 1, (u32)m_Workers.size());
+    {
+      std::lock_guard lock(m_Mutex);
+      for (u32 i = 0; i < helpers; ++i) {
+        m_Tasks.emplace_back([&] {
+          run();
+          finishedHelpers.fetch_add(1, std::memory_order_release);
+        });
+      }
+    }
+    m_Wake.notify_all();
+
+    run();
+    while (finishedHelpers.load(std::memory_order_acquire) < helpers) {
+      if (!try_run_task()) std::this_thread::yield();
+    }
+  }
+
+  // Queues a task and returns at once. Threads waiting in parallel_for do
+  // not pick these up, so long jobs like streaming decodes never stall the
+  // frame. Runs inline when there are no workers.
+  void run_background(std::function<void()> task) {
+    if (m_Workers.empty()) {
+      task();
+      return;
+    }
+    {
+      std::lock_guard lock(m_Mutex);
+      m_Background.push_back(std::move(task));
+    }
+    m_Wake.notify_one();
+  }
+
+ private:
+  static u32 default_worker_count() {
+    auto threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+  }
+
+  bool try_run_task() {
+    std::function<void()> task;
+    {
+      std::lock_guard lock(m_Mutex);
+      if (m_Tasks.empty()) return false;
+      task = std::move(m_Tasks.front());
+      m_Tasks.pop_front();
+    }
+    task();
+    return true;
+  }
+
+  void worker_loop() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(m_Mutex);
+        m_Wake.wait(lock, [this] {
+          return m_Stop || !m_Tasks.empty() || !m_Background.empty();
+        });
+        auto &queue = m_Tasks.empty() ? m_Background : m_Tasks;
+        if (queue.empty()) return;
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Tasks;
+  std::deque<std::function<void()>> m_Background;
+  std::mutex m_Mutex;
+  std::condition_variable m_Wake;
+  bool m_Stop{false};
+};
+}  // namespace Alien
+
+#endif
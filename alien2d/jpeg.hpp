@@ -0,0 +1,1227 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_JPEG_HPP
+#define ALIEN_JPEG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+
+// JPEG decoder for baseline and progressive Huffman coded files with 8-bit
+// samples and one (gray) or three (YCbCr, or RGB when an Adobe marker says
+// so) components. Output is RGBA8. Chroma is upsampled with the same
+// triangle filter as libjpeg. Restart intervals are independent, so they
+// are decoded in parallel.
+namespace Alien::Jpeg {
+struct Info {
+  u32 width;
+  u32 height;
+  u8 components;
+  bool progressive;
+};
+
+namespace Detail {
+// Huffman codes up to FastBits long are decoded with one table lookup
+static constexpr u32 FastBits = 9;
+
+// Position of the zigzag ordered coefficients in the 8x8 block
+static constexpr u8 ZigZag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Scale factors of the AAN IDCT, cos(k * pi / 16) * sqrt(2) for k > 0
+static constexpr f32 AanScale[8] = {1.0f,         1.387039845f, 1.306562965f,
+                                    1.175875602f, 1.0f,         0.785694958f,
+                                    0.541196100f, 0.275899379f};
+
+inline u32 read_be16(const u8 *p) { return (u32)p[0] << 8 | p[1]; }
+
+inline u64 read_be64(const u8 *p) {
+  u64 v = 0;
+  for (u32 i = 0; i < 8; ++i) v = v << 8 | p[i];
+  return v;
+}
+
+// Sign extends the s bit magnitude category value v.
+inline i32 extend(u32 v, u32 s) {
+  return v < (1u << (s - 1)) ? (i32)v - (1 << s) + 1 : (i32)v;
+}
+
+struct Huffman {
+  // Symbol index of the code in the top FastBits bits, 0xFFFF when longer
+  u16 fast[1 << FastBits];
+  // AC run, size and value in one lookup: value << 8 | run << 4 | bits
+  i16 fastAc[1 << FastBits];
+  u8 symbols[256];
+  u8 sizes[256];
+  // End of the codes of each length, left aligned to 16 bits
+  u32 maxCode[18];
+  i32 delta[17];
+  bool defined;
+};
+
+inline bool build_huffman(Huffman &h, const u8 *counts, const u8 *symbols) {
+  u16 codes[256];
+  u32 code = 0, k = 0;
+  for (u32 length = 1; length <= 16; ++length) {
+    h.delta[length] = (i32)k - (i32)code;
+    for (u32 i = 0; i < counts[length - 1]; ++i) {
+      h.sizes[k] = (u8)length;
+      codes[k++] = (u16)code++;
+    }
+    if (code > (1u << length)) return false;
+    h.maxCode[length] = code << (16 - length);
+    code <<= 1;
+  }
+  h.maxCode[17] = ~0u;
+  std::memcpy(h.symbols, symbols, k);
+
+  std::fill(std::begin(h.fast), std::end(h.fast), (u16)0xFFFF);
+  for (u32 i = 0; i < k && h.sizes[i] <= FastBits; ++i) {
+    auto shift = FastBits - h.sizes[i];
+    auto first = (u32)codes[i] << shift;
+    for (u32 j = 0; j < (1u << shift); ++j) h.fast[first + j] = (u16)i;
+  }
+
+  // Short codes followed by a short value are decoded in one lookup
+  std::fill(std::begin(h.fastAc), std::end(h.fastAc), (i16)0);
+  for (u32 i = 0; i < (1u << FastBits); ++i) {
+    auto index = h.fast[i];
+    if (index == 0xFFFF) continue;
+    u32 rs = h.symbols[index], length = h.sizes[index];
+    auto run = rs >> 4, s = rs & 15;
+    if (s == 0 || length + s > FastBits) continue;
+    auto bits = (i >> (FastBits - length - s)) & ((1u << s) - 1);
+    auto value = extend(bits, s);
+    if (value < -128 || value > 127) continue;
+    h.fastAc[i] = (i16)(value * 256 + (i32)(run * 16 + length + s));
+  }
+  h.defined = true;
+  return true;
+}
+
+// Entropy coded data of one restart interval. The 0xFF 0x00 byte stuffing
+// is removed on the fly; zeros are fed past the end.
+struct BitReader {
+  const u8 *p;
+  const u8 *end;
+  u64 buffer{0};
+  u32 bits{0};
+  u32 zeros{0};
+
+  BitReader(const u8 *begin, const u8 *end) : p(begin), end(end) {}
+
+  // Keeps at least 32 bits buffered, enough for a Huffman code and the
+  // value following it. Eight bytes without 0xFF, nearly always the case,
+  // are taken in one go.
+  void refill() {
+    if (bits >= 32) return;
+    if (end - p >= 8) {
+      auto v = read_be64(p);
+      // No 0xFF byte in v means no zero byte in ~v
+      if (!((~v - 0x0101010101010101ull) & v & 0x8080808080808080ull)) {
+        auto count = (64 - bits) >> 3;
+        auto low = 64 - bits - count * 8;
+        buffer |= v >> bits >> low << low;
+        bits += count * 8;
+        p += count;
+        return;
+      }
+    }
+    do {
+      u64 byte = 0;
+      if (p < end) {
+        byte = *p++;
+        if (byte == 0xFF && p < end && *p == 0) ++p;
+      } else {
+        ++zeros;
+      }
+      buffer |= byte << (56 - bits);
+      bits += 8;
+    } while (bits <= 56);
+  }
+
+  u32 peek(u32 count) const { return (u32)(buffer >> (64 - count)); }
+
+  void consume(u32 count) {
+    buffer <<= count;
+    bits -= count;
+  }
+
+  u32 get(u32 count) {
+    if (count == 0) return 0;
+    auto v = peek(count);
+    consume(count);
+    return v;
+  }
+
+  i32 receive_extend(u32 s) { return s ? extend(get(s), s) : 0; }
+
+  // True when bits past the end of the data were used
+  bool overrun() const { return zeros * 8 > bits; }
+};
+
+// Needs a refilled reader. Returns 256 for an invalid code.
+inline u32 decode_huffman(BitReader &reader, const Huffman &h) {
+  auto index = h.fast[reader.peek(FastBits)];
+  if (index != 0xFFFF) {
+    reader.consume(h.sizes[index]);
+    return h.symbols[index];
+  }
+  auto code = reader.peek(16);
+  auto length = FastBits + 1;
+  while (code >= h.maxCode[length]) ++length;
+  if (length > 16) return 256;
+  reader.consume(length);
+  return h.symbols[(i32)(code >> (16 - length)) + h.delta[length]];
+}
+
+// Decodes a baseline block into zeroed coefs, in natural order. last is
+// the zigzag index of the last nonzero coefficient.
+inline bool decode_block(BitReader &reader, const Huffman &dc,
+                         const Huffman &ac, i32 &prediction, i16 *coefs,
+                         u32 &last) {
+  reader.refill();
+  auto t = decode_huffman(reader, dc);
+  if (t > 15) return false;
+  prediction = (i16)(prediction + reader.receive_extend(t));
+  coefs[0] = (i16)prediction;
+
+  last = 0;
+  for (u32 k = 1; k < 64;) {
+    reader.refill();
+    auto fast = ac.fastAc[reader.peek(FastBits)];
+    if (fast) {
+      k += (fast >> 4) & 15;
+      if (k > 63) return false;
+      reader.consume(fast & 15);
+      last = k;
+      coefs[ZigZag[k++]] = (i16)(fast >> 8);
+      continue;
+    }
+
+    auto rs = decode_huffman(reader, ac);
+    if (rs > 255) return false;
+    auto run = rs >> 4, s = rs & 15;
+    if (s == 0) {
+      // End of block, or a run of 16 zeros
+      if (run != 15) break;
+      k += 16;
+      continue;
+    }
+    k += run;
+    if (k > 63) return false;
+    last = k;
+    coefs[ZigZag[k++]] = (i16)reader.receive_extend(s);
+  }
+  return true;
+}
+
+// Dequantization folded together with the IDCT scale factors.
+inline void scale_quant(const u16 *quant, f32 *out) {
+  for (u32 i = 0; i < 64; ++i)
+    out[i] = quant[i] * AanScale[i / 8] * AanScale[i % 8] / 8.0f;
+}
+}  // namespace Detail
+
+namespace Kernel {
+// One dimensional AAN IDCT of 8 values, in place. V is f32 or a vector of
+// 4 lanes doing 4 columns at once.
+template <typename V>
+inline void idct_pass(V *v) {
+  // Even part
+  auto t10 = v[0] + v[4], t11 = v[0] - v[4];
+  auto t13 = v[2] + v[6];
+  auto t12 = (v[2] - v[6]) * 1.414213562f - t13;
+  auto e0 = t10 + t13, e3 = t10 - t13;
+  auto e1 = t11 + t12, e2 = t11 - t12;
+
+  // Odd part
+  auto z13 = v[5] + v[3], z10 = v[5] - v[3];
+  auto z11 = v[1] + v[7], z12 = v[1] - v[7];
+  auto o7 = z11 + z13;
+  auto o11 = (z11 - z13) * 1.414213562f;
+  auto z5 = (z10 + z12) * 1.847759065f;
+  auto o10 = z5 - z12 * 1.082392200f;
+  auto o12 = z5 - z10 * 2.613125930f;
+  auto o6 = o12 - o7;
+  auto o5 = o11 - o6;
+  auto o4 = o10 - o5;
+
+  v[0] = e0 + o7;
+  v[7] = e0 - o7;
+  v[1] = e1 + o6;
+  v[6] = e1 - o6;
+  v[2] = e2 + o5;
+  v[5] = e2 - o5;
+  v[3] = e3 + o4;
+  v[4] = e3 - o4;
+}
+
+inline u8 clamp_sample(f32 v) {
+  return (u8)(i32)std::clamp(v + 0.5f, 0.0f, 255.0f);
+}
+
+// coefs in natural order, quant from scale_quant. Writes 8x8 samples.
+inline void idct_scalar(const i16 *coefs, const f32 *quant, u8 *out,
+                        u32 stride) {
+  f32 block[64];
+  for (u32 i = 0; i < 64; ++i) block[i] = coefs[i] * quant[i];
+  block[0] += 128.0f;
+
+  f32 v[8];
+  for (u32 x = 0; x < 8; ++x) {
+    for (u32 y = 0; y < 8; ++y) v[y] = block[y * 8 + x];
+    idct_pass(v);
+    for (u32 y = 0; y < 8; ++y) block[y * 8 + x] = v[y];
+  }
+  for (u32 y = 0; y < 8; ++y) {
+    idct_pass(block + y * 8);
+    for (u32 x = 0; x < 8; ++x)
+      out[y * stride + x] = clamp_sample(block[y * 8 + x]);
+  }
+}
+
+// Blocks with only a DC coefficient are flat.
+inline void idct_dc(i16 dc, f32 quant, u8 *out, u32 stride) {
+  auto v = clamp_sample(dc * quant + 128.0f);
+  for (u32 y = 0; y < 8; ++y) std::memset(out + y * stride, v, 8);
+}
+
+#if defined(ALIEN_MATH_SSE2) || defined(ALIEN_MATH_NEON)
+#if defined(ALIEN_MATH_SSE2)
+struct F4 {
+  __m128 v;
+};
+inline F4 operator+(F4 a, F4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline F4 operator-(F4 a, F4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline F4 operator*(F4 a, f32 b) { return {_mm_mul_ps(a.v, _mm_set1_ps(b))}; }
+
+inline void transpose4(F4 &a, F4 &b, F4 &c, F4 &d) {
+  _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+}
+#else
+struct F4 {
+  float32x4_t v;
+};
+inline F4 operator+(F4 a, F4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline F4 operator-(F4 a, F4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline F4 operator*(F4 a, f32 b) { return {vmulq_n_f32(a.v, b)}; }
+
+inline void transpose4(F4 &a, F4 &b, F4 &c, F4 &d) {
+  auto ab = vtrnq_f32(a.v, b.v);
+  auto cd = vtrnq_f32(c.v, d.v);
+  a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+  b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+  c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+  d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#endif
+
+// The block is held as rows of columns 0-3 (lo) and 4-7 (hi).
+inline void transpose8(F4 *lo, F4 *hi) {
+  transpose4(lo[0], lo[1], lo[2], lo[3]);
+  transpose4(hi[0], hi[1], hi[2], hi[3]);
+  transpose4(lo[4], lo[5], lo[6], lo[7]);
+  transpose4(hi[4], hi[5], hi[6], hi[7]);
+  for (u32 i = 0; i < 4; ++i) std::swap(hi[i], lo[4 + i]);
+}
+
+inline void idct(const i16 *coefs, const f32 *quant, u8 *out, u32 stride) {
+  F4 lo[8], hi[8];
+#if defined(ALIEN_MATH_SSE2)
+  for (u32 y = 0; y < 8; ++y) {
+    auto c = _mm_loadu_si128((const __m128i *)(coefs + y * 8));
+    auto sign = _mm_srai_epi16(c, 15);
+    lo[y].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(c, sign)),
+                         _mm_loadu_ps(quant + y * 8));
+    hi[y].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(c, sign)),
+                         _mm_loadu_ps(quant + y * 8 + 4));
+  }
+  lo[0].v = _mm_add_ps(lo[0].v, _mm_set_ss(128.0f));
+#else
+  for (u32 y = 0; y < 8; ++y) {
+    auto c = vld1q_s16(coefs + y * 8);
+    lo[y].v = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(c))),
+                        vld1q_f32(quant + y * 8));
+    hi[y].v = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(c))),
+                        vld1q_f32(quant + y * 8 + 4));
+  }
+  // The extra half rounds the truncating conversion below
+  lo[0].v = vaddq_f32(lo[0].v, vsetq_lane_f32(128.5f, vdupq_n_f32(0), 0));
+#endif
+
+  idct_pass(lo);
+  idct_pass(hi);
+  transpose8(lo, hi);
+  idct_pass(lo);
+  idct_pass(hi);
+  transpose8(lo, hi);
+
+  for (u32 y = 0; y < 8; ++y) {
+#if defined(ALIEN_MATH_SSE2)
+    auto v = _mm_packs_epi32(_mm_cvtps_epi32(lo[y].v),
+                             _mm_cvtps_epi32(hi[y].v));
+    _mm_storel_epi64((__m128i *)(out + y * stride), _mm_packus_epi16(v, v));
+#else
+    auto v = vcombine_u16(vqmovn_u32(vcvtq_u32_f32(lo[y].v)),
+                          vqmovn_u32(vcvtq_u32_f32(hi[y].v)));
+    vst1_u8(out + y * stride, vqmovn_u16(v));
+#endif
+  }
+}
+#else
+inline void idct(const i16 *coefs, const f32 *quant, u8 *out, u32 stride) {
+  idct_scalar(coefs, quant, out, stride);
+}
+#endif
+
+// Fixed point coefficients of the YCbCr to RGB conversion (Q12). Samples
+// are Q4 and products keep the high 16 bits, like the SIMD versions.
+static constexpr i32 CrToR = 5743;
+static constexpr i32 CrToG = -2925;
+static constexpr i32 CbToG = -1410;
+static constexpr i32 CbToB = 7258;
+
+inline void ycc_to_rgba(const u8 *y, const u8 *cb, const u8 *cr, u8 *out,
+                        u32 count) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  auto signFlip = _mm_set1_epi8((char)0x80);
+  auto zero = _mm_setzero_si128();
+  auto alpha = _mm_set1_epi16(255);
+  for (; i + 8 <= count; i += 8) {
+    auto yb = _mm_loadl_epi64((const __m128i *)(y + i));
+    auto cbb = _mm_loadl_epi64((const __m128i *)(cb + i));
+    auto crb = _mm_loadl_epi64((const __m128i *)(cr + i));
+    // y * 16 + 8, chroma (c - 128) * 256
+    auto yw = _mm_srli_epi16(_mm_unpacklo_epi8(signFlip, yb), 4);
+    auto cbw = _mm_unpacklo_epi8(zero, _mm_xor_si128(cbb, signFlip));
+    auto crw = _mm_unpacklo_epi8(zero, _mm_xor_si128(crb, signFlip));
+
+    auto r = _mm_add_epi16(yw, _mm_mulhi_epi16(crw, _mm_set1_epi16(CrToR)));
+    auto g = _mm_add_epi16(
+        _mm_add_epi16(yw, _mm_mulhi_epi16(cbw, _mm_set1_epi16(CbToG))),
+        _mm_mulhi_epi16(crw, _mm_set1_epi16(CrToG)));
+    auto b = _mm_add_epi16(yw, _mm_mulhi_epi16(cbw, _mm_set1_epi16(CbToB)));
+
+    auto rb = _mm_packus_epi16(_mm_srai_epi16(r, 4), _mm_srai_epi16(b, 4));
+    auto ga = _mm_packus_epi16(_mm_srai_epi16(g, 4), alpha);
+    auto rg = _mm_unpacklo_epi8(rb, ga);
+    auto ba = _mm_unpackhi_epi8(rb, ga);
+    _mm_storeu_si128((__m128i *)(out + i * 4), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *)(out + i * 4 + 16),
+                     _mm_unpackhi_epi16(rg, ba));
+  }
+#elif defined(ALIEN_MATH_NEON)
+  auto mulhi = [](int16x8_t a, i16 b) {
+    return vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(a), b), 16),
+                        vshrn_n_s32(vmull_n_s16(vget_high_s16(a), b), 16));
+  };
+  auto signFlip = vdup_n_u8(0x80);
+  for (; i + 8 <= count; i += 8) {
+    auto yw = vreinterpretq_s16_u16(
+        vaddq_u16(vshll_n_u8(vld1_u8(y + i), 4), vdupq_n_u16(8)));
+    auto cbw = vshll_n_s8(vreinterpret_s8_u8(veor_u8(vld1_u8(cb + i),
+                                                     signFlip)), 8);
+    auto crw = vshll_n_s8(vreinterpret_s8_u8(veor_u8(vld1_u8(cr + i),
+                                                     signFlip)), 8);
+
+    uint8x8x4_t rgba;
+    rgba.val[0] = vqshrun_n_s16(vaddq_s16(yw, mulhi(crw, CrToR)), 4);
+    rgba.val[1] = vqshrun_n_s16(
+        vaddq_s16(vaddq_s16(yw, mulhi(cbw, CbToG)), mulhi(crw, CrToG)), 4);
+    rgba.val[2] = vqshrun_n_s16(vaddq_s16(yw, mulhi(cbw, CbToB)), 4);
+    rgba.val[3] = vdup_n_u8(255);
+    vst4_u8(out + i * 4, rgba);
+  }
+#endif
+  for (; i < count; ++i) {
+    i32 yw = y[i] * 16 + 8;
+    i32 cbw = (cb[i] - 128) * 256, crw = (cr[i] - 128) * 256;
+    auto r = (yw + ((crw * CrToR) >> 16)) >> 4;
+    auto g = (yw + ((cbw * CbToG) >> 16) + ((crw * CrToG) >> 16)) >> 4;
+    auto b = (yw + ((cbw * CbToB) >> 16)) >> 4;
+    out[i * 4 + 0] = (u8)std::clamp(r, 0, 255);
+    out[i * 4 + 1] = (u8)std::clamp(g, 0, 255);
+    out[i * 4 + 2] = (u8)std::clamp(b, 0, 255);
+    out[i * 4 + 3] = 255;
+  }
+}
+
+// Chroma upsampling by two with libjpeg's triangle filter: each output
+// sample weighs the nearest input 3/4 and the next nearest 1/4. width is
+// the input count; the output has twice as many.
+inline void upsample_h2v1(const u8 *in, u8 *out, u32 width) {
+  if (width == 1) {
+    out[0] = out[1] = in[0];
+    return;
+  }
+  out[0] = in[0];
+  out[1] = (u8)((in[0] * 3 + in[1] + 2) >> 2);
+
+  u32 i = 1;
+#if defined(ALIEN_MATH_SSE2)
+  auto zero = _mm_setzero_si128();
+  auto load = [&](const u8 *p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), zero);
+  };
+  for (; i + 9 <= width; i += 8) {
+    auto cur = load(in + i);
+    auto cur3 = _mm_add_epi16(cur, _mm_add_epi16(cur, cur));
+    auto even = _mm_add_epi16(_mm_add_epi16(cur3, load(in + i - 1)),
+                              _mm_set1_epi16(1));
+    auto odd = _mm_add_epi16(_mm_add_epi16(cur3, load(in + i + 1)),
+                             _mm_set1_epi16(2));
+    // Even samples in the low byte of each lane, odd in the high one
+    auto v = _mm_or_si128(_mm_srli_epi16(even, 2),
+                          _mm_slli_epi16(_mm_srli_epi16(odd, 2), 8));
+    _mm_storeu_si128((__m128i *)(out + i * 2), v);
+  }
+#elif defined(ALIEN_MATH_NEON)
+  for (; i + 9 <= width; i += 8) {
+    auto cur3 = vmulq_n_u16(vmovl_u8(vld1_u8(in + i)), 3);
+    uint8x8x2_t v;
+    v.val[0] = vshrn_n_u16(
+        vaddq_u16(vaddw_u8(cur3, vld1_u8(in + i - 1)), vdupq_n_u16(1)), 2);
+    v.val[1] = vshrn_n_u16(
+        vaddq_u16(vaddw_u8(cur3, vld1_u8(in + i + 1)), vdupq_n_u16(2)), 2);
+    vst2_u8(out + i * 2, v);
+  }
+#endif
+  for (; i + 1 < width; ++i) {
+    u32 cur = in[i] * 3;
+    out[i * 2] = (u8)((cur + in[i - 1] + 1) >> 2);
+    out[i * 2 + 1] = (u8)((cur + in[i + 1] + 2) >> 2);
+  }
+  out[i * 2] = (u8)((in[i] * 3 + in[i - 1] + 1) >> 2);
+  out[i * 2 + 1] = in[i];
+}
+
+// Vertical by two: near is the closest input row, far the one above
+// (upper output row) or below it.
+inline void upsample_h1v2(const u8 *near, const u8 *far, u8 *out, u32 width,
+                          bool upper) {
+  u32 bias = upper ? 1 : 2;
+  for (u32 i = 0; i < width; ++i)
+    out[i] = (u8)((near[i] * 3 + far[i] + bias) >> 2);
+}
+
+// Both directions. sums holds width column sums.
+inline void upsample_h2v2(const u8 *near, const u8 *far, u16 *sums, u8 *out,
+                          u32 width) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  auto zero = _mm_setzero_si128();
+  for (; i + 8 <= width; i += 8) {
+    auto n = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(near + i)),
+                               zero);
+    auto f = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(far + i)),
+                               zero);
+    _mm_storeu_si128((__m128i *)(sums + i),
+                     _mm_add_epi16(_mm_add_epi16(n, _mm_add_epi16(n, n)), f));
+  }
+#elif defined(ALIEN_MATH_NEON)
+  for (; i + 8 <= width; i += 8)
+    vst1q_u16(sums + i, vaddw_u8(vmull_u8(vld1_u8(near + i), vdup_n_u8(3)),
+                                 vld1_u8(far + i)));
+#endif
+  for (; i < width; ++i) sums[i] = (u16)(near[i] * 3 + far[i]);
+  if (width == 1) {
+    out[0] = (u8)((sums[0] * 4 + 8) >> 4);
+    out[1] = (u8)((sums[0] * 4 + 7) >> 4);
+    return;
+  }
+  out[0] = (u8)((sums[0] * 4 + 8) >> 4);
+  out[1] = (u8)((sums[0] * 3 + sums[1] + 7) >> 4);
+
+  i = 1;
+#if defined(ALIEN_MATH_SSE2)
+  auto load = [&](const u16 *p) {
+    return _mm_loadu_si128((const __m128i *)p);
+  };
+  for (; i + 9 <= width; i += 8) {
+    auto cur = load(sums + i);
+    auto cur3 = _mm_add_epi16(cur, _mm_add_epi16(cur, cur));
+    auto even = _mm_add_epi16(_mm_add_epi16(cur3, load(sums + i - 1)),
+                              _mm_set1_epi16(8));
+    auto odd = _mm_add_epi16(_mm_add_epi16(cur3, load(sums + i + 1)),
+                             _mm_set1_epi16(7));
+    auto v = _mm_or_si128(_mm_srli_epi16(even, 4),
+                          _mm_slli_epi16(_mm_srli_epi16(odd, 4), 8));
+    _mm_storeu_si128((__m128i *)(out + i * 2), v);
+  }
+#elif defined(ALIEN_MATH_NEON)
+  for (; i + 9 <= width; i += 8) {
+    auto cur3 = vmulq_n_u16(vld1q_u16(sums + i), 3);
+    uint8x8x2_t v;
+    v.val[0] = vshrn_n_u16(vaddq_u16(vaddq_u16(cur3, vld1q_u16(sums + i - 1)),
+                                     vdupq_n_u16(8)),
+                           4);
+    v.val[1] = vshrn_n_u16(vaddq_u16(vaddq_u16(cur3, vld1q_u16(sums + i + 1)),
+                                     vdupq_n_u16(7)),
+                           4);
+    vst2_u8(out + i * 2, v);
+  }
+#endif
+  for (; i + 1 < width; ++i) {
+    u32 cur = sums[i] * 3;
+    out[i * 2] = (u8)((cur + sums[i - 1] + 8) >> 4);
+    out[i * 2 + 1] = (u8)((cur + sums[i + 1] + 7) >> 4);
+  }
+  out[i * 2] = (u8)((sums[i] * 3 + sums[i - 1] + 8) >> 4);
+  out[i * 2 + 1] = (u8)((sums[i] * 4 + 7) >> 4);
+}
+}  // namespace Kernel
+
+namespace Detail {
+struct Component {
+  u8 id;
+  u8 h;
+  u8 v;
+  u8 quant;
+  u8 dcTable;
+  u8 acTable;
+  // Blocks of the MCU grid, and the part a single component scan covers
+  u32 blocksW;
+  u32 blocksH;
+  u32 usedW;
+  u32 usedH;
+  // Samples before upsampling
+  u32 width;
+  u32 height;
+  // blocksW * 8 wide
+  Memory::Vector<u8, Memory::e_Assets> plane;
+  // Progressive only, 64 per block in natural order
+  Memory::Vector<i16, Memory::e_Assets> coefs;
+  f32 scaledQuant[64];
+};
+
+struct Scan {
+  u32 count;
+  u32 components[4];
+  u32 ss;
+  u32 se;
+  u32 ah;
+  u32 al;
+};
+
+struct Segment {
+  const u8 *begin;
+  const u8 *end;
+};
+
+// Splits the entropy coded data at the restart markers. Returns where the
+// next marker starts.
+inline const u8 *find_segments(
+    const u8 *p, const u8 *end,
+    Memory::Vector<Segment, Memory::e_Assets> &segments) {
+  auto begin = p;
+  for (;;) {
+    auto ff = (const u8 *)std::memchr(p, 0xFF, (size_t)(end - p));
+    if (!ff) break;
+    auto next = ff + 1;
+    while (next < end && *next == 0xFF) ++next;
+    if (next == end) break;
+    if (*next == 0) {
+      p = next + 1;
+      continue;
+    }
+    segments.push_back({begin, ff});
+    if (*next < 0xD0 || *next > 0xD7) return ff;
+    begin = p = next + 1;
+  }
+  segments.push_back({begin, end});
+  return end;
+}
+
+class Decoder {
+ public:
+  Decoder(const u8 *data, u64 size) : m_Data(data), m_End(data + size) {}
+
+  // Walks the markers and decodes the scans. Without jobs it stops after
+  // the frame header.
+  bool run(JobSystem *jobs) {
+    auto &p = m_Pos;
+    p = m_Data;
+    if (m_End - p < 2 || p[0] != 0xFF || p[1] != 0xD8) return false;
+    p += 2;
+
+    while (p < m_End) {
+      // Stray bytes are skipped like libjpeg does, markers may be
+      // preceded by fill bytes
+      while (p < m_End && *p != 0xFF) ++p;
+      while (p < m_End && *p == 0xFF) ++p;
+      if (p == m_End) break;
+      auto marker = *p++;
+      if (marker == 0xD9) break;
+      if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) continue;
+
+      if (m_End - p < 2) return false;
+      auto length = read_be16(p);
+      if (length < 2 || length > (u64)(m_End - p)) return false;
+      auto s = p + 2;
+      length -= 2;
+      p += length + 2;
+
+      switch (marker) {
+        case 0xC0:
+        case 0xC1:
+        case 0xC2:
+          if (!parse_frame(s, length, marker == 0xC2)) return false;
+          if (!jobs) return true;
+          break;
+        case 0xC4:
+          if (!parse_huffman(s, length)) return false;
+          break;
+        case 0xDB:
+          if (!parse_quant(s, length)) return false;
+          break;
+        case 0xDD:
+          if (length < 2) return false;
+          m_RestartInterval = read_be16(s);
+          break;
+        case 0xDA: {
+          Scan scan;
+          if (!m_Frame || !jobs || !parse_scan(s, length, scan)) return false;
+          if (!m_Scans) allocate();
+          if (!decode_scan(scan, *jobs)) return false;
+          ++m_Scans;
+          break;
+        }
+        case 0xEE:
+          // Adobe, transform 0 means the components are RGB
+          if (length >= 12 && std::memcmp(s, "Adobe", 5) == 0)
+            m_Transform = s[11] != 0;
+          break;
+        default:
+          // Lossless, hierarchical and arithmetic coding
+          if (marker >= 0xC3 && marker <= 0xCF) return false;
+          break;
+      }
+    }
+    return m_Frame && jobs && m_Scans > 0;
+  }
+
+  Info info() const {
+    return {m_Width, m_Height, (u8)m_ComponentCount, m_Progressive};
+  }
+
+  // IDCT of the progressive coefficients, after run.
+  void finish(JobSystem &jobs) {
+    if (!m_Progressive) return;
+    for (u32 i = 0; i < m_ComponentCount; ++i) {
+      auto &c = m_Components[i];
+      scale_quant(m_Quant[c.quant], c.scaledQuant);
+      auto stride = c.blocksW * 8;
+      jobs.parallel_for(c.blocksH, 4, [&](u32 begin, u32 end) {
+        for (auto by = begin; by < end; ++by) {
+          for (u32 bx = 0; bx < c.blocksW; ++bx) {
+            auto block = (u64)by * c.blocksW + bx;
+            Kernel::idct(c.coefs.data() + block * 64, c.scaledQuant,
+                         c.plane.data() + ((u64)by * stride + bx) * 8,
+                         stride);
+          }
+        }
+      });
+    }
+  }
+
+  // Upsamples and converts to RGBA8 rows pitch bytes apart.
+  void output(u8 *pixels, u32 pitch, JobSystem &jobs) {
+    auto rowWidth = m_McusX * m_MaxH * 8 + 16;
+    jobs.parallel_for(m_Height, 16, [&](u32 begin, u32 end) {
+      Memory::Vector<u8, Memory::e_Assets> rows((u64)rowWidth * 3);
+      Memory::Vector<u16, Memory::e_Assets> sums(rowWidth);
+      for (auto y = begin; y < end; ++y) {
+        const u8 *src[3];
+        for (u32 i = 0; i < m_ComponentCount; ++i)
+          src[i] = sample_row(m_Components[i], y,
+                              rows.data() + (u64)i * rowWidth, sums.data());
+
+        auto out = pixels + (u64)y * pitch;
+        if (m_ComponentCount == 1) {
+          for (u32 x = 0; x < m_Width; ++x) {
+            out[x * 4 + 0] = out[x * 4 + 1] = out[x * 4 + 2] = src[0][x];
+            out[x * 4 + 3] = 255;
+          }
+        } else if (m_Transform) {
+          Kernel::ycc_to_rgba(src[0], src[1], src[2], out, m_Width);
+        } else {
+          for (u32 x = 0; x < m_Width; ++x) {
+            out[x * 4 + 0] = src[0][x];
+            out[x * 4 + 1] = src[1][x];
+            out[x * 4 + 2] = src[2][x];
+            out[x * 4 + 3] = 255;
+          }
+        }
+      }
+    });
+  }
+
+ private:
+  bool parse_quant(const u8 *s, u32 length) {
+    while (length) {
+      u32 precision = s[0] >> 4, table = s[0] & 15;
+      auto size = 1 + 64 * (precision + 1);
+      if (precision > 1 || table > 3 || length < size) return false;
+      for (u32 i = 0; i < 64; ++i) {
+        auto q = precision ? read_be16(s + 1 + i * 2) : s[1 + i];
+        m_Quant[table][ZigZag[i]] = (u16)std::max(q, 1u);
+      }
+      s += size;
+      length -= size;
+    }
+    return true;
+  }
+
+  bool parse_huffman(const u8 *s, u32 length) {
+    while (length) {
+      if (length < 17) return false;
+      u32 type = s[0] >> 4, table = s[0] & 15;
+      u32 total = 0;
+      for (u32 i = 0; i < 16; ++i) total += s[1 + i];
+      if (type > 1 || table > 3 || total > 256 || length < 17 + total)
+        return false;
+      auto &h = type ? m_Ac[table] : m_Dc[table];
+      if (!build_huffman(h, s + 1, s + 17)) return false;
+      s += 17 + total;
+      length -= 17 + total;
+    }
+    return true;
+  }
+
+  bool parse_frame(const u8 *s, u32 length, bool progressive) {
+    if (m_Frame || length < 6 || s[0] != 8) return false;
+    m_Height = read_be16(s + 1);
+    m_Width = read_be16(s + 3);
+    m_ComponentCount = s[5];
+    m_Progressive = progressive;
+    if (!m_Width || !m_Height) return false;
+    if (m_ComponentCount != 1 && m_ComponentCount != 3) return false;
+    if (length < 6 + m_ComponentCount * 3) return false;
+
+    m_MaxH = m_MaxV = 1;
+    for (u32 i = 0; i < m_ComponentCount; ++i) {
+      auto &c = m_Components[i];
+      c.id = s[6 + i * 3];
+      c.h = s[7 + i * 3] >> 4;
+      c.v = s[7 + i * 3] & 15;
+      c.quant = s[8 + i * 3];
+      if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.quant > 3)
+        return false;
+      for (u32 j = 0; j < i; ++j)
+        if (m_Components[j].id == c.id) return false;
+      // A single component is never interleaved, sampling does not matter
+      if (m_ComponentCount == 1) c.h = c.v = 1;
+      m_MaxH = std::max(m_MaxH, (u32)c.h);
+      m_MaxV = std::max(m_MaxV, (u32)c.v);
+    }
+    // Without an Adobe marker, components named R, G and B are RGB
+    if (m_ComponentCount == 3 && m_Components[0].id == 'R' &&
+        m_Components[1].id == 'G' && m_Components[2].id == 'B')
+      m_Transform = false;
+
+    m_McusX = (m_Width + m_MaxH * 8 - 1) / (m_MaxH * 8);
+    m_McusY = (m_Height + m_MaxV * 8 - 1) / (m_MaxV * 8);
+    u64 blocks = 0;
+    for (u32 i = 0; i < m_ComponentCount; ++i) {
+      auto &c = m_Components[i];
+      if (m_MaxH % c.h || m_MaxV % c.v) return false;
+      c.blocksW = m_McusX * c.h;
+      c.blocksH = m_McusY * c.v;
+      c.width = (m_Width * c.h + m_MaxH - 1) / m_MaxH;
+      c.height = (m_Height * c.v + m_MaxV - 1) / m_MaxV;
+      c.usedW = (c.width + 7) / 8;
+      c.usedH = (c.height + 7) / 8;
+      blocks += (u64)c.blocksW * c.blocksH;
+    }
+    // Every block costs at least a bit, refuse headers which do not fit
+    // the file before anything is allocated
+    if (blocks > (u64)(m_End - m_Data) * 128 + 4096) return false;
+    m_Frame = true;
+    return true;
+  }
+
+  void allocate() {
+    for (u32 i = 0; i < m_ComponentCount; ++i) {
+      auto &c = m_Components[i];
+      c.plane.resize((u64)c.blocksW * c.blocksH * 64);
+      if (m_Progressive) c.coefs.assign((u64)c.blocksW * c.blocksH * 64, 0);
+    }
+  }
+
+  bool parse_scan(const u8 *s, u32 length, Scan &scan) {
+    if (length < 1) return false;
+    scan.count = s[0];
+    if (scan.count < 1 || scan.count > m_ComponentCount ||
+        length < 4 + scan.count * 2)
+      return false;
+
+    u32 blocksPerMcu = 0;
+    for (u32 i = 0; i < scan.count; ++i) {
+      auto id = s[1 + i * 2], tables = s[2 + i * 2];
+      u32 index = 0;
+      while (index < m_ComponentCount && m_Components[index].id != id)
+        ++index;
+      if (index == m_ComponentCount) return false;
+      auto &c = m_Components[index];
+      c.dcTable = tables >> 4;
+      c.acTable = tables & 15;
+      if (c.dcTable > 3 || c.acTable > 3) return false;
+      scan.components[i] = index;
+      blocksPerMcu += c.h * c.v;
+    }
+    if (scan.count > 1 && blocksPerMcu > 10) return false;
+
+    auto spec = s + 1 + scan.count * 2;
+    scan.ss = spec[0];
+    scan.se = spec[1];
+    scan.ah = spec[2] >> 4;
+    scan.al = spec[2] & 15;
+    if (!m_Progressive) {
+      scan.ss = 0;
+      scan.se = 63;
+      scan.ah = scan.al = 0;
+    } else if (scan.ss > scan.se || scan.se > 63 ||
+               (scan.ss == 0) != (scan.se == 0) ||
+               (scan.ss > 0 && scan.count != 1) || scan.ah > 13 ||
+               scan.al > 13) {
+      return false;
+    }
+
+    for (u32 i = 0; i < scan.count; ++i) {
+      auto &c = m_Components[scan.components[i]];
+      if (scan.ss == 0 && scan.ah == 0 && !m_Dc[c.dcTable].defined)
+        return false;
+      if (scan.se > 0 && !m_Ac[c.acTable].defined) return false;
+    }
+    return true;
+  }
+
+  bool decode_scan(const Scan &scan, JobSystem &jobs) {
+    m_Segments.clear();
+    m_Pos = find_segments(m_Pos, m_End, m_Segments);
+
+    auto &first = m_Components[scan.components[0]];
+    auto total =
+        scan.count == 1 ? first.usedW * first.usedH : m_McusX * m_McusY;
+    auto interval = m_RestartInterval ? m_RestartInterval : total;
+    auto expected = (total + interval - 1) / interval;
+    if (m_Segments.size() < expected) return false;
+
+    if (!m_Progressive) {
+      for (u32 i = 0; i < scan.count; ++i) {
+        auto &c = m_Components[scan.components[i]];
+        scale_quant(m_Quant[c.quant], c.scaledQuant);
+      }
+    }
+
+    std::atomic<bool> ok{true};
+    jobs.parallel_for(expected, 1, [&](u32 begin, u32 end) {
+      for (auto i = begin; i < end; ++i) {
+        auto mcu = i * interval;
+        if (!decode_segment(scan, m_Segments[i], mcu,
+                            std::min(mcu + interval, total)))
+          ok.store(false, std::memory_order_relaxed);
+      }
+    });
+    return ok.load(std::memory_order_relaxed);
+  }
+
+  // Calls f(index in scan, component, block x, block y) for the blocks of
+  // the MCUs [first, last) in coding order.
+  template <typename F>
+  bool for_each_block(const Scan &scan, u32 first, u32 last, F &&f) {
+    if (scan.count == 1) {
+      auto &c = m_Components[scan.components[0]];
+      for (auto mcu = first; mcu < last; ++mcu)
+        if (!f(0u, c, mcu % c.usedW, mcu / c.usedW)) return false;
+      return true;
+    }
+    for (auto mcu = first; mcu < last; ++mcu) {
+      auto mx = mcu % m_McusX, my = mcu / m_McusX;
+      for (u32 i = 0; i < scan.count; ++i) {
+        auto &c = m_Components[scan.components[i]];
+        for (u32 y = 0; y < c.v; ++y)
+          for (u32 x = 0; x < c.h; ++x)
+            if (!f(i, c, mx * c.h + x, my * c.v + y)) return false;
+      }
+    }
+    return true;
+  }
+
+  bool decode_segment(const Scan &scan, Segment segment, u32 first,
+                      u32 last) {
+    BitReader reader(segment.begin, segment.end);
+    i32 predictions[4] = {};
+    u32 eobRun = 0;
+
+    auto coefs = [](Component &c, u32 bx, u32 by) {
+      return c.coefs.data() + ((u64)by * c.blocksW + bx) * 64;
+    };
+
+    bool ok;
+    if (!m_Progressive) {
+      ok = for_each_block(scan, first, last, [&](u32 i, Component &c, u32 bx,
+                                                 u32 by) {
+        i16 block[64] = {};
+        u32 end;
+        if (!decode_block(reader, m_Dc[c.dcTable], m_Ac[c.acTable],
+                          predictions[i], block, end))
+          return false;
+        auto stride = c.blocksW * 8;
+        auto out = c.plane.data() + ((u64)by * stride + bx) * 8;
+        if (end == 0)
+          Kernel::idct_dc(block[0], c.scaledQuant[0], out, stride);
+        else
+          Kernel::idct(block, c.scaledQuant, out, stride);
+        return true;
+      });
+    } else if (scan.ss == 0 && scan.ah == 0) {
+      // DC first pass
+      ok = for_each_block(scan, first, last, [&](u32 i, Component &c, u32 bx,
+                                                 u32 by) {
+        reader.refill();
+        auto t = decode_huffman(reader, m_Dc[c.dcTable]);
+        if (t > 15) return false;
+        predictions[i] = (i16)(predictions[i] + reader.receive_extend(t));
+        coefs(c, bx, by)[0] = (i16)(predictions[i] * (1 << scan.al));
+        return true;
+      });
+    } else if (scan.ss == 0) {
+      // DC refinement, one bit per block
+      ok = for_each_block(scan, first, last,
+                          [&](u32, Component &c, u32 bx, u32 by) {
+                            reader.refill();
+                            if (reader.get(1))
+                              coefs(c, bx, by)[0] |= (i16)(1 << scan.al);
+                            return true;
+                          });
+    } else if (scan.ah == 0) {
+      // AC first pass, EOB runs span blocks
+      ok = for_each_block(scan, first, last, [&](u32, Component &c, u32 bx,
+                                                 u32 by) {
+        if (eobRun) {
+          --eobRun;
+          return true;
+        }
+        auto block = coefs(c, bx, by);
+        auto &ac = m_Ac[c.acTable];
+        for (auto k = scan.ss; k <= scan.se;) {
+          reader.refill();
+          auto fast = ac.fastAc[reader.peek(FastBits)];
+          if (fast) {
+            k += (fast >> 4) & 15;
+            if (k > scan.se) return false;
+            reader.consume(fast & 15);
+            block[ZigZag[k++]] = (i16)((fast >> 8) * (1 << scan.al));
+            continue;
+          }
+
+          auto rs = decode_huffman(reader, ac);
+          if (rs > 255) return false;
+          auto run = rs >> 4, s = rs & 15;
+          if (s == 0) {
+            if (run < 15) {
+              eobRun = (1u << run) - 1 + reader.get(run);
+              break;
+            }
+            k += 16;
+            continue;
+          }
+          k += run;
+          if (k > scan.se) return false;
+          block[ZigZag[k++]] = (i16)(reader.receive_extend(s) * (1 << scan.al));
+        }
+        return true;
+      });
+    } else {
+      ok = for_each_block(scan, first, last, [&](u32, Component &c, u32 bx,
+                                                 u32 by) {
+        return refine_ac(reader, scan, m_Ac[c.acTable], coefs(c, bx, by),
+                         eobRun);
+      });
+    }
+    return ok && !reader.overrun();
+  }
+
+  // AC refinement adds one bit to the nonzero coefficients and places new
+  // ones of magnitude 1, with the zero runs counting only zero
+  // coefficients. Follows libjpeg's decode_mcu_AC_refine.
+  static bool refine_ac(BitReader &reader, const Scan &scan,
+                        const Huffman &ac, i16 *block, u32 &eobRun) {
+    auto p1 = (i16)(1 << scan.al), m1 = (i16)(-1 * (1 << scan.al));
+    auto refine = [&](i16 &coef) {
+      reader.refill();
+      if (reader.get(1) && !(coef & p1)) coef += coef >= 0 ? p1 : m1;
+    };
+
+    auto k = scan.ss;
+    if (!eobRun) {
+      for (; k <= scan.se; ++k) {
+        reader.refill();
+        auto rs = decode_huffman(reader, ac);
+        if (rs > 255) return false;
+        i32 run = rs >> 4, s = rs & 15;
+        i16 value = 0;
+        if (s) {
+          if (s != 1) return false;
+          value = reader.get(1) ? p1 : m1;
+        } else if (run != 15) {
+          eobRun = (1u << run) + reader.get(run);
+          break;
+        }
+
+        for (; k <= scan.se; ++k) {
+          auto &coef = block[ZigZag[k]];
+          if (coef)
+            refine(coef);
+          else if (--run < 0)
+            break;
+        }
+        if (value) {
+          if (k > scan.se) return false;
+          block[ZigZag[k]] = value;
+        }
+      }
+    }
+    if (eobRun) {
+      for (; k <= scan.se; ++k) {
+        auto &coef = block[ZigZag[k]];
+        if (coef) refine(coef);
+      }
+      --eobRun;
+    }
+    return true;
+  }
+
+  // Row y of the component at full resolution.
+  const u8 *sample_row(const Component &c, u32 y, u8 *buffer, u16 *sums) {
+    auto sx = m_MaxH / c.h, sy = m_MaxV / c.v;
+    auto stride = (u64)c.blocksW * 8;
+    auto cy = y / sy;
+    auto near = c.plane.data() + cy * stride;
+    if (sx == 1 && sy == 1) return near;
+
+    if (sy == 2 && sx <= 2) {
+      auto upper = !(y & 1);
+      auto fy = upper ? (cy ? cy - 1 : 0) : std::min(cy + 1, c.height - 1);
+      auto far = c.plane.data() + fy * stride;
+      if (sx == 2)
+        Kernel::upsample_h2v2(near, far, sums, buffer, c.width);
+      else
+        Kernel::upsample_h1v2(near, far, buffer, c.width, upper);
+      return buffer;
+    }
+    if (sy == 1 && sx == 2) {
+      Kernel::upsample_h2v1(near, buffer, c.width);
+      return buffer;
+    }
+    // Other factors are rare, the samples are repeated
+    for (u32 x = 0; x < m_Width; ++x) buffer[x] = near[x / sx];
+    return buffer;
+  }
+
+  const u8 *m_Data;
+  const u8 *m_End;
+  const u8 *m_Pos{nullptr};
+
+  bool m_Frame{false};
+  bool m_Progressive{false};
+  // YCbCr, false for RGB
+  bool m_Transform{true};
+  u32 m_Width{0};
+  u32 m_Height{0};
+  u32 m_ComponentCount{0};
+  u32 m_MaxH{1};
+  u32 m_MaxV{1};
+  u32 m_McusX{0};
+  u32 m_McusY{0};
+  u32 m_RestartInterval{0};
+  u32 m_Scans{0};
+
+  Component m_Components[3];
+  u16 m_Quant[4][64]{};
+  Huffman m_Dc[4]{};
+  Huffman m_Ac[4]{};
+  Memory::Vector<Segment, Memory::e_Assets> m_Segments;
+};
+}  // namespace Detail
+
+// Reads the frame header without decoding.
+inline bool read_info(const u8 *data, u64 size, Info &info) {
+  Detail::Decoder decoder(data, size);
+  if (!decoder.run(nullptr)) return false;
+  info = decoder.info();
+  return true;
+}
+
+// Decodes to RGBA8 rows pitch bytes apart. Restart intervals, the IDCT of
+// progressive files and the color conversion are spread over the jobs.
+inline bool decode(const u8 *data, u64 size, u8 *pixels, u32 pitch,
+                   JobSystem &jobs = JobSystem::instance()) {
+  Detail::Decoder decoder(data, size);
+  if (!decoder.run(&jobs)) return false;
+  decoder.finish(jobs);
+  decoder.output(pixels, pitch, jobs);
+  return true;
+}
+
+inline bool load(const u8 *data, u64 size, Image &image,
+                 JobSystem &jobs = JobSystem::instance()) {
+  Info info;
+  if (!read_info(data, size, info)) return false;
+
+  image.width = info.width;
+  image.height = info.height;
+  image.pixels.resize((u64)info.width * info.height * 4);
+  return decode(data, size, image.pixels.data(), info.width * 4, jobs);
+}
+
+// Decodes the files in parallel, one file per job.
+inline void decode_all(DecodeTask *tasks, u32 count,
+                       JobSystem &jobs = JobSystem::instance()) {
+  jobs.parallel_for(count, 1, [&](u32 begin, u32 end) {
+    for (auto i = begin; i < end; ++i) {
+      auto &task = tasks[i];
+      task.ok = decode(task.data, task.size, task.pixels, task.pitch, jobs);
+    }
+  });
+}
+}  // namespace Alien::Jpeg
+
+#endif
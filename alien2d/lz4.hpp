@@ -0,0 +1,209 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_LZ4_HPP
+#define ALIEN_LZ4_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "base.hpp"
+
+// LZ4 block format, compatible with the reference implementation. The
+// compressor is the greedy single hash probe of LZ4 "fast" and works on
+// blocks of up to 64 KiB, which is what packs store. The decompressor
+// checks every length and offset against both buffers.
+namespace Alien::Lz4 {
+static constexpr u32 MaxBlockSize = 1u << 16;
+
+namespace Detail {
+static constexpr u32 HashBits = 13;
+static constexpr u32 MinMatch = 4;
+// The format ends every block with literals: a match starts at least
+// MatchLimit bytes and ends at least LastLiterals bytes before the end.
+static constexpr u32 LastLiterals = 5;
+static constexpr u32 MatchLimit = 12;
+
+inline u32 read32(const u8 *p) {
+  u32 v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline u64 read64(const u8 *p) {
+  u64 v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+inline u32 hash(u32 v) { return v * 2654435761u >> (32 - HashBits); }
+
+// Bytes equal at a and b, up to limit - b.
+inline u32 match_length(const u8 *a, const u8 *b, const u8 *limit) {
+  auto start = b;
+  while (limit - b >= 8) {
+    auto diff = read64(a) ^ read64(b);
+    if (diff) return (u32)(b - start) + (u32)(std::countr_zero(diff) >> 3);
+    a += 8;
+    b += 8;
+  }
+  while (b < limit && *a == *b) ++a, ++b;
+  return (u32)(b - start);
+}
+
+// Writes the 255 continuation bytes of a length above 15.
+inline u8 *write_length(u8 *op, u32 length) {
+  for (; length >= 255; length -= 255) *op++ = 255;
+  *op++ = (u8)length;
+  return op;
+}
+}  // namespace Detail
+
+// Room a block of size bytes can need in the worst case.
+inline u64 compress_bound(u64 size) { return size + size / 255 + 16; }
+
+// Compresses size bytes (at most MaxBlockSize) into dst. Returns the
+// compressed size, or 0 when it would not fit in capacity bytes.
+inline u64 compress(const u8 *src, u32 size, u8 *dst, u64 capacity) {
+  using namespace Detail;
+  if (size > MaxBlockSize) return 0;
+
+  auto op = dst, oend = dst + capacity;
+  auto anchor = src, end = src + size;
+  // Sequences take the literals from anchor and the match from ip
+  auto emit = [&](const u8 *ip, u32 offset, u32 length) {
+    auto literals = (u32)(ip - anchor);
+    u64 need = 1 + literals / 255 + 1 + literals + 2 + length / 255 + 1;
+    if ((u64)(oend - op) < need) return false;
+    auto token = op++;
+    *token = (u8)(std::min(literals, 15u) << 4);
+    if (literals >= 15) op = write_length(op, literals - 15);
+    std::memcpy(op, anchor, literals);
+    op += literals;
+    if (offset) {
+      *op++ = (u8)offset;
+      *op++ = (u8)(offset >> 8);
+      *token |= (u8)std::min(length - MinMatch, 15u);
+      if (length - MinMatch >= 15)
+        op = write_length(op, length - MinMatch - 15);
+    }
+    return true;
+  };
+
+  if (size >= MatchLimit + 1) {
+    // Positions fit 16 bits since blocks are at most 64 KiB
+    u16 table[1u << HashBits] = {};
+    auto ip = src + 1, limit = end - MatchLimit;
+    auto matchEnd = end - LastLiterals;
+    while (ip <= limit) {
+      // Skip faster through data which does not match
+      u32 misses = 0;
+      const u8 *ref = nullptr;
+      for (; ip <= limit; ip += 1 + (misses++ >> 6)) {
+        auto h = hash(read32(ip));
+        auto candidate = src + table[h];
+        table[h] = (u16)(ip - src);
+        if (candidate < ip && read32(candidate) == read32(ip)) {
+          ref = candidate;
+          break;
+        }
+      }
+      if (!ref) break;
+
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) --ip, --ref;
+      auto length = MinMatch +
+                    match_length(ref + MinMatch, ip + MinMatch, matchEnd);
+      if (!emit(ip, (u32)(ip - ref), length)) return 0;
+      ip += length;
+      anchor = ip;
+      if (ip <= limit) table[hash(read32(ip - 2))] = (u16)(ip - 2 - src);
+    }
+  }
+  if (!emit(end, 0, 0)) return 0;
+  return (u64)(op - dst);
+}
+
+// Decompresses a whole block, true when it fills dst exactly.
+inline bool decompress(const u8 *src, u64 srcSize, u8 *dst, u64 dstSize) {
+  auto ip = src, end = src + srcSize;
+  auto op = dst, oend = dst + dstSize;
+  auto read_length = [&](u64 &length) {
+    u8 b;
+    do {
+      if (ip == end) return false;
+      b = *ip++;
+      length += b;
+    } while (b == 255);
+    return true;
+  };
+
+  while (ip < end) {
+    auto token = *ip++;
+    u64 literals = token >> 4;
+    if (literals == 15 && !read_length(literals)) return false;
+    if (literals > (u64)(end - ip) || literals > (u64)(oend - op))
+      return false;
+    // Short runs are copied 16 bytes wide when both buffers have room
+    if (literals <= 16 && end - ip >= 16 && oend - op >= 16)
+      std::memcpy(op, ip, 16);
+    else
+      std::memcpy(op, ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == end) return op == oend;
+
+    if (end - ip < 2) return false;
+    u64 offset = (u64)ip[0] | (u64)ip[1] << 8;
+    ip += 2;
+    u64 length = token & 15;
+    if (length == 15 && !read_length(length)) return false;
+    length += Detail::MinMatch;
+    if (!offset || offset > (u64)(op - dst) || length > (u64)(oend - op))
+      return false;
+
+    auto match = op - offset;
+    if (offset >= 16 && (u64)(oend - op) >= length + 16) {
+      // Copies may overrun the match, the next sequence overwrites it
+      for (u64 i = 0; i < length; i += 16) std::memcpy(op + i, match + i, 16);
+    } else if (offset >= 8 && (u64)(oend - op) >= length + 8) {
+      for (u64 i = 0; i < length; i += 8) std::memcpy(op + i, match + i, 8);
+    } else if ((u64)(oend - op) >= length + 8) {
+      // Close matches repeat the last offset bytes. Once 8 bytes are out
+      // the pattern is copied from a multiple of offset at least 8 back.
+      for (u64 i = 0; i < 8; ++i) op[i] = match[i];
+      auto step = offset * ((8 + offset - 1) / offset);
+      for (u64 i = 8; i < length; i += 8) std::memcpy(op + i, op + i - step, 8);
+    } else {
+      for (u64 i = 0; i < length; ++i) op[i] = match[i];
+    }
+    op += length;
+  }
+  return false;
+}
+}  // namespace Alien::Lz4
+
+#endif
@@ -23,45 +23,573 @@ SOFTWARE.
 */
 #ifdef _WIN32
 #pragma once
-#elif
-#ifndef ALIEN_HPP
-#define ALIEN_HPP
-#endif
 #endif
+#ifndef ALIEN_MATH_HPP
+#define ALIEN_MATH_HPP
+
+#include <cmath>
+#include <cstddef>
+
 #include "base.hpp"
-#include <DirectXMath.h>
+#include "cpu.hpp"
+#include "vertex_layout.hpp"
+
+// Baseline instruction set of the math module. SSE2 is always there on x64,
+// wider kernels are selected at runtime (see cpu.hpp).
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALIEN_MATH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define ALIEN_MATH_NEON
+#include <arm_neon.h>
+#endif
 
 namespace Alien {
-    namespace Math {
-        struct Vector4 {
-            f32 x, y, z, w;
-        };
+namespace Math {
+static constexpr f32 Pi = 3.14159265358979323846f;
+
+struct Vec2 {
+  f32 x, y;
+
+  Vec2 operator+(Vec2 o) const { return {x + o.x, y + o.y}; }
+  Vec2 operator-(Vec2 o) const { return {x - o.x, y - o.y}; }
+  Vec2 operator*(Vec2 o) const { return {x * o.x, y * o.y}; }
+  Vec2 operator/(Vec2 o) const { return {x / o.x, y / o.y}; }
+  Vec2 operator*(f32 s) const { return {x * s, y * s}; }
+  Vec2 operator/(f32 s) const { return {x / s, y / s}; }
+  Vec2 operator-() const { return {-x, -y}; }
+
+  Vec2 &operator+=(Vec2 o) { return *this = *this + o; }
+  Vec2 &operator-=(Vec2 o) { return *this = *this - o; }
+  Vec2 &operator*=(f32 s) { return *this = *this * s; }
+
+  bool operator==(const Vec2 &) const = default;
+};
+
+inline f32 dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+inline f32 cross(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+inline f32 length(Vec2 v) { return std::sqrt(dot(v, v)); }
+inline Vec2 normalize(Vec2 v) {
+  auto len = length(v);
+  return len > 0.0f ? v / len : Vec2{0.0f, 0.0f};
+}
+inline Vec2 lerp(Vec2 a, Vec2 b, f32 t) { return a + (b - a) * t; }
+
+// Constants of the fast sine/cosine, the argument is reduced to
+// [-pi/4, pi/4] with a three part pi/2 (Cody-Waite), then polynomials from
+// Cephes are evaluated. Error is below 1e-6 for |x| < 8192.
+namespace SinCos {
+static constexpr f32 TwoOverPi = 0.636619772367581343f;
+static constexpr f32 PiOver2A = 1.5703125f;
+static constexpr f32 PiOver2B = 4.837512969970703125e-4f;
+static constexpr f32 PiOver2C = 7.54978995489188216e-8f;
+static constexpr f32 S1 = -1.6666654611e-1f;
+static constexpr f32 S2 = 8.3321608736e-3f;
+static constexpr f32 S3 = -1.9515295891e-4f;
+static constexpr f32 C1 = 4.166664568298827e-2f;
+static constexpr f32 C2 = -1.388731625493765e-3f;
+static constexpr f32 C3 = 2.443315711809948e-5f;
+}  // namespace SinCos
+
+inline void fast_sincos(f32 x, f32 &s, f32 &c) {
+  using namespace SinCos;
+  auto q = (i32)std::lrint(x * TwoOverPi);
+  auto qf = (f32)q;
+  auto r = ((x - qf * PiOver2A) - qf * PiOver2B) - qf * PiOver2C;
+  auto r2 = r * r;
+  auto sr = r + r * r2 * (S1 + r2 * (S2 + r2 * S3));
+  auto cr = 1.0f - 0.5f * r2 + r2 * r2 * (C1 + r2 * (C2 + r2 * C3));
+
+  switch (q & 3) {
+    case 0: s = sr; c = cr; break;
+    case 1: s = cr; c = -sr; break;
+    case 2: s = -sr; c = -cr; break;
+    default: s = -cr; c = sr; break;
+  }
+}
+
+struct Vector3 {
+  f32 x, y, z;
+};
+
+// Four wide vector (colors, rectangles), ops map to one SIMD instruction.
+struct alignas(16) Vec4 {
+  f32 x, y, z, w;
+
+#if defined(ALIEN_MATH_SSE2)
+  Vec4() = default;
+  Vec4(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+  explicit Vec4(__m128 v) { _mm_store_ps(&x, v); }
+  __m128 simd() const { return _mm_load_ps(&x); }
+
+  Vec4 operator+(const Vec4 &o) const {
+    return Vec4(_mm_add_ps(simd(), o.simd()));
+  }
+  Vec4 operator-(const Vec4 &o) const {
+    return Vec4(_mm_sub_ps(simd(), o.simd()));
+  }
+  Vec4 operator*(const Vec4 &o) const {
+    return Vec4(_mm_mul_ps(simd(), o.simd()));
+  }
+  Vec4 operator*(f32 s) const {
+    return Vec4(_mm_mul_ps(simd(), _mm_set1_ps(s)));
+  }
+#elif defined(ALIEN_MATH_NEON)
+  Vec4() = default;
+  Vec4(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+  explicit Vec4(float32x4_t v) { vst1q_f32(&x, v); }
+  float32x4_t simd() const { return vld1q_f32(&x); }
+
+  Vec4 operator+(const Vec4 &o) const {
+    return Vec4(vaddq_f32(simd(), o.simd()));
+  }
+  Vec4 operator-(const Vec4 &o) const {
+    return Vec4(vsubq_f32(simd(), o.simd()));
+  }
+  Vec4 operator*(const Vec4 &o) const {
+    return Vec4(vmulq_f32(simd(), o.simd()));
+  }
+  Vec4 operator*(f32 s) const { return Vec4(vmulq_n_f32(simd(), s)); }
+#else
+  Vec4() = default;
+  Vec4(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+
+  Vec4 operator+(const Vec4 &o) const {
+    return {x + o.x, y + o.y, z + o.z, w + o.w};
+  }
+  Vec4 operator-(const Vec4 &o) const {
+    return {x - o.x, y - o.y, z - o.z, w - o.w};
+  }
+  Vec4 operator*(const Vec4 &o) const {
+    return {x * o.x, y * o.y, z * o.z, w * o.w};
+  }
+  Vec4 operator*(f32 s) const { return {x * s, y * s, z * s, w * s}; }
+#endif
+
+  Vec4 &operator+=(const Vec4 &o) { return *this = *this + o; }
+  Vec4 &operator-=(const Vec4 &o) { return *this = *this - o; }
+  Vec4 &operator*=(f32 s) { return *this = *this * s; }
+};
+
+inline Vec4 lerp(const Vec4 &a, const Vec4 &b, f32 t) {
+  return a + (b - a) * t;
+}
+
+// 2D affine transform, the 3x2 part of
+//   | a c tx |
+//   | b d ty |
+//   | 0 0 1  |
+// a, b, c, d are contiguous so the linear part can be loaded as one vector.
+struct Mat3x2 {
+  f32 a, b, c, d, tx, ty;
+
+  static Mat3x2 identity() { return {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f}; }
+
+  static Mat3x2 translation(Vec2 t) {
+    return {1.0f, 0.0f, 0.0f, 1.0f, t.x, t.y};
+  }
+
+  static Mat3x2 scale(Vec2 s) { return {s.x, 0.0f, 0.0f, s.y, 0.0f, 0.0f}; }
+
+  static Mat3x2 rotation(f32 radians) {
+    auto s = std::sin(radians), c = std::cos(radians);
+    return {c, s, -s, c, 0.0f, 0.0f};
+  }
+
+  // Scale and rotate around the pivot, then move the pivot to the position.
+  static Mat3x2 trs(Vec2 position, f32 radians, Vec2 scale,
+                    Vec2 pivot = {0.0f, 0.0f}) {
+    auto s = std::sin(radians), c = std::cos(radians);
+    Mat3x2 m{c * scale.x, s * scale.x, -s * scale.y, c * scale.y, 0.0f, 0.0f};
+    m.tx = position.x - (m.a * pivot.x + m.c * pivot.y);
+    m.ty = position.y - (m.b * pivot.x + m.d * pivot.y);
+    return m;
+  }
+
+  // Applies o first, then this.
+  Mat3x2 operator*(const Mat3x2 &o) const {
+    Mat3x2 r;
+#if defined(ALIEN_MATH_SSE2)
+    auto lhs = _mm_loadu_ps(&a);
+    auto rhs = _mm_loadu_ps(&o.a);
+    // [a b a b] * [oa oa oc oc] + [c d c d] * [ob ob od od]
+    auto ab = _mm_movelh_ps(lhs, lhs);
+    auto cd = _mm_movehl_ps(lhs, lhs);
+    auto rx = _mm_shuffle_ps(rhs, rhs, _MM_SHUFFLE(2, 2, 0, 0));
+    auto ry = _mm_shuffle_ps(rhs, rhs, _MM_SHUFFLE(3, 3, 1, 1));
+    _mm_storeu_ps(&r.a, _mm_add_ps(_mm_mul_ps(ab, rx), _mm_mul_ps(cd, ry)));
+#else
+    r.a = a * o.a + c * o.b;
+    r.b = b * o.a + d * o.b;
+    r.c = a * o.c + c * o.d;
+    r.d = b * o.c + d * o.d;
+#endif
+    r.tx = a * o.tx + c * o.ty + tx;
+    r.ty = b * o.tx + d * o.ty + ty;
+    return r;
+  }
+
+  Vec2 transform_point(Vec2 p) const {
+    return {a * p.x + c * p.y + tx, b * p.x + d * p.y + ty};
+  }
+
+  Vec2 transform_vector(Vec2 v) const {
+    return {a * v.x + c * v.y, b * v.x + d * v.y};
+  }
+
+  f32 determinant() const { return a * d - b * c; }
+
+  // Singular matrices give the identity.
+  Mat3x2 inverse() const {
+    auto det = determinant();
+    if (det == 0.0f) return identity();
+
+    auto inv = 1.0f / det;
+    Mat3x2 r{d * inv, -b * inv, -c * inv, a * inv, 0.0f, 0.0f};
+    r.tx = -(r.a * tx + r.c * ty);
+    r.ty = -(r.b * tx + r.d * ty);
+    return r;
+  }
+};
+
+// -- Batch APIs, they are the hot loops. Every one has a baseline kernel
+// and AVX2 / AVX-512 kernels picked at runtime. The wide kernels may fuse
+// multiply-adds, so the last bit can differ between machines.
+namespace Kernel {
+inline void transform_points_baseline(const Mat3x2 &m, const Vec2 *in,
+                                      Vec2 *out, std::size_t count) {
+  std::size_t i = 0;
+  auto src = (const f32 *)in;
+  auto dst = (f32 *)out;
+#if defined(ALIEN_MATH_SSE2)
+  // Two interleaved points per iteration
+  auto ab = _mm_setr_ps(m.a, m.b, m.a, m.b);
+  auto cd = _mm_setr_ps(m.c, m.d, m.c, m.d);
+  auto t = _mm_setr_ps(m.tx, m.ty, m.tx, m.ty);
+  for (; i + 2 <= count; i += 2) {
+    auto v = _mm_loadu_ps(src + i * 2);
+    auto xx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0));
+    auto yy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 1, 1));
+    auto r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, ab), _mm_mul_ps(yy, cd)), t);
+    _mm_storeu_ps(dst + i * 2, r);
+  }
+#elif defined(ALIEN_MATH_NEON)
+  // Four points per iteration, deinterleaved by the load
+  for (; i + 4 <= count; i += 4) {
+    auto v = vld2q_f32(src + i * 2);
+    float32x4x2_t r;
+    r.val[0] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m.tx), v.val[0], m.a),
+                           v.val[1], m.c);
+    r.val[1] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m.ty), v.val[0], m.b),
+                           v.val[1], m.d);
+    vst2q_f32(dst + i * 2, r);
+  }
+#endif
+  for (; i < count; ++i) out[i] = m.transform_point(in[i]);
+}
+
+inline void transform_points_baseline(const Mat3x2 &m, const f32 *xs,
+                                      const f32 *ys, f32 *outX, f32 *outY,
+                                      std::size_t count) {
+  std::size_t i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  auto a = _mm_set1_ps(m.a), b = _mm_set1_ps(m.b);
+  auto c = _mm_set1_ps(m.c), d = _mm_set1_ps(m.d);
+  auto tx = _mm_set1_ps(m.tx), ty = _mm_set1_ps(m.ty);
+  for (; i + 4 <= count; i += 4) {
+    auto x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i);
+    auto rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(c, y)), tx);
+    auto ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(d, y)), ty);
+    _mm_storeu_ps(outX + i, rx);
+    _mm_storeu_ps(outY + i, ry);
+  }
+#elif defined(ALIEN_MATH_NEON)
+  for (; i + 4 <= count; i += 4) {
+    auto x = vld1q_f32(xs + i), y = vld1q_f32(ys + i);
+    auto rx = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m.tx), x, m.a), y, m.c);
+    auto ry = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m.ty), x, m.b), y, m.d);
+    vst1q_f32(outX + i, rx);
+    vst1q_f32(outY + i, ry);
+  }
+#endif
+  for (; i < count; ++i) {
+    auto x = xs[i], y = ys[i];
+    outX[i] = m.a * x + m.c * y + m.tx;
+    outY[i] = m.b * x + m.d * y + m.ty;
+  }
+}
+
+inline Vec4 bounds_baseline(const Vec2 *points, std::size_t count) {
+  std::size_t i = 0;
+  auto minX = points[0].x, minY = points[0].y;
+  auto maxX = minX, maxY = minY;
+#if defined(ALIEN_MATH_SSE2)
+  auto src = (const f32 *)points;
+  auto lo = _mm_setr_ps(minX, minY, minX, minY);
+  auto hi = lo;
+  for (; i + 2 <= count; i += 2) {
+    auto v = _mm_loadu_ps(src + i * 2);
+    lo = _mm_min_ps(lo, v);
+    hi = _mm_max_ps(hi, v);
+  }
+  alignas(16) f32 l[4], h[4];
+  _mm_store_ps(l, lo);
+  _mm_store_ps(h, hi);
+  minX = std::fmin(l[0], l[2]);
+  minY = std::fmin(l[1], l[3]);
+  maxX = std::fmax(h[0], h[2]);
+  maxY = std::fmax(h[1], h[3]);
+#endif
+  for (; i < count; ++i) {
+    minX = std::fmin(minX, points[i].x);
+    minY = std::fmin(minY, points[i].y);
+    maxX = std::fmax(maxX, points[i].x);
+    maxY = std::fmax(maxY, points[i].y);
+  }
+  return Vec4(minX, minY, maxX, maxY);
+}
+
+#if defined(ALIEN_CPU_X86)
+// Four interleaved points per iteration
+ALIEN_TARGET_AVX2 inline void transform_points_avx2(const Mat3x2 &m,
+                                                    const Vec2 *in, Vec2 *out,
+                                                    std::size_t count) {
+  std::size_t i = 0;
+  auto src = (const f32 *)in;
+  auto dst = (f32 *)out;
+  auto ab = _mm256_setr_ps(m.a, m.b, m.a, m.b, m.a, m.b, m.a, m.b);
+  auto cd = _mm256_setr_ps(m.c, m.d, m.c, m.d, m.c, m.d, m.c, m.d);
+  auto t = _mm256_setr_ps(m.tx, m.ty, m.tx, m.ty, m.tx, m.ty, m.tx, m.ty);
+  for (; i + 4 <= count; i += 4) {
+    auto v = _mm256_loadu_ps(src + i * 2);
+    auto xx = _mm256_moveldup_ps(v);
+    auto yy = _mm256_movehdup_ps(v);
+    auto r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xx, ab),
+                                         _mm256_mul_ps(yy, cd)),
+                           t);
+    _mm256_storeu_ps(dst + i * 2, r);
+  }
+  for (; i < count; ++i) out[i] = m.transform_point(in[i]);
+}
 
-        struct Vector3 {
-            f32 x, y, z;
-        };
+ALIEN_TARGET_AVX2 inline void transform_points_avx2(const Mat3x2 &m,
+                                                    const f32 *xs,
+                                                    const f32 *ys, f32 *outX,
+                                                    f32 *outY,
+                                                    std::size_t count) {
+  std::size_t i = 0;
+  auto a = _mm256_set1_ps(m.a), b = _mm256_set1_ps(m.b);
+  auto c = _mm256_set1_ps(m.c), d = _mm256_set1_ps(m.d);
+  auto tx = _mm256_set1_ps(m.tx), ty = _mm256_set1_ps(m.ty);
+  for (; i + 8 <= count; i += 8) {
+    auto x = _mm256_loadu_ps(xs + i), y = _mm256_loadu_ps(ys + i);
+    auto rx = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(c, y)), tx);
+    auto ry = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(b, x), _mm256_mul_ps(d, y)), ty);
+    _mm256_storeu_ps(outX + i, rx);
+    _mm256_storeu_ps(outY + i, ry);
+  }
+  transform_points_baseline(m, xs + i, ys + i, outX + i, outY + i, count - i);
+}
+
+// Folds the min / max lanes (x, y pairs) and adds the remaining points.
+ALIEN_TARGET_AVX2 inline Vec4 bounds_finish(__m128 lo, __m128 hi,
+                                            const Vec2 *points, std::size_t i,
+                                            std::size_t count) {
+  lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+  hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+  alignas(16) f32 l[4], h[4];
+  _mm_store_ps(l, lo);
+  _mm_store_ps(h, hi);
+  auto minX = l[0], minY = l[1], maxX = h[0], maxY = h[1];
+  for (; i < count; ++i) {
+    minX = std::fmin(minX, points[i].x);
+    minY = std::fmin(minY, points[i].y);
+    maxX = std::fmax(maxX, points[i].x);
+    maxY = std::fmax(maxY, points[i].y);
+  }
+  return Vec4(minX, minY, maxX, maxY);
+}
+
+ALIEN_TARGET_AVX2 inline Vec4 bounds_avx2(const Vec2 *points,
+                                          std::size_t count) {
+  std::size_t i = 0;
+  auto src = (const f32 *)points;
+  // Every lane starts from the first point
+  auto lo = _mm256_castpd_ps(_mm256_broadcast_sd((const f64 *)src));
+  auto hi = lo;
+  for (; i + 4 <= count; i += 4) {
+    auto v = _mm256_loadu_ps(src + i * 2);
+    lo = _mm256_min_ps(lo, v);
+    hi = _mm256_max_ps(hi, v);
+  }
+  return bounds_finish(
+      _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1)),
+      _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1)),
+      points, i, count);
+}
 
-        struct Vector2 {
-            f32 x, y;
-        };
-    }
+// Eight interleaved points per iteration
+ALIEN_TARGET_AVX512 inline void transform_points_avx512(const Mat3x2 &m,
+                                                        const Vec2 *in,
+                                                        Vec2 *out,
+                                                        std::size_t count) {
+  std::size_t i = 0;
+  auto src = (const f32 *)in;
+  auto dst = (f32 *)out;
+  auto ab = _mm512_broadcast_f32x4(_mm_setr_ps(m.a, m.b, m.a, m.b));
+  auto cd = _mm512_broadcast_f32x4(_mm_setr_ps(m.c, m.d, m.c, m.d));
+  auto t = _mm512_broadcast_f32x4(_mm_setr_ps(m.tx, m.ty, m.tx, m.ty));
+  for (; i + 8 <= count; i += 8) {
+    auto v = _mm512_loadu_ps(src + i * 2);
+    auto xx = _mm512_moveldup_ps(v);
+    auto yy = _mm512_movehdup_ps(v);
+    auto r = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(xx, ab),
+                                         _mm512_mul_ps(yy, cd)),
+                           t);
+    _mm512_storeu_ps(dst + i * 2, r);
+  }
+  transform_points_avx2(m, in + i, out + i, count - i);
+}
 
-    namespace Primitive {
-        using namespace Math;
+ALIEN_TARGET_AVX512 inline void transform_points_avx512(
+    const Mat3x2 &m, const f32 *xs, const f32 *ys, f32 *outX, f32 *outY,
+    std::size_t count) {
+  std::size_t i = 0;
+  auto a = _mm512_set1_ps(m.a), b = _mm512_set1_ps(m.b);
+  auto c = _mm512_set1_ps(m.c), d = _mm512_set1_ps(m.d);
+  auto tx = _mm512_set1_ps(m.tx), ty = _mm512_set1_ps(m.ty);
+  for (; i + 16 <= count; i += 16) {
+    auto x = _mm512_loadu_ps(xs + i), y = _mm512_loadu_ps(ys + i);
+    auto rx = _mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(a, x), _mm512_mul_ps(c, y)), tx);
+    auto ry = _mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(b, x), _mm512_mul_ps(d, y)), ty);
+    _mm512_storeu_ps(outX + i, rx);
+    _mm512_storeu_ps(outY + i, ry);
+  }
+  transform_points_avx2(m, xs + i, ys + i, outX + i, outY + i, count - i);
+}
 
-        struct Vertex {
-            DirectX::XMFLOAT3 pos;
+ALIEN_TARGET_AVX512 inline Vec4 bounds_avx512(const Vec2 *points,
+                                              std::size_t count) {
+  std::size_t i = 0;
+  auto src = (const f32 *)points;
+  auto lo = _mm512_castpd_ps(
+      _mm512_broadcastsd_pd(_mm_load_sd((const f64 *)src)));
+  auto hi = lo;
+  for (; i + 8 <= count; i += 8) {
+    auto v = _mm512_loadu_ps(src + i * 2);
+    lo = _mm512_min_ps(lo, v);
+    hi = _mm512_max_ps(hi, v);
+  }
+  auto lo8 = _mm256_min_ps(_mm512_castps512_ps256(lo),
+                           _mm512_extractf32x8_ps(lo, 1));
+  auto hi8 = _mm256_max_ps(_mm512_castps512_ps256(hi),
+                           _mm512_extractf32x8_ps(hi, 1));
+  return bounds_finish(
+      _mm_min_ps(_mm256_castps256_ps128(lo8), _mm256_extractf128_ps(lo8, 1)),
+      _mm_max_ps(_mm256_castps256_ps128(hi8), _mm256_extractf128_ps(hi8, 1)),
+      points, i, count);
+}
+#endif
+}  // namespace Kernel
 
-            Vertex(float x, float y, float z): pos(x,y,z) {}
-            //Vector4 pos;
-            //Vector4 col;
-            //Vector2 texCoord;
-        };
-    }
+// out[i] = m * in[i], in and out can be the same array.
+inline void transform_points(const Mat3x2 &m, const Vec2 *in, Vec2 *out,
+                             std::size_t count) {
+  using Fn = void (*)(const Mat3x2 &, const Vec2 *, Vec2 *, std::size_t);
+  static const auto kernel =
+      Cpu::select<Fn>(ALIEN_CPU_VARIANTS(Kernel::transform_points));
+  kernel(m, in, out, count);
 }
 
-#ifndef _WIN32
-#ifndef ALIEN_HPP
-#define ALIEN_HPP
+// Structure of arrays version, xs/ys can alias outX/outY.
+inline void transform_points(const Mat3x2 &m, const f32 *xs, const f32 *ys,
+                             f32 *outX, f32 *outY, std::size_t count) {
+  using Fn = void (*)(const Mat3x2 &, const f32 *, const f32 *, f32 *, f32 *,
+                      std::size_t);
+  static const auto kernel =
+      Cpu::select<Fn>(ALIEN_CPU_VARIANTS(Kernel::transform_points));
+  kernel(m, xs, ys, outX, outY, count);
+}
+
+// out[i] = lhs[i] * rhs[i], e.g. parent world * local for many nodes.
+inline void multiply(const Mat3x2 *lhs, const Mat3x2 *rhs, Mat3x2 *out,
+                     std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) out[i] = lhs[i] * rhs[i];
+}
+
+// Axis aligned bounds of the points, min in xy and max in zw.
+inline Vec4 bounds(const Vec2 *points, std::size_t count) {
+  if (count == 0) return Vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
+  using Fn = Vec4 (*)(const Vec2 *, std::size_t);
+  static const auto kernel =
+      Cpu::select<Fn>(ALIEN_CPU_VARIANTS(Kernel::bounds));
+  return kernel(points, count);
+}
+
+using Vector2 = Vec2;
+using Vector4 = Vec4;
+}  // namespace Math
+
+namespace Primitive {
+using namespace Math;
+
+struct Vertex {
+  Vector3 pos;
+
+  Vertex(float x, float y, float z) : pos{x, y, z} {}
+  // Vector4 pos;
+  // Vector4 col;
+  // Vector2 texCoord;
+};
+
+// Packed vertex encodings, vertex upload is the limit of the batched path.
+// Pixel positions are 13.3 fixed point (+-4096 pixels with 1/8 pixel
+// steps), texture coordinates are unorm16 and colors RGBA8 with red in the
+// lowest byte.
+static constexpr f32 PositionScale = 8.0f;
+static constexpr f32 TexCoordScale = 65535.0f;
+
+inline i16 pack_position(f32 pixels) {
+  return (i16)std::lrint(std::fmin(std::fmax(pixels * PositionScale, -32768.0f),
+                                   32767.0f));
+}
+
+inline u16 pack_unorm16(f32 v) {
+  return (u16)std::lrint(
+      std::fmin(std::fmax(v * TexCoordScale, 0.0f), TexCoordScale));
+}
+
+inline u32 pack_rgba8(f32 r, f32 g, f32 b, f32 a) {
+  auto unorm8 = [](f32 v) {
+    return (u32)std::lrint(std::fmin(std::fmax(v, 0.0f), 1.0f) * 255.0f);
+  };
+  return unorm8(r) | unorm8(g) << 8 | unorm8(b) << 16 | unorm8(a) << 24;
+}
+
+// Interleaved 12-byte vertex, half of the former 6 floats. The position
+// is either 13.3 pixels or snorm16, depending on the attribute setup.
+struct PackedVertex {
+  i16 position[2];
+  u16 texCoord[2];
+  u32 color;
+};
+static_assert(sizeof(PackedVertex) == 12);
+}  // namespace Primitive
+
+template <>
+struct VertexLayout<Primitive::PackedVertex> {
+  using V = Primitive::PackedVertex;
+  static constexpr VertexAttribute attributes[] = {
+      ALIEN_VERTEX_ATTRIBUTE(V, position, "POS", e_Short2Norm),
+      ALIEN_VERTEX_ATTRIBUTE(V, texCoord, "TEXCOORD", e_UShort2Norm),
+      ALIEN_VERTEX_ATTRIBUTE(V, color, "COL", e_UByte4Norm)};
+};
+}  // namespace Alien
+
 #endif
-#endif
\ No newline at end of file
@@ -0,0 +1,515 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_MEMORY_HPP
+#define ALIEN_MEMORY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "base.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Memory tracking is compiled in only when ALIEN_MEMORY_TRACKING is defined.
+// Otherwise every tracking call is an empty inline function and Vector is a
+// plain std::vector.
+namespace Alien::Memory {
+// Subsystem which owns the allocation
+enum Tag { e_Renderer, e_Assets, e_Events, e_Game, e_TagCount };
+
+static constexpr const char *TagNames[e_TagCount] = {"renderer", "assets",
+                                                     "events", "game"};
+
+struct TagStats {
+  u64 currentBytes;
+  u64 peakBytes;
+  u64 totalAllocations;
+  // Allocations made during the last finished frame
+  u64 frameAllocations;
+  u64 frameBytes;
+  u64 peakFrameAllocations;
+  u64 peakFrameBytes;
+};
+
+// Estimated GPU memory of the objects created thru the graphics context
+struct GpuStats {
+  u64 bufferBytes;
+  u64 textureBytes;
+  u64 peakBufferBytes;
+  u64 peakTextureBytes;
+};
+
+#ifdef ALIEN_MEMORY_TRACKING
+namespace Detail {
+struct Counters {
+  std::atomic<u64> currentBytes{0};
+  std::atomic<u64> peakBytes{0};
+  std::atomic<u64> totalAllocations{0};
+  std::atomic<u64> frameAllocations{0};
+  std::atomic<u64> frameBytes{0};
+
+  // Written only by next_frame()
+  u64 lastFrameAllocations{0};
+  u64 lastFrameBytes{0};
+  u64 peakFrameAllocations{0};
+  u64 peakFrameBytes{0};
+};
+
+inline Counters TagCounters[e_TagCount];
+inline std::atomic<u64> GpuBufferBytes{0};
+inline std::atomic<u64> GpuTextureBytes{0};
+inline std::atomic<u64> GpuPeakBufferBytes{0};
+inline std::atomic<u64> GpuPeakTextureBytes{0};
+
+inline void update_peak(std::atomic<u64> &peak, u64 value) {
+  auto current = peak.load(std::memory_order_relaxed);
+  while (value > current &&
+         !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+}  // namespace Detail
+
+inline void track_alloc(Tag tag, u64 size) {
+  auto &counters = Detail::TagCounters[tag];
+  auto current =
+      counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  Detail::update_peak(counters.peakBytes, current);
+  counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  counters.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+  counters.frameBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+inline void track_free(Tag tag, u64 size) {
+  Detail::TagCounters[tag].currentBytes.fetch_sub(size,
+                                                  std::memory_order_relaxed);
+}
+
+// Deltas are signed, negative when an object is deleted.
+inline void track_gpu_buffer(i64 delta) {
+  auto current = Detail::GpuBufferBytes.fetch_add(
+                     (u64)delta, std::memory_order_relaxed) +
+                 (u64)delta;
+  Detail::update_peak(Detail::GpuPeakBufferBytes, current);
+}
+
+inline void track_gpu_texture(i64 delta) {
+  auto current = Detail::GpuTextureBytes.fetch_add(
+                     (u64)delta, std::memory_order_relaxed) +
+                 (u64)delta;
+  Detail::update_peak(Detail::GpuPeakTextureBytes, current);
+}
+
+// Close the per-frame counters, called once per frame by the renderer.
+inline void next_frame() {
+  for (auto &counters : Detail::TagCounters) {
+    counters.lastFrameAllocations =
+        counters.frameAllocations.exchange(0, std::memory_order_relaxed);
+    counters.lastFrameBytes =
+        counters.frameBytes.exchange(0, std::memory_order_relaxed);
+    counters.peakFrameAllocations =
+        std::max(counters.peakFrameAllocations, counters.lastFrameAllocations);
+    counters.peakFrameBytes =
+        std::max(counters.peakFrameBytes, counters.lastFrameBytes);
+  }
+}
+
+inline TagStats stats(Tag tag) {
+  const auto &counters = Detail::TagCounters[tag];
+  return TagStats{counters.currentBytes.load(std::memory_order_relaxed),
+                  counters.peakBytes.load(std::memory_order_relaxed),
+                  counters.totalAllocations.load(std::memory_order_relaxed),
+                  counters.lastFrameAllocations,
+                  counters.lastFrameBytes,
+                  counters.peakFrameAllocations,
+                  counters.peakFrameBytes};
+}
+
+inline GpuStats gpu_stats() {
+  return GpuStats{Detail::GpuBufferBytes.load(std::memory_order_relaxed),
+                  Detail::GpuTextureBytes.load(std::memory_order_relaxed),
+                  Detail::GpuPeakBufferBytes.load(std::memory_order_relaxed),
+                  Detail::GpuPeakTextureBytes.load(std::memory_order_relaxed)};
+}
+
+static constexpr bool IsTrackingEnabled = true;
+#else
+inline void track_alloc(Tag, u64) {}
+inline void track_free(Tag, u64) {}
+inline void track_gpu_buffer(i64) {}
+inline void track_gpu_texture(i64) {}
+inline void next_frame() {}
+inline TagStats stats(Tag) { return {}; }
+inline GpuStats gpu_stats() { return {}; }
+
+static constexpr bool IsTrackingEnabled = false;
+#endif
+
+// Write every counter as one JSON object.
+inline void dump_json(std::ostream &out) {
+  out << "{\"enabled\":" << (IsTrackingEnabled ? "true" : "false")
+      << ",\"tags\":{";
+  for (u32 i = 0; i < e_TagCount; ++i) {
+    auto s = stats((Tag)i);
+    out << (i ? "," : "") << "\"" << TagNames[i] << "\":{"
+        << "\"currentBytes\":" << s.currentBytes
+        << ",\"peakBytes\":" << s.peakBytes
+        << ",\"totalAllocations\":" << s.totalAllocations
+        << ",\"frameAllocations\":" << s.frameAllocations
+        << ",\"frameBytes\":" << s.frameBytes
+        << ",\"peakFrameAllocations\":" << s.peakFrameAllocations
+        << ",\"peakFrameBytes\":" << s.peakFrameBytes << "}";
+  }
+
+  auto gpu = gpu_stats();
+  out << "},\"gpu\":{\"bufferBytes\":" << gpu.bufferBytes
+      << ",\"textureBytes\":" << gpu.textureBytes
+      << ",\"peakBufferBytes\":" << gpu.peakBufferBytes
+      << ",\"peakTextureBytes\":" << gpu.peakTextureBytes << "}}";
+}
+
+// STL allocator which accounts every allocation to the given tag.
+template <typename T, Tag tag>
+struct TaggedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = TaggedAllocator<U, tag>;
+  };
+
+  TaggedAllocator() = default;
+
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U, tag> &) {}
+
+  T *allocate(std::size_t n) {
+    track_alloc(tag, n * sizeof(T));
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *ptr, std::size_t n) {
+    track_free(tag, n * sizeof(T));
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template <typename U>
+  bool operator==(const TaggedAllocator<U, tag> &) const {
+    return true;
+  }
+};
+
+#ifdef ALIEN_MEMORY_TRACKING
+template <typename T, Tag tag>
+using Vector = std::vector<T, TaggedAllocator<T, tag>>;
+#else
+template <typename T, Tag>
+using Vector = std::vector<T>;
+#endif
+
+// Page backing of the virtual arena.
+enum PageMode {
+  // Regular pages
+  e_SmallPages,
+  // Regular pages with transparent huge pages requested (Linux)
+  e_TransparentHugePages,
+  // Huge pages from the hugetlb pool (Linux), falls back to transparent
+  // huge pages when the pool is empty
+  e_ExplicitHugePages
+};
+
+// Linear allocator over one big virtual address reservation. Pages are
+// committed on demand while the arena grows, so nothing is ever moved and
+// the address space stays unfragmented. Committed memory is accounted to
+// the tag of the arena.
+class VirtualArena {
+ public:
+  static constexpr u64 HugePageSize = 2ull << 20;
+
+  VirtualArena() = default;
+
+  explicit VirtualArena(u64 reserveBytes, Tag tag = e_Assets,
+                        PageMode mode = e_TransparentHugePages)
+      : m_Tag(tag) {
+    reserve(reserveBytes, mode);
+  }
+
+  ~VirtualArena() { release(); }
+
+  VirtualArena(const VirtualArena &) = delete;
+  VirtualArena &operator=(const VirtualArena &) = delete;
+
+  VirtualArena(VirtualArena &&other) noexcept { *this = std::move(other); }
+
+  VirtualArena &operator=(VirtualArena &&other) noexcept {
+    if (this != &other) {
+      release();
+      m_Base = std::exchange(other.m_Base, nullptr);
+      m_Reserved = std::exchange(other.m_Reserved, 0);
+      m_Committed = std::exchange(other.m_Committed, 0);
+      m_Used = std::exchange(other.m_Used, 0);
+      m_CommitGranularity = other.m_CommitGranularity;
+      m_Mapping = std::exchange(other.m_Mapping, nullptr);
+      m_MappingSize = std::exchange(other.m_MappingSize, 0);
+      m_IsHugeTLB = other.m_IsHugeTLB;
+      m_Tag = other.m_Tag;
+    }
+    return *this;
+  }
+
+  // Returns nullptr when the reservation is exhausted.
+  void *allocate(u64 size, u64 alignment = 16) {
+    assert((alignment & (alignment - 1)) == 0 &&
+           "Alignment must be power of two!");
+    auto offset = (m_Used + alignment - 1) & ~(alignment - 1);
+    if (!ensure_committed(offset + size)) return nullptr;
+
+    m_Used = offset + size;
+    return m_Base + offset;
+  }
+
+  // Extend the last allocation in place, nothing is copied.
+  bool grow(void *ptr, u64 oldSize, u64 newSize) {
+    auto offset = (u64)((u8 *)ptr - m_Base);
+    if (offset + oldSize != m_Used) return false;
+    if (!ensure_committed(offset + newSize)) return false;
+
+    m_Used = offset + newSize;
+    return true;
+  }
+
+  // Forget every allocation, optionally giving the pages back to the OS.
+  void reset(bool decommit = false) {
+    m_Used = 0;
+    if (decommit) decommit_from(0);
+  }
+
+  // Give back the pages after the used part.
+  void trim() {
+    auto keep = (m_Used + m_CommitGranularity - 1) & ~(m_CommitGranularity - 1);
+    decommit_from(keep);
+  }
+
+  u8 *data() const { return m_Base; }
+  u64 used() const { return m_Used; }
+  u64 committed() const { return m_Committed; }
+  u64 reserved() const { return m_Reserved; }
+  bool is_huge_tlb() const { return m_IsHugeTLB; }
+
+ private:
+  void reserve(u64 size, PageMode mode) {
+    auto pageSize = system_page_size();
+    m_CommitGranularity = mode == e_SmallPages ? pageSize : HugePageSize;
+    size = (size + m_CommitGranularity - 1) & ~(m_CommitGranularity - 1);
+
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege and can not be committed
+    // lazily, regular pages are used on Windows.
+    m_Mapping = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    m_MappingSize = size;
+    m_Base = (u8 *)m_Mapping;
+#else
+#ifdef MAP_HUGETLB
+    if (mode == e_ExplicitHugePages) {
+      // Without MAP_NORESERVE the pages are reserved from the hugetlb pool
+      // up front, so this fails here instead of raising SIGBUS on first
+      // touch when the pool is too small.
+      auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        m_Mapping = ptr;
+        m_MappingSize = size;
+        m_Base = (u8 *)ptr;
+        m_Reserved = size;
+        m_IsHugeTLB = true;
+        return;
+      }
+    }
+#endif
+    // Over-reserve to align the base to the huge page size, otherwise the
+    // kernel can not back the first and the last page with huge pages.
+    auto mappingSize = size + (mode == e_SmallPages ? 0 : HugePageSize);
+    auto ptr = mmap(nullptr, mappingSize, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) return;
+
+    m_Mapping = ptr;
+    m_MappingSize = mappingSize;
+    auto address = ((uintptr_t)ptr + m_CommitGranularity - 1) &
+                   ~(uintptr_t)(m_CommitGranularity - 1);
+    m_Base = (u8 *)address;
+
+#ifdef MADV_HUGEPAGE
+    if (mode != e_SmallPages) madvise(m_Base, size, MADV_HUGEPAGE);
+#endif
+#endif
+
+    if (m_Base) m_Reserved = size;
+  }
+
+  void release() {
+    if (!m_Mapping) return;
+
+    track_free(m_Tag, m_Committed);
+#ifdef _WIN32
+    VirtualFree(m_Mapping, 0, MEM_RELEASE);
+#else
+    munmap(m_Mapping, m_MappingSize);
+#endif
+    m_Mapping = nullptr;
+    m_Base = nullptr;
+    m_Reserved = m_Committed = m_Used = 0;
+  }
+
+  bool ensure_committed(u64 size) {
+    if (size <= m_Committed) return true;
+    if (size > m_Reserved) return false;
+
+    auto target = (size + m_CommitGranularity - 1) & ~(m_CommitGranularity - 1);
+    target = std::min(target, m_Reserved);
+
+    if (!m_IsHugeTLB) {
+#ifdef _WIN32
+      if (!VirtualAlloc(m_Base + m_Committed, target - m_Committed, MEM_COMMIT,
+                        PAGE_READWRITE))
+        return false;
+#else
+      if (mprotect(m_Base + m_Committed, target - m_Committed,
+                   PROT_READ | PROT_WRITE) != 0)
+        return false;
+#endif
+    }
+
+    track_alloc(m_Tag, target - m_Committed);
+    m_Committed = target;
+    return true;
+  }
+
+  void decommit_from(u64 offset) {
+    if (offset >= m_Committed) return;
+
+    auto size = m_Committed - offset;
+#ifdef _WIN32
+    VirtualFree(m_Base + offset, size, MEM_DECOMMIT);
+#else
+    madvise(m_Base + offset, size, MADV_DONTNEED);
+    if (!m_IsHugeTLB) mprotect(m_Base + offset, size, PROT_NONE);
+#endif
+    track_free(m_Tag, size);
+    m_Committed = offset;
+  }
+
+  static u64 system_page_size() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (u64)sysconf(_SC_PAGESIZE);
+#endif
+  }
+
+  u8 *m_Base{nullptr};
+  u64 m_Reserved{0};
+  u64 m_Committed{0};
+  u64 m_Used{0};
+  u64 m_CommitGranularity{4096};
+
+  // Whole mapping, might be larger than the aligned reservation
+  void *m_Mapping{nullptr};
+  u64 m_MappingSize{0};
+
+  bool m_IsHugeTLB{false};
+  Tag m_Tag{e_Assets};
+};
+
+// Growable array inside its own virtual reservation. Growing commits more
+// pages after the last element so the elements never move, pointers into
+// the array stay valid until it shrinks.
+template <typename T>
+class VirtualArray {
+ public:
+  explicit VirtualArray(u64 maxCount, Tag tag = e_Assets,
+                        PageMode mode = e_TransparentHugePages)
+      : m_Arena(maxCount * sizeof(T), tag, mode) {}
+
+  ~VirtualArray() { clear(); }
+
+  VirtualArray(const VirtualArray &) = delete;
+  VirtualArray &operator=(const VirtualArray &) = delete;
+
+  T &push_back(const T &value) { return emplace_back(value); }
+
+  template <typename... Args>
+  T &emplace_back(Args &&...args) {
+    auto ptr = (T *)m_Arena.allocate(sizeof(T), alignof(T));
+    assert(ptr && "Virtual array reservation is exhausted!");
+    ++m_Size;
+    return *new (ptr) T(std::forward<Args>(args)...);
+  }
+
+  // Append count default constructed elements, returns the first one.
+  T *grow_by(u64 count) {
+    auto ptr = (T *)m_Arena.allocate(sizeof(T) * count, alignof(T));
+    assert(ptr && "Virtual array reservation is exhausted!");
+    for (u64 i = 0; i < count; ++i) new (ptr + i) T();
+    m_Size += count;
+    return ptr;
+  }
+
+  void clear(bool decommit = false) {
+    for (u64 i = 0; i < m_Size; ++i) data()[i].~T();
+    m_Size = 0;
+    m_Arena.reset(decommit);
+  }
+
+  T *data() const { return (T *)m_Arena.data(); }
+  u64 size() const { return m_Size; }
+  u64 capacity() const { return m_Arena.reserved() / sizeof(T); }
+
+  T &operator[](u64 i) { return data()[i]; }
+  const T &operator[](u64 i) const { return data()[i]; }
+
+  T *begin() { return data(); }
+  T *end() { return data() + m_Size; }
+
+ private:
+  VirtualArena m_Arena;
+  u64 m_Size{0};
+};
+}  // namespace Alien::Memory
+
+#endif
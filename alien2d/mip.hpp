@@ -0,0 +1,415 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_MIP_HPP
+#define ALIEN_MIP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "base.hpp"
+#include "cpu.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+
+// Mipmap chains made on the CPU, so they are built on workers at import or
+// while streaming instead of by glGenerateMipmap on the thread which owns
+// the context. Filtering runs in linear light on premultiplied alpha: texels
+// are taken out of sRGB and multiplied by their alpha first, so levels do
+// not darken and transparent texels do not bleed their color into the
+// edges. Levels are stored like the base level, sRGB RGBA8 with straight
+// alpha, and upload as they are.
+//
+// A chain is every level back to back, largest first, rows without
+// padding. Each level halves the one above, rounding down.
+namespace Alien::Mip {
+enum Filter {
+  // 2x2 average, the fastest
+  e_Box,
+  // Kaiser windowed sinc over 6x6 texels, keeps small sprites sharper.
+  // Its overshoot is clamped.
+  e_Kaiser
+};
+
+// Levels down to 1x1.
+inline u32 level_count(u32 width, u32 height) {
+  u32 levels = 1;
+  for (auto size = std::max(width, height); size > 1; size >>= 1) ++levels;
+  return levels;
+}
+
+inline u32 level_size(u32 size, u32 level) {
+  return std::max(size >> level, 1u);
+}
+
+// Bytes of the levels before the given one, or of a chain with that many
+// levels.
+inline u64 level_offset(u32 width, u32 height, u32 level) {
+  u64 offset = 0;
+  for (u32 i = 0; i < level; ++i)
+    offset += (u64)level_size(width, i) * level_size(height, i) * 4;
+  return offset;
+}
+
+namespace Detail {
+// Steps of the linear to sRGB table
+static constexpr u32 LinearSteps = 16383;
+
+// Taps of one dimension: source texel 2x + first + k has weights[k].
+struct Taps {
+  u32 count;
+  i32 first;
+  f32 weights[6];
+};
+
+struct Tables {
+  // sRGB bytes to linear, then alpha bytes to [0, 1]
+  f32 toLinear[512];
+  u8 toSrgb[LinearSteps + 1];
+  Taps box;
+  Taps kaiser;
+};
+
+inline f64 bessel_i0(f64 x) {
+  f64 sum = 1.0, term = 1.0;
+  for (u32 k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+inline const Tables &tables() {
+  static const Tables t = [] {
+    Tables t;
+    for (u32 i = 0; i < 256; ++i) {
+      auto c = i / 255.0;
+      t.toLinear[i] = (f32)(c <= 0.04045 ? c / 12.92
+                                         : std::pow((c + 0.055) / 1.055, 2.4));
+      t.toLinear[256 + i] = (f32)c;
+    }
+    for (u32 i = 0; i <= LinearSteps; ++i) {
+      auto c = (f64)i / LinearSteps;
+      auto s = c <= 0.0031308 ? c * 12.92
+                              : 1.055 * std::pow(c, 1 / 2.4) - 0.055;
+      t.toSrgb[i] = (u8)(s * 255.0 + 0.5);
+    }
+
+    t.box = {2, 0, {0.5f, 0.5f}};
+    // Texel centers are 0.25, 0.75 and 1.25 texels of the smaller level
+    // away, the window reaches 1.5
+    constexpr f64 Beta = 4.0, Radius = 1.5, Pi = 3.14159265358979323846;
+    t.kaiser = {6, -2, {}};
+    f64 weights[6], total = 0;
+    for (u32 k = 0; k < 6; ++k) {
+      auto x = ((f64)k - 2.5) / 2.0;
+      auto r = x / Radius;
+      weights[k] = std::sin(Pi * x) / (Pi * x) *
+                   bessel_i0(Beta * std::sqrt(1.0 - r * r)) / bessel_i0(Beta);
+      total += weights[k];
+    }
+    for (u32 k = 0; k < 6; ++k) t.kaiser.weights[k] = (f32)(weights[k] / total);
+    return t;
+  }();
+  return t;
+}
+}  // namespace Detail
+
+namespace Kernel {
+// Linear premultiplied RGBA of count texels.
+inline void linearize_row_baseline(const u8 *src, u32 count, f32 *out) {
+  auto lut = Detail::tables().toLinear;
+  for (u32 i = 0; i < count; ++i, src += 4, out += 4) {
+    auto a = lut[256 + src[3]];
+    out[0] = lut[src[0]] * a;
+    out[1] = lut[src[1]] * a;
+    out[2] = lut[src[2]] * a;
+    out[3] = a;
+  }
+}
+
+// One texel of a row filtered to half its width, with the taps clamped to
+// the row.
+inline void filter_texel(const f32 *src, u32 width, u32 x,
+                         const Detail::Taps &taps, f32 *out) {
+  f32 sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (u32 k = 0; k < taps.count; ++k) {
+    auto i = std::clamp<i64>((i64)x * 2 + taps.first + k, 0, (i64)width - 1);
+    for (u32 c = 0; c < 4; ++c) sum[c] += taps.weights[k] * src[i * 4 + c];
+  }
+  std::memcpy(out, sum, sizeof(sum));
+}
+
+// Texels whose taps are all inside the row are [begin, end).
+inline void inner_texels(u32 width, u32 outWidth, const Detail::Taps &taps,
+                         u32 &begin, u32 &end) {
+  begin = (u32)std::max<i64>(0, (-taps.first + 1) / 2);
+  auto span = (i64)width - taps.first - (i64)taps.count;
+  end = span < 0 ? begin : (u32)std::clamp<i64>(span / 2 + 1, begin, outWidth);
+  begin = std::min(begin, end);
+}
+
+inline void filter_row_baseline(const f32 *src, u32 width, f32 *out,
+                                u32 outWidth, const Detail::Taps &taps) {
+  u32 begin, end;
+  inner_texels(width, outWidth, taps, begin, end);
+  for (u32 x = 0; x < begin; ++x)
+    filter_texel(src, width, x, taps, out + x * 4);
+#if defined(ALIEN_MATH_SSE2)
+  __m128 weights[6];
+  for (u32 k = 0; k < taps.count; ++k)
+    weights[k] = _mm_set1_ps(taps.weights[k]);
+  for (auto x = begin; x < end; ++x) {
+    auto in = src + ((i64)x * 2 + taps.first) * 4;
+    auto sum = _mm_mul_ps(weights[0], _mm_loadu_ps(in));
+    for (u32 k = 1; k < taps.count; ++k)
+      sum = _mm_add_ps(sum, _mm_mul_ps(weights[k], _mm_loadu_ps(in + k * 4)));
+    _mm_storeu_ps(out + x * 4, sum);
+  }
+#else
+  for (auto x = begin; x < end; ++x)
+    filter_texel(src, width, x, taps, out + x * 4);
+#endif
+  for (auto x = end; x < outWidth; ++x)
+    filter_texel(src, width, x, taps, out + x * 4);
+}
+
+// out = sum of rows[k] * weights[k] over count floats.
+inline void blend_rows_baseline(const f32 *const *rows, const f32 *weights,
+                                u32 rowCount, u32 count, f32 *out) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    auto sum = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(rows[0] + i));
+    for (u32 k = 1; k < rowCount; ++k)
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]),
+                                       _mm_loadu_ps(rows[k] + i)));
+    _mm_storeu_ps(out + i, sum);
+  }
+#endif
+  for (; i < count; ++i) {
+    auto sum = weights[0] * rows[0][i];
+    for (u32 k = 1; k < rowCount; ++k) sum += weights[k] * rows[k][i];
+    out[i] = sum;
+  }
+}
+
+// Back to sRGB bytes with straight alpha.
+inline void store_texel(const f32 *in, u8 *out) {
+  auto &t = Detail::tables();
+  auto a = std::clamp(in[3], 0.0f, 1.0f);
+  for (u32 c = 0; c < 3; ++c) {
+    auto v = a > 0.0f ? std::clamp(in[c] / a, 0.0f, 1.0f) : 0.0f;
+    out[c] = t.toSrgb[(u32)std::nearbyint(v * Detail::LinearSteps)];
+  }
+  out[3] = (u8)std::nearbyint(a * 255.0f);
+}
+
+inline void store_row_baseline(const f32 *in, u32 count, u8 *out) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  auto &t = Detail::tables();
+  auto zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  auto alpha = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+  auto steps = (f32)Detail::LinearSteps;
+  auto scale = _mm_setr_ps(steps, steps, steps, 255.0f);
+  alignas(16) i32 index[4];
+  for (; i < count; ++i) {
+    auto v = _mm_loadu_ps(in + i * 4);
+    auto a = _mm_min_ps(_mm_max_ps(_mm_shuffle_ps(v, v, 0xFF), zero), one);
+    auto c = _mm_and_ps(_mm_div_ps(v, a), _mm_cmpgt_ps(a, zero));
+    c = _mm_min_ps(_mm_max_ps(c, zero), one);
+    c = _mm_or_ps(_mm_andnot_ps(alpha, c), _mm_and_ps(alpha, a));
+    _mm_store_si128((__m128i *)index, _mm_cvtps_epi32(_mm_mul_ps(c, scale)));
+    auto texel = out + i * 4;
+    for (u32 k = 0; k < 3; ++k) texel[k] = t.toSrgb[index[k]];
+    texel[3] = (u8)index[3];
+  }
+#endif
+  for (; i < count; ++i) store_texel(in + i * 4, out + i * 4);
+}
+
+#if defined(ALIEN_CPU_X86)
+// Two texels per iteration, the table lookups are gathers
+ALIEN_TARGET_AVX2 inline void linearize_row_avx2(const u8 *src, u32 count,
+                                                 f32 *out) {
+  auto lut = Detail::tables().toLinear;
+  auto alphaRows = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+  u32 i = 0;
+  for (; i + 2 <= count; i += 2) {
+    auto bytes = _mm_loadl_epi64((const __m128i *)(src + i * 4));
+    auto index = _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alphaRows);
+    auto v = _mm256_i32gather_ps(lut, index, 4);
+    auto a = _mm256_permute_ps(v, 0xFF);
+    _mm256_storeu_ps(out + i * 4,
+                     _mm256_blend_ps(_mm256_mul_ps(v, a), v, 0x88));
+  }
+  linearize_row_baseline(src + i * 4, count - i, out + i * 4);
+}
+
+ALIEN_TARGET_AVX2 inline void filter_row_avx2(const f32 *src, u32 width,
+                                              f32 *out, u32 outWidth,
+                                              const Detail::Taps &taps) {
+  u32 begin, end;
+  inner_texels(width, outWidth, taps, begin, end);
+  for (u32 x = 0; x < begin; ++x)
+    filter_texel(src, width, x, taps, out + x * 4);
+  __m256 weights[6];
+  for (u32 k = 0; k < taps.count; ++k)
+    weights[k] = _mm256_set1_ps(taps.weights[k]);
+  auto x = begin;
+  for (; x + 2 <= end; x += 2) {
+    // The taps of the second texel start two texels later
+    auto in = src + ((i64)x * 2 + taps.first) * 4;
+    auto sum = _mm256_setzero_ps();
+    for (u32 k = 0; k < taps.count; ++k) {
+      auto v = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_loadu_ps(in + k * 4)),
+          _mm_loadu_ps(in + 8 + k * 4), 1);
+      sum = _mm256_fmadd_ps(weights[k], v, sum);
+    }
+    _mm256_storeu_ps(out + x * 4, sum);
+  }
+  for (; x < outWidth; ++x) filter_texel(src, width, x, taps, out + x * 4);
+}
+
+ALIEN_TARGET_AVX2 inline void blend_rows_avx2(const f32 *const *rows,
+                                              const f32 *weights,
+                                              u32 rowCount, u32 count,
+                                              f32 *out) {
+  u32 i = 0;
+  for (; i + 8 <= count; i += 8) {
+    auto sum = _mm256_mul_ps(_mm256_set1_ps(weights[0]),
+                             _mm256_loadu_ps(rows[0] + i));
+    for (u32 k = 1; k < rowCount; ++k)
+      sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]),
+                            _mm256_loadu_ps(rows[k] + i), sum);
+    _mm256_storeu_ps(out + i, sum);
+  }
+  for (; i < count; ++i) {
+    auto sum = weights[0] * rows[0][i];
+    for (u32 k = 1; k < rowCount; ++k) sum += weights[k] * rows[k][i];
+    out[i] = sum;
+  }
+}
+
+ALIEN_TARGET_AVX2 inline void store_row_avx2(const f32 *in, u32 count,
+                                             u8 *out) {
+  auto &t = Detail::tables();
+  auto zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  auto steps = (f32)Detail::LinearSteps;
+  auto scale =
+      _mm256_setr_ps(steps, steps, steps, 255.0f, steps, steps, steps, 255.0f);
+  alignas(32) i32 index[8];
+  u32 i = 0;
+  for (; i + 2 <= count; i += 2) {
+    auto v = _mm256_loadu_ps(in + i * 4);
+    auto a = _mm256_min_ps(_mm256_max_ps(_mm256_permute_ps(v, 0xFF), zero),
+                           one);
+    auto c = _mm256_and_ps(_mm256_div_ps(v, a),
+                           _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+    c = _mm256_blend_ps(_mm256_min_ps(_mm256_max_ps(c, zero), one), a, 0x88);
+    _mm256_store_si256((__m256i *)index,
+                       _mm256_cvtps_epi32(_mm256_mul_ps(c, scale)));
+    auto texel = out + i * 4;
+    for (u32 k = 0; k < 8; ++k)
+      texel[k] = (k & 3) == 3 ? (u8)index[k] : t.toSrgb[index[k]];
+  }
+  store_row_baseline(in + i * 4, count - i, out + i * 4);
+}
+#endif
+}  // namespace Kernel
+
+// Makes a level from the one above it, RGBA8 rows pitch apart. Rows of the
+// smaller level are made in parallel, every task keeps the filtered rows
+// it still needs, so each source row is converted and filtered about once.
+inline void downsample(const u8 *src, u32 width, u32 height, u32 pitch,
+                       u8 *dst, u32 dstPitch, Filter filter,
+                       JobSystem &jobs = JobSystem::instance()) {
+  using LinearizeFn = void (*)(const u8 *, u32, f32 *);
+  using FilterFn = void (*)(const f32 *, u32, f32 *, u32, const Detail::Taps &);
+  using BlendFn = void (*)(const f32 *const *, const f32 *, u32, u32, f32 *);
+  using StoreFn = void (*)(const f32 *, u32, u8 *);
+  static const auto linearize_row =
+      Cpu::select<LinearizeFn>(ALIEN_CPU_VARIANTS_AVX2(Kernel::linearize_row));
+  static const auto filter_row =
+      Cpu::select<FilterFn>(ALIEN_CPU_VARIANTS_AVX2(Kernel::filter_row));
+  static const auto blend_rows =
+      Cpu::select<BlendFn>(ALIEN_CPU_VARIANTS_AVX2(Kernel::blend_rows));
+  static const auto store_row =
+      Cpu::select<StoreFn>(ALIEN_CPU_VARIANTS_AVX2(Kernel::store_row));
+
+  auto &taps = filter == e_Kaiser ? Detail::tables().kaiser
+                                  : Detail::tables().box;
+  auto outWidth = level_size(width, 1), outHeight = level_size(height, 1);
+  auto rowFloats = outWidth * 4;
+  jobs.parallel_for(outHeight, std::max(8u, 65536 / outWidth),
+                    [&](u32 begin, u32 end) {
+    // Filtered source row y sits in slot y % taps.count
+    Memory::Vector<f32, Memory::e_Assets> line((u64)std::max(width, 2u) * 4);
+    Memory::Vector<f32, Memory::e_Assets> filtered((u64)taps.count *
+                                                   rowFloats);
+    i64 held[6] = {-1, -1, -1, -1, -1, -1};
+    const f32 *rows[6];
+    for (auto y = begin; y < end; ++y) {
+      for (u32 k = 0; k < taps.count; ++k) {
+        auto sy = std::clamp<i64>((i64)y * 2 + taps.first + k, 0,
+                                  (i64)height - 1);
+        auto slot = (u32)(sy % taps.count);
+        auto row = filtered.data() + (u64)slot * rowFloats;
+        if (held[slot] != sy) {
+          linearize_row(src + (u64)sy * pitch, width, line.data());
+          filter_row(line.data(), width, row, outWidth, taps);
+          held[slot] = sy;
+        }
+        rows[k] = row;
+      }
+      blend_rows(rows, taps.weights, taps.count, rowFloats, line.data());
+      store_row(line.data(), outWidth, dst + (u64)y * dstPitch);
+    }
+  });
+}
+
+// Fills the levels after the first of a chain of the given length, level
+// 0 has to be in place.
+inline void generate(u8 *chain, u32 width, u32 height, u32 levels,
+                     Filter filter, JobSystem &jobs = JobSystem::instance()) {
+  auto level = chain;
+  for (u32 i = 1; i < levels; ++i) {
+    auto next = level + (u64)width * height * 4;
+    auto outWidth = level_size(width, 1);
+    downsample(level, width, height, width * 4, next, outWidth * 4, filter,
+               jobs);
+    level = next;
+    width = outWidth;
+    height = level_size(height, 1);
+  }
+}
+}  // namespace Alien::Mip
+
+#endif
@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_MPSC_QUEUE_HPP
+#define ALIEN_MPSC_QUEUE_HPP
+
+#include <atomic>
+
+#include "base.hpp"
+
+namespace Alien {
+// Lock-free multi producer / single consumer queue (intrusive linked list
+// with a dummy node). Producers only do one atomic exchange so they never
+// wait for each other or for the consumer. A producer which got preempted
+// between the exchange and the link makes the queue look empty to the
+// consumer until it continues, the item is picked up on the next pop.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() {
+    auto stub = new Node();
+    m_Head.store(stub, std::memory_order_relaxed);
+    m_Tail = stub;
+  }
+
+  ~MpscQueue() {
+    T value;
+    while (try_pop(value)) {
+    }
+    delete m_Tail;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Can be called from any thread.
+  void push(T value) {
+    auto node = new Node();
+    node->value = std::move(value);
+
+    auto prev = m_Head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Must be called only from the consumer thread.
+  bool try_pop(T &value) {
+    auto tail = m_Tail;
+    auto next = tail->next.load(std::memory_order_acquire);
+    if (!next) return false;
+
+    // The next node becomes the new dummy once its value is moved out.
+    value = std::move(next->value);
+    m_Tail = next;
+    delete tail;
+
+    return true;
+  }
+
+  // Pop everything which is visible right now and call f for each of them.
+  template <typename F>
+  u32 drain(F &&f) {
+    u32 count = 0;
+    T value;
+    while (try_pop(value)) {
+      f(value);
+      ++count;
+    }
+    return count;
+  }
+
+  bool empty() const {
+    return m_Tail->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value{};
+  };
+
+  alignas(64) std::atomic<Node *> m_Head;
+  alignas(64) Node *m_Tail;
+};
+}  // namespace Alien
+
+#endif
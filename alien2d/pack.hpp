@@ -0,0 +1,497 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_PACK_HPP
+#define ALIEN_PACK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "base.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "image.hpp"
+#include "jobs.hpp"
+#include "lz4.hpp"
+#include "memory.hpp"
+
+// Asset pack (.pak), many assets in one file which is mapped into memory,
+// so an asset is a view into the mapping: no copies and no system call per
+// asset. Little endian:
+//
+//   "APK1" | entry count | names size | chunk size     u32 each
+//   hashes[entry count]                               u64 name hashes, sorted
+//   entries[entry count]                              in the order of hashes
+//   names                                             not terminated
+//   data                                              every entry 4K aligned
+//
+// An entry is u64 offset | u64 size | u64 stored size | u32 name offset |
+// u32 name size | u32 format, the offset from the start of the file and
+// the name offset from the names. The format is a TextureFormat for
+// textures and e_UnknownFormat for anything else. Entries stored smaller
+// than their size are compressed: split in chunks of chunk size, each one
+// LZ4 block, after a table of the u32 stored chunk sizes. Chunks stored at
+// full size did not compress and are kept as they are.
+namespace Alien {
+// Read only mapping of a whole file. Pages are read in on first touch.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : m_Data(std::exchange(other.m_Data, nullptr)),
+        m_Size(std::exchange(other.m_Size, 0)) {}
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      m_Data = std::exchange(other.m_Data, nullptr);
+      m_Size = std::exchange(other.m_Size, 0);
+    }
+    return *this;
+  }
+
+  // Empty files fail, there is nothing to map.
+  bool open(const char *path) {
+    close();
+#ifdef _WIN32
+    auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+                                   nullptr);
+    // The view keeps the mapping and the file alive
+    if (mapping) {
+      m_Data = (const u8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    if (!m_Data) return false;
+    m_Size = (u64)size.QuadPart;
+#else
+    auto file = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0) return false;
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+      data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file,
+                  0);
+    ::close(file);
+    if (data == MAP_FAILED) return false;
+    m_Data = (const u8 *)data;
+    m_Size = (u64)info.st_size;
+#endif
+    return true;
+  }
+
+  void close() {
+    if (!m_Data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_Data);
+#else
+    munmap((void *)m_Data, m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+  }
+
+  bool is_open() const { return m_Data != nullptr; }
+  const u8 *data() const { return m_Data; }
+  u64 size() const { return m_Size; }
+  std::span<const u8> view() const { return {m_Data, (size_t)m_Size}; }
+
+ private:
+  const u8 *m_Data{nullptr};
+  u64 m_Size{0};
+};
+
+namespace Pack {
+// Entry data starts on a page, so views are page aligned too
+static constexpr u64 Alignment = 4096;
+// Chunks are decompressed on their own, in parallel
+static constexpr u32 ChunkSize = Lz4::MaxBlockSize;
+
+// FNV-1a of the name as stored, paths use '/'.
+inline u64 hash_name(std::string_view name) {
+  u64 hash = 0xCBF29CE484222325ull;
+  for (auto c : name) {
+    hash ^= (u8)c;
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+namespace Detail {
+static constexpr u8 Magic[4] = {'A', 'P', 'K', '1'};
+static constexpr u64 HeaderSize = 16;
+static constexpr u64 EntrySize = 36;
+
+inline u32 read_le32(const u8 *p) {
+  return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+inline u64 read_le64(const u8 *p) {
+  return (u64)read_le32(p) | (u64)read_le32(p + 4) << 32;
+}
+
+inline void write_le32(u8 *p, u32 v) {
+  for (u32 i = 0; i < 4; ++i) p[i] = (u8)(v >> (i * 8));
+}
+
+inline void write_le64(u8 *p, u64 v) {
+  write_le32(p, (u32)v);
+  write_le32(p + 4, (u32)(v >> 32));
+}
+
+inline u64 align(u64 v) { return (v + Alignment - 1) & ~(Alignment - 1); }
+}  // namespace Detail
+
+// Read side of a pack. Opening only checks the header, entries are checked
+// when they are looked up, so opening costs the same for any asset count.
+class Archive {
+ public:
+  static constexpr u32 NotFound = 0xFFFFFFFF;
+
+  bool open(const char *path) {
+    close();
+    if (!m_File.open(path) || !parse()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    m_File.close();
+    m_Count = 0;
+  }
+
+  bool is_open() const { return m_File.is_open(); }
+  u32 entry_count() const { return m_Count; }
+
+  // Binary search of the hashes, then the names settle collisions.
+  u32 index_of(std::string_view name) const {
+    auto hash = hash_name(name);
+    u32 first = 0, count = m_Count;
+    while (count > 0) {
+      auto half = count / 2;
+      if (Detail::read_le64(m_Hashes + (u64)(first + half) * 8) < hash) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    for (; first < m_Count; ++first) {
+      if (Detail::read_le64(m_Hashes + (u64)first * 8) != hash) break;
+      if (entry_name(first) == name) return first;
+    }
+    return NotFound;
+  }
+
+  // View of the named entry, valid while the pack is open. Compressed
+  // entries have no view, they are read with read or load.
+  bool find(std::string_view name, std::span<const u8> &data) const {
+    auto index = index_of(name);
+    if (index == NotFound) return false;
+    data = entry_data(index);
+    return data.data() != nullptr;
+  }
+
+  // Empty name for entries which point outside the file.
+  std::string_view entry_name(u32 index) const {
+    auto entry = m_Entries + (u64)index * Detail::EntrySize;
+    auto offset = Detail::read_le32(entry + 24);
+    auto size = Detail::read_le32(entry + 28);
+    if ((u64)offset + size > m_NamesSize) return {};
+    return {(const char *)m_Names + offset, size};
+  }
+
+  // Size once read, compressed or not.
+  u64 entry_size(u32 index) const {
+    return Detail::read_le64(m_Entries + (u64)index * Detail::EntrySize + 8);
+  }
+
+  bool entry_compressed(u32 index) const {
+    auto entry = m_Entries + (u64)index * Detail::EntrySize;
+    return Detail::read_le64(entry + 16) < Detail::read_le64(entry + 8);
+  }
+
+  // Read from the index, so a texture can be routed to its upload path
+  // before its data is paged in.
+  TextureFormat entry_format(u32 index) const {
+    return (TextureFormat)Detail::read_le32(
+        m_Entries + (u64)index * Detail::EntrySize + 32);
+  }
+
+  // No data for compressed entries and entries outside the file.
+  std::span<const u8> entry_data(u32 index) const {
+    auto stored = stored_data(index);
+    if (stored.size() != entry_size(index)) return {};
+    return stored;
+  }
+
+  // Writes the entry_size bytes of the entry to out, decompressing the
+  // chunks of compressed entries in parallel.
+  bool read(u32 index, u8 *out, JobSystem &jobs = JobSystem::instance()) const {
+    auto stored = stored_data(index);
+    auto size = entry_size(index);
+    if (!stored.data()) return false;
+    if (stored.size() == size) {
+      std::memcpy(out, stored.data(), size);
+      return true;
+    }
+
+    auto chunks = (size + m_ChunkSize - 1) / m_ChunkSize;
+    if (chunks > stored.size() / 4 || chunks > 0xFFFFFFFFull) return false;
+    // Chunk offsets from the stored sizes in the table
+    Memory::Vector<u64, Memory::e_Assets> offsets(chunks + 1);
+    u64 offset = chunks * 4;
+    for (u64 i = 0; i < chunks; ++i) {
+      offsets[i] = offset;
+      offset += Detail::read_le32(stored.data() + i * 4);
+    }
+    offsets[chunks] = offset;
+    if (offset > stored.size()) return false;
+
+    std::atomic<bool> ok{true};
+    jobs.parallel_for((u32)chunks, 1, [&](u32 begin, u32 end) {
+      for (auto i = begin; i < end; ++i) {
+        auto src = stored.data() + offsets[i];
+        auto srcSize = offsets[i + 1] - offsets[i];
+        auto dst = out + (u64)i * m_ChunkSize;
+        auto dstSize = std::min<u64>(m_ChunkSize, size - (u64)i * m_ChunkSize);
+        if (srcSize == dstSize)
+          std::memcpy(dst, src, dstSize);
+        else if (!Lz4::decompress(src, srcSize, dst, dstSize))
+          ok.store(false, std::memory_order_relaxed);
+      }
+    });
+    return ok.load(std::memory_order_relaxed);
+  }
+
+  bool load(std::string_view name, Memory::Vector<u8, Memory::e_Assets> &out,
+            JobSystem &jobs = JobSystem::instance()) const {
+    auto index = index_of(name);
+    if (index == NotFound) return false;
+    out.resize(entry_size(index));
+    return read(index, out.data(), jobs);
+  }
+
+ private:
+  bool parse() {
+    auto data = m_File.data();
+    auto size = m_File.size();
+    if (size < Detail::HeaderSize || std::memcmp(data, Detail::Magic, 4))
+      return false;
+    m_Count = Detail::read_le32(data + 4);
+    m_NamesSize = Detail::read_le32(data + 8);
+    m_ChunkSize = Detail::read_le32(data + 12);
+    if (!m_ChunkSize || m_ChunkSize > Lz4::MaxBlockSize) return false;
+    auto indexSize = (u64)m_Count * (8 + Detail::EntrySize);
+    if (size - Detail::HeaderSize < indexSize + m_NamesSize) return false;
+
+    m_Hashes = data + Detail::HeaderSize;
+    m_Entries = m_Hashes + (u64)m_Count * 8;
+    m_Names = m_Entries + (u64)m_Count * Detail::EntrySize;
+    return true;
+  }
+
+  // Bytes of the entry in the file, no data when they are outside of it.
+  std::span<const u8> stored_data(u32 index) const {
+    auto entry = m_Entries + (u64)index * Detail::EntrySize;
+    auto offset = Detail::read_le64(entry);
+    auto size = Detail::read_le64(entry + 16);
+    if (offset > m_File.size() || size > m_File.size() - offset ||
+        size > Detail::read_le64(entry + 8))
+      return {};
+    return {m_File.data() + offset, (size_t)size};
+  }
+
+  MappedFile m_File;
+  const u8 *m_Hashes{nullptr};
+  const u8 *m_Entries{nullptr};
+  const u8 *m_Names{nullptr};
+  u32 m_Count{0};
+  u32 m_NamesSize{0};
+  u32 m_ChunkSize{ChunkSize};
+};
+
+// Collects assets and writes them as a pack. Meant for offline use, see
+// tools/pack_build.cpp.
+class Builder {
+ public:
+  // The data is copied. Names have to be unique, write fails otherwise.
+  // Entries which do not compress to 7/8 of their size are kept as they
+  // are, so they can still be mapped. Block compressed textures gain
+  // little from LZ4, they are best added with compress off.
+  void add(std::string name, std::span<const u8> data, bool compress = true,
+           TextureFormat format = e_UnknownFormat) {
+    m_Entries.push_back(
+        {std::move(name), {data.begin(), data.end()}, compress, format, {}});
+  }
+
+  u32 entry_count() const { return (u32)m_Entries.size(); }
+
+  bool write(const char *path, JobSystem &jobs = JobSystem::instance()) {
+    // Sorted by hash, and by name so the output does not depend on the
+    // order of add calls
+    std::sort(m_Entries.begin(), m_Entries.end(),
+              [](const Entry &a, const Entry &b) {
+                auto ha = hash_name(a.name), hb = hash_name(b.name);
+                return ha != hb ? ha < hb : a.name < b.name;
+              });
+
+    u64 namesSize = 0;
+    for (u64 i = 0; i < m_Entries.size(); ++i) {
+      if (i > 0 && m_Entries[i].name == m_Entries[i - 1].name) return false;
+      namesSize += m_Entries[i].name.size();
+    }
+    if (m_Entries.size() > 0xFFFFFFFFull || namesSize > 0xFFFFFFFFull)
+      return false;
+    for (auto &entry : m_Entries)
+      if (entry.compress) compress(entry, jobs);
+
+    auto count = (u64)m_Entries.size();
+    auto headerSize = Detail::HeaderSize + count * (8 + Detail::EntrySize) +
+                      namesSize;
+    Memory::Vector<u8, Memory::e_Assets> header(Detail::align(headerSize));
+    auto p = header.data();
+    std::memcpy(p, Detail::Magic, 4);
+    Detail::write_le32(p + 4, (u32)count);
+    Detail::write_le32(p + 8, (u32)namesSize);
+    Detail::write_le32(p + 12, ChunkSize);
+
+    auto hashes = p + Detail::HeaderSize;
+    auto entries = hashes + count * 8;
+    auto names = entries + count * Detail::EntrySize;
+    u64 offset = header.size();
+    u32 nameOffset = 0;
+    for (u64 i = 0; i < count; ++i) {
+      auto &entry = m_Entries[i];
+      auto out = entries + i * Detail::EntrySize;
+      Detail::write_le64(hashes + i * 8, hash_name(entry.name));
+      Detail::write_le64(out, offset);
+      Detail::write_le64(out + 8, entry.data.size());
+      Detail::write_le64(out + 16, stored(entry).size());
+      Detail::write_le32(out + 24, nameOffset);
+      Detail::write_le32(out + 28, (u32)entry.name.size());
+      Detail::write_le32(out + 32, entry.format);
+      std::memcpy(names + nameOffset, entry.name.data(), entry.name.size());
+      nameOffset += (u32)entry.name.size();
+      offset = Detail::align(offset + stored(entry).size());
+    }
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f.write((const char *)header.data(), (std::streamsize)header.size()))
+      return false;
+    static const u8 zeros[Alignment] = {};
+    for (auto &entry : m_Entries) {
+      auto data = stored(entry);
+      auto padding = Detail::align(data.size()) - data.size();
+      if (!f.write((const char *)data.data(), (std::streamsize)data.size()) ||
+          !f.write((const char *)zeros, (std::streamsize)padding))
+        return false;
+    }
+    return (bool)f.flush();
+  }
+
+ private:
+  struct Entry {
+    std::string name;
+    Memory::Vector<u8, Memory::e_Assets> data;
+    bool compress;
+    TextureFormat format;
+    // Chunk table and chunks, empty when stored as is
+    Memory::Vector<u8, Memory::e_Assets> compressed;
+  };
+
+  static std::span<const u8> stored(const Entry &entry) {
+    if (entry.compressed.empty()) return entry.data;
+    return entry.compressed;
+  }
+
+  // Compresses the chunks of the entry in parallel.
+  static void compress(Entry &entry, JobSystem &jobs) {
+    auto size = entry.data.size();
+    auto chunks = (u32)((size + ChunkSize - 1) / ChunkSize);
+    Memory::Vector<u8, Memory::e_Assets> buffer((u64)chunks * ChunkSize);
+    Memory::Vector<u32, Memory::e_Assets> sizes(chunks);
+    jobs.parallel_for(chunks, 1, [&](u32 begin, u32 end) {
+      for (auto i = begin; i < end; ++i) {
+        auto src = entry.data.data() + (u64)i * ChunkSize;
+        auto srcSize = (u32)std::min<u64>(ChunkSize, size - (u64)i * ChunkSize);
+        auto dst = buffer.data() + (u64)i * ChunkSize;
+        // A chunk has to get smaller, else it is kept as it is
+        sizes[i] = (u32)Lz4::compress(src, srcSize, dst, srcSize - 1);
+        if (!sizes[i]) {
+          std::memcpy(dst, src, srcSize);
+          sizes[i] = srcSize;
+        }
+      }
+    });
+
+    u64 total = (u64)chunks * 4;
+    for (auto chunkSize : sizes) total += chunkSize;
+    if (total >= size - size / 8) return;
+
+    entry.compressed.resize(total);
+    auto out = entry.compressed.data();
+    for (u32 i = 0; i < chunks; ++i) Detail::write_le32(out + i * 4, sizes[i]);
+    out += (u64)chunks * 4;
+    for (u32 i = 0; i < chunks; ++i) {
+      std::memcpy(out, buffer.data() + (u64)i * ChunkSize, sizes[i]);
+      out += sizes[i];
+    }
+  }
+
+  Memory::Vector<Entry, Memory::e_Assets> m_Entries;
+};
+}  // namespace Pack
+}  // namespace Alien
+
+#endif
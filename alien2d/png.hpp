@@ -0,0 +1,621 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_PNG_HPP
+#define ALIEN_PNG_HPP
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "inflate.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+
+// PNG decoder. Every color type, bit depth and Adam7 interlacing is
+// decoded to RGBA8; 16-bit channels keep their high byte. Chunk CRCs and
+// the zlib checksum are not verified.
+namespace Alien::Png {
+struct Info {
+  u32 width;
+  u32 height;
+  u8 bitDepth;
+  u8 colorType;
+  u8 interlace;
+};
+
+namespace Detail {
+enum ColorType {
+  e_Gray = 0,
+  e_RGB = 2,
+  e_Palette = 3,
+  e_GrayAlpha = 4,
+  e_RGBA = 6
+};
+
+static constexpr u8 Signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+// Sanity limit on each side, keeps the row sizes in 32 bits
+static constexpr u32 MaxSize = 1u << 24;
+
+inline u32 read_be32(const u8 *p) {
+  return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | (u32)p[3];
+}
+
+inline u32 channels(u8 colorType) {
+  switch (colorType) {
+    case e_RGB:
+      return 3;
+    case e_GrayAlpha:
+      return 2;
+    case e_RGBA:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+// Calls f(type, data, length) for every chunk until it returns false or
+// IEND. Returns false on a truncated file.
+template <typename F>
+bool for_each_chunk(const u8 *data, u64 size, F &&f) {
+  if (size < 8 || std::memcmp(data, Signature, 8) != 0) return false;
+
+  for (u64 offset = 8; offset + 12 <= size;) {
+    auto length = read_be32(data + offset);
+    auto type = data + offset + 4;
+    if (length > size - offset - 12) return false;
+    if (std::memcmp(type, "IEND", 4) == 0) return true;
+    if (!f(type, data + offset + 8, length)) return true;
+    offset += 12 + (u64)length;
+  }
+  return false;
+}
+
+struct Chunks {
+  Info info{};
+  // RGBA8, red in the lowest byte
+  u32 palette[256];
+  u32 paletteSize{0};
+  // tRNS color of gray and RGB images, in the sample depth
+  u16 key[3];
+  bool hasKey{false};
+  const u8 *idat{nullptr};
+  u64 idatSize{0};
+  u32 idatCount{0};
+};
+
+inline bool valid_depth(u8 colorType, u8 depth) {
+  switch (colorType) {
+    case e_Gray:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8 ||
+             depth == 16;
+    case e_Palette:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+    case e_RGB:
+    case e_GrayAlpha:
+    case e_RGBA:
+      return depth == 8 || depth == 16;
+    default:
+      return false;
+  }
+}
+
+inline bool parse(const u8 *data, u64 size, Chunks &chunks) {
+  bool hasHeader = false, ok = true;
+  auto complete = for_each_chunk(
+      data, size, [&](const u8 *type, const u8 *chunk, u32 length) {
+        if (!hasHeader) {
+          if (std::memcmp(type, "IHDR", 4) != 0 || length != 13) {
+            ok = false;
+            return false;
+          }
+          auto &info = chunks.info;
+          info = {read_be32(chunk), read_be32(chunk + 4), chunk[8], chunk[9],
+                  chunk[12]};
+          ok = info.width && info.height && info.width <= MaxSize &&
+               info.height <= MaxSize &&
+               valid_depth(info.colorType, info.bitDepth) &&
+               chunk[10] == 0 && chunk[11] == 0 && info.interlace <= 1;
+          hasHeader = true;
+          return ok;
+        }
+
+        if (std::memcmp(type, "PLTE", 4) == 0) {
+          chunks.paletteSize = std::min(256u, length / 3);
+          for (u32 i = 0; i < chunks.paletteSize; ++i) {
+            auto rgb = chunk + i * 3;
+            chunks.palette[i] = (u32)rgb[0] | (u32)rgb[1] << 8 |
+                                (u32)rgb[2] << 16 | 0xFF000000u;
+          }
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+          auto colorType = chunks.info.colorType;
+          if (colorType == e_Palette) {
+            for (u32 i = 0; i < std::min(length, chunks.paletteSize); ++i)
+              chunks.palette[i] =
+                  (chunks.palette[i] & 0xFFFFFF) | (u32)chunk[i] << 24;
+          } else if (colorType == e_Gray && length >= 2) {
+            chunks.key[0] = (u16)(chunk[0] << 8 | chunk[1]);
+            chunks.hasKey = true;
+          } else if (colorType == e_RGB && length >= 6) {
+            for (u32 c = 0; c < 3; ++c)
+              chunks.key[c] = (u16)(chunk[c * 2] << 8 | chunk[c * 2 + 1]);
+            chunks.hasKey = true;
+          }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+          if (!chunks.idat) chunks.idat = chunk;
+          chunks.idatSize += length;
+          ++chunks.idatCount;
+        }
+        return true;
+      });
+
+  return complete && ok && hasHeader && chunks.idat &&
+         (chunks.info.colorType != e_Palette || chunks.paletteSize);
+}
+
+// Sub-image of an Adam7 pass, or the whole image.
+struct Pass {
+  u32 x, y, dx, dy;
+  u32 width, height;
+};
+
+inline u32 make_passes(const Info &info, Pass *passes) {
+  if (!info.interlace) {
+    passes[0] = {0, 0, 1, 1, info.width, info.height};
+    return 1;
+  }
+
+  static constexpr u8 Adam7[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8},
+                                     {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2},
+                                     {0, 1, 1, 2}};
+  u32 count = 0;
+  for (const auto &p : Adam7) {
+    // Empty passes have no rows in the stream
+    if (info.width <= p[0] || info.height <= p[1]) continue;
+    auto width = (info.width - p[0] + p[2] - 1) / p[2];
+    auto height = (info.height - p[1] + p[3] - 1) / p[3];
+    passes[count++] = {p[0], p[1], p[2], p[3], width, height};
+  }
+  return count;
+}
+
+inline u32 row_bytes(const Info &info, u32 width) {
+  return (u32)(((u64)width * channels(info.colorType) * info.bitDepth + 7) /
+               8);
+}
+
+// Parses the chunks and sizes the passes. Deflate expands at most 1032
+// times, so a corrupt header can not make us allocate much more than the
+// file size.
+inline bool prepare(const u8 *data, u64 size, Chunks &chunks, Pass *passes,
+                    u32 &passCount, u64 &inflatedSize) {
+  if (!parse(data, size, chunks)) return false;
+
+  passCount = make_passes(chunks.info, passes);
+  inflatedSize = 0;
+  for (u32 p = 0; p < passCount; ++p)
+    inflatedSize += (u64)passes[p].height *
+                    (1 + row_bytes(chunks.info, passes[p].width));
+  return inflatedSize <= chunks.idatSize * 1032 + 1024;
+}
+}  // namespace Detail
+
+namespace Kernel {
+// in and out may be the same row. prior is the unfiltered row above, zeros
+// for the first row.
+inline void unfilter_row_scalar(u8 filter, const u8 *in, const u8 *prior,
+                                u8 *out, u32 bytes, u32 bpp) {
+  switch (filter) {
+    case 0:
+      if (in != out) std::memcpy(out, in, bytes);
+      break;
+    case 1:
+      for (u32 i = 0; i < bytes; ++i)
+        out[i] = (u8)(in[i] + (i >= bpp ? out[i - bpp] : 0));
+      break;
+    case 2:
+      for (u32 i = 0; i < bytes; ++i) out[i] = (u8)(in[i] + prior[i]);
+      break;
+    case 3:
+      for (u32 i = 0; i < bytes; ++i) {
+        u32 a = i >= bpp ? out[i - bpp] : 0;
+        out[i] = (u8)(in[i] + ((a + prior[i]) >> 1));
+      }
+      break;
+    case 4:
+      for (u32 i = 0; i < bytes; ++i) {
+        i32 a = i >= bpp ? out[i - bpp] : 0;
+        i32 b = prior[i];
+        i32 c = i >= bpp ? prior[i - bpp] : 0;
+        auto pa = std::abs(b - c), pb = std::abs(a - c),
+             pc = std::abs(a + b - 2 * c);
+        auto p = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+        out[i] = (u8)(in[i] + p);
+      }
+      break;
+  }
+}
+
+#if defined(ALIEN_MATH_SSE2) || defined(ALIEN_MATH_NEON)
+// Sub, Avg and Paeth depend on the pixel to the left, so the SIMD
+// versions do one 3 or 4 byte pixel per step in the low lanes.
+template <u32 Bpp>
+inline u32 load_pixel(const u8 *p) {
+  u32 v = 0;
+  std::memcpy(&v, p, Bpp);
+  return v;
+}
+
+template <u32 Bpp>
+inline void store_pixel(u8 *p, u32 v) {
+  std::memcpy(p, &v, Bpp);
+}
+
+inline void unfilter_up(const u8 *in, const u8 *prior, u8 *out, u32 bytes) {
+  u32 i = 0;
+#if defined(ALIEN_MATH_SSE2)
+  for (; i + 16 <= bytes; i += 16) {
+    auto v = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(in + i)),
+                          _mm_loadu_si128((const __m128i *)(prior + i)));
+    _mm_storeu_si128((__m128i *)(out + i), v);
+  }
+#else
+  for (; i + 16 <= bytes; i += 16)
+    vst1q_u8(out + i, vaddq_u8(vld1q_u8(in + i), vld1q_u8(prior + i)));
+#endif
+  for (; i < bytes; ++i) out[i] = (u8)(in[i] + prior[i]);
+}
+
+#if defined(ALIEN_MATH_SSE2)
+template <u32 Bpp>
+inline void unfilter_pixels(u8 filter, const u8 *in, const u8 *prior, u8 *out,
+                            u32 bytes) {
+  auto zero = _mm_setzero_si128();
+  auto load = [](const u8 *p) {
+    return _mm_cvtsi32_si128((int)load_pixel<Bpp>(p));
+  };
+  auto store = [](u8 *p, __m128i v) {
+    store_pixel<Bpp>(p, (u32)_mm_cvtsi128_si32(v));
+  };
+
+  auto a = zero;
+  if (filter == 1) {
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      a = _mm_add_epi8(a, load(in + i));
+      store(out + i, a);
+    }
+  } else if (filter == 3) {
+    // avg_epu8 rounds up, the filter rounds down
+    auto one = _mm_set1_epi8(1);
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      auto b = load(prior + i);
+      auto avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                              _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(load(in + i), avg);
+      store(out + i, a);
+    }
+  } else {
+    // 16-bit lanes, the distances do not fit in bytes
+    auto abs16 = [&](__m128i v) {
+      return _mm_max_epi16(v, _mm_sub_epi16(zero, v));
+    };
+    auto select = [](__m128i mask, __m128i t, __m128i f) {
+      return _mm_or_si128(_mm_and_si128(mask, t), _mm_andnot_si128(mask, f));
+    };
+    auto c = zero;
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      auto b = _mm_unpacklo_epi8(load(prior + i), zero);
+      auto pa = _mm_sub_epi16(b, c);
+      auto pb = _mm_sub_epi16(a, c);
+      auto pc = abs16(_mm_add_epi16(pa, pb));
+      pa = abs16(pa);
+      pb = abs16(pb);
+      auto smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      auto nearest = select(_mm_cmpeq_epi16(smallest, pa), a,
+                            select(_mm_cmpeq_epi16(smallest, pb), b, c));
+      // High bytes are zero, adding bytes wraps like the filter
+      a = _mm_add_epi8(_mm_unpacklo_epi8(load(in + i), zero), nearest);
+      store(out + i, _mm_packus_epi16(a, a));
+      c = b;
+    }
+  }
+}
+#else
+inline uint8x8_t paeth(uint8x8_t a, uint8x8_t b, uint8x8_t c) {
+  auto pa = vabdl_u8(b, c);
+  auto pb = vabdl_u8(a, c);
+  auto pc = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+  auto pickA = vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc));
+  auto pickB = vcleq_u16(pb, pc);
+  auto bc = vbsl_u8(vmovn_u16(pickB), b, c);
+  return vbsl_u8(vmovn_u16(pickA), a, bc);
+}
+
+template <u32 Bpp>
+inline void unfilter_pixels(u8 filter, const u8 *in, const u8 *prior, u8 *out,
+                            u32 bytes) {
+  auto load = [](const u8 *p) {
+    return vreinterpret_u8_u32(vdup_n_u32(load_pixel<Bpp>(p)));
+  };
+  auto store = [](u8 *p, uint8x8_t v) {
+    store_pixel<Bpp>(p, vget_lane_u32(vreinterpret_u32_u8(v), 0));
+  };
+
+  auto a = vdup_n_u8(0);
+  if (filter == 1) {
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      a = vadd_u8(a, load(in + i));
+      store(out + i, a);
+    }
+  } else if (filter == 3) {
+    // Halving add rounds down like the filter
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      a = vadd_u8(load(in + i), vhadd_u8(a, load(prior + i)));
+      store(out + i, a);
+    }
+  } else {
+    auto c = vdup_n_u8(0);
+    for (u32 i = 0; i < bytes; i += Bpp) {
+      auto b = load(prior + i);
+      a = vadd_u8(load(in + i), paeth(a, b, c));
+      store(out + i, a);
+      c = b;
+    }
+  }
+}
+#endif
+#endif
+
+// Reverses the filter of one row.
+inline void unfilter_row(u8 filter, const u8 *in, const u8 *prior, u8 *out,
+                         u32 bytes, u32 bpp) {
+#if defined(ALIEN_MATH_SSE2) || defined(ALIEN_MATH_NEON)
+  if (filter == 2) {
+    unfilter_up(in, prior, out, bytes);
+    return;
+  }
+  if (filter != 0 && bpp == 4) {
+    unfilter_pixels<4>(filter, in, prior, out, bytes);
+    return;
+  }
+  if (filter != 0 && bpp == 3) {
+    unfilter_pixels<3>(filter, in, prior, out, bytes);
+    return;
+  }
+#endif
+  unfilter_row_scalar(filter, in, prior, out, bytes, bpp);
+}
+}  // namespace Kernel
+
+namespace Detail {
+// Unfiltered row of the given width to RGBA8.
+inline void convert_row(const Chunks &chunks, const u8 *row, u32 width,
+                        u8 *out) {
+  const auto &info = chunks.info;
+  u32 depth = info.bitDepth;
+  auto key = chunks.hasKey;
+
+  // Sub-byte samples, the first pixel is in the high bits
+  auto sample = [&](u32 i) -> u32 {
+    auto bit = i * depth;
+    return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+  };
+  auto put = [&](u32 i, u32 r, u32 g, u32 b, u32 a) {
+    auto p = out + i * 4;
+    p[0] = (u8)r;
+    p[1] = (u8)g;
+    p[2] = (u8)b;
+    p[3] = (u8)a;
+  };
+
+  switch (info.colorType) {
+    case e_Gray:
+      for (u32 i = 0; i < width; ++i) {
+        u32 raw, v;
+        if (depth == 16) {
+          raw = (u32)row[i * 2] << 8 | row[i * 2 + 1];
+          v = row[i * 2];
+        } else if (depth == 8) {
+          raw = v = row[i];
+        } else {
+          raw = sample(i);
+          v = raw * (255 / ((1u << depth) - 1));
+        }
+        put(i, v, v, v, key && raw == chunks.key[0] ? 0 : 255);
+      }
+      break;
+    case e_RGB:
+      for (u32 i = 0; i < width; ++i) {
+        if (depth == 16) {
+          auto p = row + i * 6;
+          auto transparent = key &&
+                             ((u32)p[0] << 8 | p[1]) == chunks.key[0] &&
+                             ((u32)p[2] << 8 | p[3]) == chunks.key[1] &&
+                             ((u32)p[4] << 8 | p[5]) == chunks.key[2];
+          put(i, p[0], p[2], p[4], transparent ? 0 : 255);
+        } else {
+          auto p = row + i * 3;
+          auto transparent = key && p[0] == chunks.key[0] &&
+                             p[1] == chunks.key[1] && p[2] == chunks.key[2];
+          put(i, p[0], p[1], p[2], transparent ? 0 : 255);
+        }
+      }
+      break;
+    case e_Palette:
+      for (u32 i = 0; i < width; ++i) {
+        auto index = depth == 8 ? row[i] : sample(i);
+        // Out of range indices are opaque black
+        auto color = index < chunks.paletteSize ? chunks.palette[index]
+                                                : 0xFF000000u;
+        std::memcpy(out + i * 4, &color, 4);
+      }
+      break;
+    case e_GrayAlpha:
+      for (u32 i = 0; i < width; ++i) {
+        auto p = depth == 16 ? row + i * 4 : row + i * 2;
+        auto v = p[0], a = depth == 16 ? p[2] : p[1];
+        put(i, v, v, v, a);
+      }
+      break;
+    case e_RGBA:
+      if (depth == 8) {
+        std::memcpy(out, row, (u64)width * 4);
+      } else {
+        for (u32 i = 0; i < width; ++i) {
+          auto p = row + i * 8;
+          put(i, p[0], p[2], p[4], p[6]);
+        }
+      }
+      break;
+  }
+}
+
+struct Scratch {
+  Memory::Vector<u8, Memory::e_Assets> idat;
+  Memory::Vector<u8, Memory::e_Assets> inflated;
+  Memory::Vector<u8, Memory::e_Assets> zeros;
+  Memory::Vector<u8, Memory::e_Assets> row;
+};
+
+// Kept per thread, so decoding many files reuses the buffers.
+inline Scratch &scratch() {
+  static thread_local Scratch s;
+  return s;
+}
+}  // namespace Detail
+
+// Checks the chunks without decoding, false when decode would fail early.
+inline bool read_info(const u8 *data, u64 size, Info &info) {
+  Detail::Chunks chunks;
+  Detail::Pass passes[7];
+  u32 passCount;
+  u64 inflatedSize;
+  if (!Detail::prepare(data, size, chunks, passes, passCount, inflatedSize))
+    return false;
+  info = chunks.info;
+  return true;
+}
+
+// Decodes to RGBA8 rows pitch bytes apart. Every byte of pixels is written
+// once and never read, so it can point straight at mapped upload memory.
+// Non-interlaced RGBA8 images, the common case, are copied out row by row.
+inline bool decode(const u8 *data, u64 size, u8 *pixels, u32 pitch) {
+  Detail::Chunks chunks;
+  Detail::Pass passes[7];
+  u32 passCount;
+  u64 total;
+  if (!Detail::prepare(data, size, chunks, passes, passCount, total))
+    return false;
+  const auto &info = chunks.info;
+
+  auto &scratch = Detail::scratch();
+  // IDAT chunks split one zlib stream, join them when there are several
+  auto stream = chunks.idat;
+  if (chunks.idatCount > 1) {
+    scratch.idat.clear();
+    Detail::for_each_chunk(
+        data, size, [&](const u8 *type, const u8 *chunk, u32 length) {
+          if (std::memcmp(type, "IDAT", 4) == 0)
+            scratch.idat.insert(scratch.idat.end(), chunk, chunk + length);
+          return true;
+        });
+    stream = scratch.idat.data();
+  }
+
+  auto &inflated = scratch.inflated;
+  inflated.resize(total);
+  u64 written;
+  if (!Zlib::decompress(stream, chunks.idatSize, inflated.data(), total,
+                        written) ||
+      written != total)
+    return false;
+
+  auto bpp =
+      std::max(1u, Detail::channels(info.colorType) * info.bitDepth / 8);
+  auto direct = !info.interlace && info.colorType == Detail::e_RGBA &&
+                info.bitDepth == 8;
+  scratch.zeros.assign(Detail::row_bytes(info, info.width), 0);
+  scratch.row.resize((u64)info.width * 4);
+
+  auto rows = inflated.data();
+  for (u32 p = 0; p < passCount; ++p) {
+    const auto &pass = passes[p];
+    auto rowBytes = Detail::row_bytes(info, pass.width);
+    for (u32 y = 0; y < pass.height; ++y) {
+      auto row = rows + (u64)y * (rowBytes + 1);
+      auto filter = row[0];
+      if (filter > 4) return false;
+
+      // In place, the row above is already unfiltered
+      auto prior = y ? row - rowBytes : scratch.zeros.data();
+      Kernel::unfilter_row(filter, row + 1, prior, row + 1, rowBytes, bpp);
+      if (direct) {
+        std::memcpy(pixels + (u64)y * pitch, row + 1, rowBytes);
+        continue;
+      }
+      if (!info.interlace) {
+        Detail::convert_row(chunks, row + 1, pass.width,
+                            pixels + (u64)y * pitch);
+        continue;
+      }
+
+      auto rgba = scratch.row.data();
+      Detail::convert_row(chunks, row + 1, pass.width, rgba);
+      auto out = pixels + (u64)(pass.y + y * pass.dy) * pitch;
+      for (u32 x = 0; x < pass.width; ++x)
+        std::memcpy(out + (u64)(pass.x + x * pass.dx) * 4, rgba + x * 4, 4);
+    }
+    rows += (u64)pass.height * (rowBytes + 1);
+  }
+  return true;
+}
+
+inline bool load(const u8 *data, u64 size, Image &image) {
+  Info info;
+  if (!read_info(data, size, info)) return false;
+
+  image.width = info.width;
+  image.height = info.height;
+  image.pixels.resize((u64)info.width * info.height * 4);
+  return decode(data, size, image.pixels.data(), info.width * 4);
+}
+
+// Decodes the files in parallel, one file per job.
+inline void decode_all(DecodeTask *tasks, u32 count,
+                       JobSystem &jobs = JobSystem::instance()) {
+  jobs.parallel_for(count, 1, [&](u32 begin, u32 end) {
+    for (auto i = begin; i < end; ++i) {
+      auto &task = tasks[i];
+      task.ok = decode(task.data, task.size, task.pixels, task.pitch);
+    }
+  });
+}
+}  // namespace Alien::Png
+
+#endif
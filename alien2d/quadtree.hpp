@@ -0,0 +1,304 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_QUADTREE_HPP
+#define ALIEN_QUADTREE_HPP
+
+#include <algorithm>
+
+#include "base.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "slot_map.hpp"
+
+namespace Alien {
+using QuadtreeHandle = Handle<struct QuadtreeTag>;
+
+// Loose quadtree over fixed world bounds. The levels are dense grids, a
+// node at depth d covers 1/2^d of the world on each axis and its loose
+// bounds are twice that size around the same center. An item goes to the
+// deepest level whose cells are at least as large as the item, in the
+// cell which contains its center, so placing it is O(1) and a small move
+// usually keeps it in the same node. Items which do not fit the world go
+// to an outside list that every query scans.
+//
+// Rects are Vec4 with min in xy and max in zw, same as Math::bounds.
+class LooseQuadtree {
+ public:
+  static constexpr u32 DefaultDepth = 8;
+
+  LooseQuadtree() : LooseQuadtree({-32768.0f, -32768.0f, 32768.0f, 32768.0f}) {}
+
+  explicit LooseQuadtree(const Math::Vec4 &worldBounds,
+                         u32 maxDepth = DefaultDepth) {
+    reset(worldBounds, maxDepth);
+  }
+
+  // Drops every item. Depth d has 4^d nodes, keep maxDepth around 8-10.
+  void reset(const Math::Vec4 &worldBounds, u32 maxDepth = DefaultDepth) {
+    assert(maxDepth < 16 && "Quadtree is too deep!");
+    m_World = worldBounds;
+    m_MaxDepth = maxDepth;
+
+    u32 nodeCount = 0;
+    for (u32 d = 0; d <= maxDepth; ++d) {
+      m_LevelStart[d] = nodeCount;
+      nodeCount += 1u << (2 * d);
+    }
+    // The last node holds the items outside of the world
+    m_Outside = nodeCount;
+    m_Nodes.assign(nodeCount + 1, Node{});
+    m_Items.clear();
+    m_FreeHead = InvalidIndex;
+    m_Size = 0;
+  }
+
+  QuadtreeHandle insert(const Math::Vec4 &bounds, u32 value) {
+    u32 index;
+    if (m_FreeHead != InvalidIndex) {
+      index = m_FreeHead;
+      m_FreeHead = m_Items[index].next;
+    } else {
+      index = (u32)m_Items.size();
+      assert(index <= QuadtreeHandle::IndexMask && "Quadtree is full!");
+      m_Items.push_back(Item{});
+      m_Items[index].generation = 1;
+    }
+
+    auto &item = m_Items[index];
+    item.bounds = bounds;
+    item.value = value;
+    link(index, locate(bounds));
+    ++m_Size;
+    return QuadtreeHandle(index, item.generation);
+  }
+
+  // Cheap when the item stays in its node, which is the common case.
+  bool update(QuadtreeHandle handle, const Math::Vec4 &bounds) {
+    auto index = item_index(handle);
+    if (index == InvalidIndex) return false;
+
+    m_Items[index].bounds = bounds;
+    auto node = locate(bounds);
+    if (node != m_Items[index].node) {
+      unlink(index);
+      link(index, node);
+    }
+    return true;
+  }
+
+  bool remove(QuadtreeHandle handle) {
+    auto index = item_index(handle);
+    if (index == InvalidIndex) return false;
+
+    unlink(index);
+    auto &item = m_Items[index];
+    item.generation = (item.generation + 1) & QuadtreeHandle::GenerationMask;
+    if (item.generation == 0) item.generation = 1;
+    item.node = InvalidIndex;
+    item.next = m_FreeHead;
+    m_FreeHead = index;
+    --m_Size;
+    return true;
+  }
+
+  // Calls f(value) for every item overlapping the rect.
+  template <typename F>
+  void query(const Math::Vec4 &rect, F &&f) const {
+    for (auto i = m_Nodes[m_Outside].head; i != InvalidIndex;
+         i = m_Items[i].next) {
+      if (overlaps(m_Items[i].bounds, rect)) f(m_Items[i].value);
+    }
+    query_node(0, 0, 0, rect, f);
+  }
+
+  u32 size() const { return m_Size; }
+  const Math::Vec4 &world_bounds() const { return m_World; }
+
+ private:
+  static constexpr u32 InvalidIndex = 0xFFFFFFFF;
+
+  struct Item {
+    Math::Vec4 bounds;
+    u32 value;
+    u32 generation;
+    u32 node{InvalidIndex};
+    // Siblings in the node, or the next free item
+    u32 prev{InvalidIndex};
+    u32 next{InvalidIndex};
+  };
+
+  struct Node {
+    u32 head{InvalidIndex};
+    // Items in this node and below
+    u32 count{0};
+  };
+
+  static bool overlaps(const Math::Vec4 &a, const Math::Vec4 &b) {
+    return a.x <= b.z && b.x <= a.z && a.y <= b.w && b.y <= a.w;
+  }
+
+  static bool contains(const Math::Vec4 &outer, const Math::Vec4 &inner) {
+    return outer.x <= inner.x && outer.y <= inner.y && inner.z <= outer.z &&
+           inner.w <= outer.w;
+  }
+
+  u32 item_index(QuadtreeHandle handle) const {
+    auto index = handle.index();
+    if (!handle || index >= m_Items.size() ||
+        m_Items[index].generation != handle.generation() ||
+        m_Items[index].node == InvalidIndex)
+      return InvalidIndex;
+    return index;
+  }
+
+  u32 node_index(u32 depth, u32 x, u32 y) const {
+    return m_LevelStart[depth] + (y << depth) + x;
+  }
+
+  f32 cell_width(u32 depth) const {
+    return (m_World.z - m_World.x) / (f32)(1u << depth);
+  }
+  f32 cell_height(u32 depth) const {
+    return (m_World.w - m_World.y) / (f32)(1u << depth);
+  }
+
+  // Node the item belongs to.
+  u32 locate(const Math::Vec4 &bounds) const {
+    auto cx = (bounds.x + bounds.z) * 0.5f;
+    auto cy = (bounds.y + bounds.w) * 0.5f;
+    auto w = bounds.z - bounds.x, h = bounds.w - bounds.y;
+    if (!(cx >= m_World.x && cx < m_World.z && cy >= m_World.y &&
+          cy < m_World.w) ||
+        w > cell_width(0) || h > cell_height(0))
+      return m_Outside;
+
+    auto depth = m_MaxDepth;
+    while (depth > 0 && (w > cell_width(depth) || h > cell_height(depth)))
+      --depth;
+
+    auto n = 1u << depth;
+    auto x = std::min(n - 1, (u32)((cx - m_World.x) / cell_width(depth)));
+    auto y = std::min(n - 1, (u32)((cy - m_World.y) / cell_height(depth)));
+    return node_index(depth, x, y);
+  }
+
+  u32 depth_of(u32 node) const {
+    auto depth = m_MaxDepth;
+    while (m_LevelStart[depth] > node) --depth;
+    return depth;
+  }
+
+  // Adds delta to the counts of the node and its ancestors.
+  void add_count(u32 node, i32 delta) {
+    if (node == m_Outside) {
+      m_Nodes[node].count += delta;
+      return;
+    }
+
+    auto depth = depth_of(node);
+    auto local = node - m_LevelStart[depth];
+    auto x = local & ((1u << depth) - 1), y = local >> depth;
+    for (;;) {
+      m_Nodes[node_index(depth, x, y)].count += delta;
+      if (depth == 0) break;
+      --depth;
+      x >>= 1;
+      y >>= 1;
+    }
+  }
+
+  void link(u32 index, u32 node) {
+    auto &item = m_Items[index];
+    item.node = node;
+    item.prev = InvalidIndex;
+    item.next = m_Nodes[node].head;
+    if (item.next != InvalidIndex) m_Items[item.next].prev = index;
+    m_Nodes[node].head = index;
+    add_count(node, 1);
+  }
+
+  void unlink(u32 index) {
+    auto &item = m_Items[index];
+    if (item.prev != InvalidIndex)
+      m_Items[item.prev].next = item.next;
+    else
+      m_Nodes[item.node].head = item.next;
+    if (item.next != InvalidIndex) m_Items[item.next].prev = item.prev;
+    add_count(item.node, -1);
+  }
+
+  template <typename F>
+  void query_node(u32 depth, u32 x, u32 y, const Math::Vec4 &rect,
+                  F &f) const {
+    const auto &node = m_Nodes[node_index(depth, x, y)];
+    if (node.count == 0) return;
+
+    auto w = cell_width(depth), h = cell_height(depth);
+    auto minX = m_World.x + (f32)x * w, minY = m_World.y + (f32)y * h;
+    Math::Vec4 loose(minX - w * 0.5f, minY - h * 0.5f, minX + w * 1.5f,
+                     minY + h * 1.5f);
+    if (!overlaps(loose, rect)) return;
+
+    // Every item below is inside the loose bounds
+    if (contains(rect, loose)) {
+      emit_node(depth, x, y, f);
+      return;
+    }
+
+    for (auto i = node.head; i != InvalidIndex; i = m_Items[i].next) {
+      if (overlaps(m_Items[i].bounds, rect)) f(m_Items[i].value);
+    }
+    if (depth == m_MaxDepth) return;
+    for (u32 c = 0; c < 4; ++c)
+      query_node(depth + 1, x * 2 + (c & 1), y * 2 + (c >> 1), rect, f);
+  }
+
+  template <typename F>
+  void emit_node(u32 depth, u32 x, u32 y, F &f) const {
+    const auto &node = m_Nodes[node_index(depth, x, y)];
+    if (node.count == 0) return;
+
+    for (auto i = node.head; i != InvalidIndex; i = m_Items[i].next)
+      f(m_Items[i].value);
+    if (depth == m_MaxDepth) return;
+    for (u32 c = 0; c < 4; ++c)
+      emit_node(depth + 1, x * 2 + (c & 1), y * 2 + (c >> 1), f);
+  }
+
+  Math::Vec4 m_World;
+  u32 m_MaxDepth{0};
+  u32 m_LevelStart[16]{};
+  u32 m_Outside{0};
+
+  Memory::Vector<Node, Memory::e_Game> m_Nodes;
+  Memory::Vector<Item, Memory::e_Game> m_Items;
+  u32 m_FreeHead{InvalidIndex};
+  u32 m_Size{0};
+};
+}  // namespace Alien
+
+#endif
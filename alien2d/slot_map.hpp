@@ -0,0 +1,190 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_SLOT_MAP_HPP
+#define ALIEN_SLOT_MAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "base.hpp"
+
+namespace Alien {
+// 32-bit generational handle. Lower bits are the slot index, upper bits are
+// the generation of the slot when the handle was issued. Zero is never
+// issued so a default constructed handle is always invalid.
+template <typename Tag>
+struct Handle {
+  static constexpr u32 IndexBits = 20;
+  static constexpr u32 GenerationBits = 32 - IndexBits;
+  static constexpr u32 IndexMask = (1u << IndexBits) - 1;
+  static constexpr u32 GenerationMask = (1u << GenerationBits) - 1;
+
+  Handle() = default;
+  Handle(u32 index, u32 generation)
+      : value((generation & GenerationMask) << IndexBits |
+              (index & IndexMask)) {}
+
+  u32 index() const { return value & IndexMask; }
+  u32 generation() const { return value >> IndexBits; }
+  bool is_valid() const { return value != 0; }
+
+  explicit operator bool() const { return is_valid(); }
+  bool operator==(const Handle &other) const = default;
+
+  u32 value{0};
+};
+
+// Dense slot map. Values live in a contiguous array, slots map a handle to
+// its dense position and keep the generation which is bumped on every erase,
+// so a handle to a released value is detected instead of aliasing the next
+// value that reuses the slot.
+template <typename T, typename Tag>
+class SlotMap {
+ public:
+  using HandleType = Handle<Tag>;
+
+  SlotMap() = default;
+
+  void reserve(u32 capacity) {
+    m_Values.reserve(capacity);
+    m_DenseToSlot.reserve(capacity);
+    m_Slots.reserve(capacity);
+  }
+
+  HandleType insert(T value) {
+    u32 slotIndex;
+    if (m_FreeHead != InvalidIndex) {
+      slotIndex = m_FreeHead;
+      m_FreeHead = m_Slots[slotIndex].dense;
+    } else {
+      slotIndex = (u32)m_Slots.size();
+      assert(slotIndex <= HandleType::IndexMask && "Slot map is full!");
+      m_Slots.push_back(Slot{InvalidIndex, 1});
+    }
+
+    auto &slot = m_Slots[slotIndex];
+    slot.dense = (u32)m_Values.size();
+    m_Values.push_back(std::move(value));
+    m_DenseToSlot.push_back(slotIndex);
+
+    return HandleType(slotIndex, slot.generation);
+  }
+
+  // Returns nullptr when the handle is stale or was never issued.
+  T *get(HandleType handle) {
+    auto index = dense_index(handle);
+    return index == InvalidIndex ? nullptr : &m_Values[index];
+  }
+
+  const T *get(HandleType handle) const {
+    auto index = dense_index(handle);
+    return index == InvalidIndex ? nullptr : &m_Values[index];
+  }
+
+  bool contains(HandleType handle) const {
+    return dense_index(handle) != InvalidIndex;
+  }
+
+  // Erase with swap-remove so the value array stays dense.
+  bool erase(HandleType handle) {
+    auto index = dense_index(handle);
+    if (index == InvalidIndex) return false;
+
+    auto last = (u32)m_Values.size() - 1;
+    if (index != last) {
+      m_Values[index] = std::move(m_Values[last]);
+      m_DenseToSlot[index] = m_DenseToSlot[last];
+      m_Slots[m_DenseToSlot[index]].dense = index;
+    }
+    m_Values.pop_back();
+    m_DenseToSlot.pop_back();
+
+    // Generation zero is skipped so the handle value never becomes zero.
+    auto &slot = m_Slots[handle.index()];
+    slot.generation = (slot.generation + 1) & HandleType::GenerationMask;
+    if (slot.generation == 0) slot.generation = 1;
+    slot.dense = m_FreeHead;
+    m_FreeHead = handle.index();
+
+    return true;
+  }
+
+  void clear() {
+    while (!m_Values.empty()) {
+      auto slotIndex = m_DenseToSlot.back();
+      erase(HandleType(slotIndex, m_Slots[slotIndex].generation));
+    }
+  }
+
+  // Dense position of the value, InvalidIndex when the handle is stale.
+  // Lets callers keep parallel arrays in the same order as the values.
+  u32 index_of(HandleType handle) const { return dense_index(handle); }
+
+  // Handle of the value at the given dense position.
+  HandleType handle_at(u32 denseIndex) const {
+    auto slotIndex = m_DenseToSlot[denseIndex];
+    return HandleType(slotIndex, m_Slots[slotIndex].generation);
+  }
+
+  u32 size() const { return (u32)m_Values.size(); }
+  bool empty() const { return m_Values.empty(); }
+
+  T *data() { return m_Values.data(); }
+  const T *data() const { return m_Values.data(); }
+
+  auto begin() { return m_Values.begin(); }
+  auto end() { return m_Values.end(); }
+  auto begin() const { return m_Values.begin(); }
+  auto end() const { return m_Values.end(); }
+
+  static constexpr u32 InvalidIndex = 0xFFFFFFFF;
+
+ private:
+  struct Slot {
+    // Dense position while alive, next free slot while in the free list.
+    u32 dense;
+    u32 generation;
+  };
+
+  u32 dense_index(HandleType handle) const {
+    auto slotIndex = handle.index();
+    if (!handle.is_valid() || slotIndex >= m_Slots.size()) return InvalidIndex;
+
+    const auto &slot = m_Slots[slotIndex];
+    if (slot.generation != handle.generation()) return InvalidIndex;
+
+    return slot.dense;
+  }
+
+  std::vector<T> m_Values;
+  std::vector<u32> m_DenseToSlot;
+  std::vector<Slot> m_Slots;
+  u32 m_FreeHead{InvalidIndex};
+};
+}  // namespace Alien
+
+#endif
@@ -0,0 +1,510 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_TEXTURE_STREAM_HPP
+#define ALIEN_TEXTURE_STREAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <span>
+#include <thread>
+
+#include "alien_gl.hpp"
+#include "ati.hpp"
+#include "jobs.hpp"
+#include "jpeg.hpp"
+#include "mip.hpp"
+#include "png.hpp"
+
+#ifndef ALIEN_DX11
+
+namespace Alien {
+using StreamHandle = Handle<struct StreamTag>;
+
+// Texture which is decoded later on a worker. The size has to be known up
+// front so its staging memory can be reserved before decoding.
+struct TextureSource {
+  u32 width{0};
+  u32 height{0};
+  // Writes RGBA8 rows pitch bytes apart, false when the data is corrupt
+  std::function<bool(u8 *pixels, u32 pitch)> decode;
+  // Mipmap levels, the ones after the first are made on the worker right
+  // after the decode. Mip::level_count for every level.
+  u32 levels{1};
+  Mip::Filter filter{Mip::e_Kaiser};
+};
+
+// Streams textures to the GPU without stalling the frame. Decodes run on
+// background workers straight into a ring of pixel buffer memory, mipmap
+// chains are made in CPU memory and copied there, and update() moves at
+// most FrameBudget bytes per frame from there into the textures with
+// glTexSubImage2D. Ring space is reused once the fence of the frame which
+// read it is signaled. Until a texture is resident the placeholder is
+// handed out instead.
+//
+// The ring is mapped persistently when the driver has buffer storage.
+// Otherwise decodes go to CPU memory and are copied into an unsynchronized
+// mapping of the ring at upload time.
+//
+// Everything except the decodes runs on the thread which owns the context.
+class TextureStreamer {
+ public:
+  enum State { e_Queued, e_Decoding, e_Uploading, e_Resident, e_Failed };
+
+  static constexpr u64 DefaultRingSize = 64ull << 20;
+  static constexpr u64 DefaultFrameBudget = 4ull << 20;
+
+  explicit TextureStreamer(GLContext &context,
+                           u64 ringSize = DefaultRingSize,
+                           u64 frameBudget = DefaultFrameBudget,
+                           JobSystem &jobs = JobSystem::instance())
+      : m_Context(context),
+        m_Jobs(jobs),
+        m_RingSize(ringSize),
+        m_FrameBudget(std::max(frameBudget, (u64)1)) {}
+
+  ~TextureStreamer() {
+    // Decodes write into the ring, let them finish before it goes away
+    while (m_Decoding.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+
+    for (auto &entry : m_Entries)
+      if (entry.texture) m_Context.release_texture(entry.texture);
+    if (m_OwnsPlaceholder) m_Context.release_texture(m_Placeholder);
+
+    if (!m_Buffer) return;
+    for (auto &frame : m_Fences) {
+      if (!frame.fence) continue;
+      glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+      glDeleteSync(frame.fence);
+    }
+    if (m_Mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffer);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_Buffer);
+    Memory::track_gpu_buffer(-(i64)m_RingSize);
+  }
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // Queues a texture, it is decoded once there is ring space for it.
+  // Textures larger than the ring fail.
+  StreamHandle request(TextureSource source) {
+    auto valid = source.width && source.height && source.decode &&
+                 source.levels >= 1 &&
+                 source.levels <= Mip::level_count(source.width, source.height);
+    auto state = valid ? e_Queued : e_Failed;
+    auto handle = m_Entries.insert(Entry{std::move(source), state});
+    if (state == e_Queued) m_Queued.push_back(handle);
+    return handle;
+  }
+
+  // Queues an encoded ATI, PNG or JPEG file. Only the header is read here,
+  // the data has to stay alive until the texture is resident, e.g. a file
+  // in a mapped pack.
+  StreamHandle request(std::span<const u8> file, u32 levels = 1,
+                       Mip::Filter filter = Mip::e_Kaiser) {
+    auto data = file.data();
+    auto size = (u64)file.size();
+    auto jobs = &m_Jobs;
+    TextureSource source;
+
+    Ati::Info ati;
+    Png::Info png;
+    Jpeg::Info jpeg;
+    if (Ati::read_info(data, size, ati)) {
+      source = {ati.width, ati.height, [=](u8 *pixels, u32 pitch) {
+                  return Ati::decode(data, size, pixels, pitch, *jobs);
+                }};
+    } else if (Png::read_info(data, size, png)) {
+      source = {png.width, png.height, [=](u8 *pixels, u32 pitch) {
+                  return Png::decode(data, size, pixels, pitch);
+                }};
+    } else if (Jpeg::read_info(data, size, jpeg)) {
+      source = {jpeg.width, jpeg.height, [=](u8 *pixels, u32 pitch) {
+                  return Jpeg::decode(data, size, pixels, pitch, *jobs);
+                }};
+    }
+    source.levels = levels;
+    source.filter = filter;
+    return request(std::move(source));
+  }
+
+  // Drops the texture, whatever state it is in. The handle becomes stale.
+  void release(StreamHandle handle) {
+    auto entry = m_Entries.get(handle);
+    if (!entry) return;
+
+    // A running decode still writes into its staging memory, the entry
+    // is erased when it reports back
+    if (entry->state == e_Decoding) {
+      entry->released = true;
+      return;
+    }
+    if (entry->texture) m_Context.release_texture(entry->texture);
+    if (entry->state == e_Uploading) finish_staging(*entry, entry->frameIndex);
+    m_Entries.erase(handle);
+  }
+
+  // Resident texture, or the placeholder while it is still on its way.
+  TextureHandle texture(StreamHandle handle) const {
+    auto entry = m_Entries.get(handle);
+    return entry && entry->state == e_Resident ? entry->texture
+                                               : m_Placeholder;
+  }
+
+  State state(StreamHandle handle) const {
+    auto entry = m_Entries.get(handle);
+    return entry ? entry->state : e_Failed;
+  }
+
+  // Shown for textures which are not resident. A 1x1 grey texture is
+  // created on the first update unless one is set, it is not released
+  // by the streamer.
+  void set_placeholder(TextureHandle texture) {
+    if (m_OwnsPlaceholder) m_Context.release_texture(m_Placeholder);
+    m_Placeholder = texture;
+    m_OwnsPlaceholder = false;
+  }
+
+  void set_frame_budget(u64 bytes) { m_FrameBudget = std::max(bytes, (u64)1); }
+  u64 frame_budget() const { return m_FrameBudget; }
+
+  // Bytes sent to textures in the last update
+  u64 uploaded_bytes() const { return m_UploadedBytes; }
+  // Ring bytes held by decodes and uploads which are not reclaimed yet,
+  // including the end of the ring which was skipped by a wrap
+  u64 staging_used() const {
+    if (m_Staging.empty()) return 0;
+    auto tail = m_Staging.front().offset;
+    return m_Head > tail ? m_Head - tail : m_RingSize - tail + m_Head;
+  }
+
+  // Once per frame, after GLContext::next_frame. Reclaims ring space,
+  // uploads within the budget and starts the decodes which fit.
+  void update() {
+    if (!m_Buffer) create_ring();
+    ++m_FrameIndex;
+
+    reclaim_staging();
+    m_Decoded.drain([this](const Decoded &decoded) {
+      auto entry = m_Entries.get(decoded.handle);
+      if (entry->released || !decoded.ok) {
+        finish_staging(*entry, 0);
+        entry->pixels = {};
+        if (entry->released) {
+          m_Entries.erase(decoded.handle);
+          return;
+        }
+        entry->state = e_Failed;
+        return;
+      }
+      entry->state = e_Uploading;
+      m_Ready.push_back(decoded.handle);
+    });
+    upload();
+    start_decodes();
+  }
+
+ private:
+  struct Entry {
+    TextureSource source;
+    State state{e_Queued};
+    bool released{false};
+    TextureHandle texture;
+    // Level and rows of it already sent to the texture, and the frame of
+    // the last ones
+    u32 uploadedLevel{0};
+    u32 uploadedRows{0};
+    u64 frameIndex{0};
+    u64 staging{0};
+    // Decode target when the ring is not mapped persistently
+    Memory::Vector<u8, Memory::e_Assets> pixels;
+  };
+
+  // Ring range of one texture, freed in allocation order once the frame
+  // which read it last has finished on the GPU.
+  struct Staging {
+    u64 offset{0};
+    u64 size{0};
+    bool done{false};
+    u64 frameIndex{0};
+  };
+
+  struct FrameFence {
+    GLsync fence{nullptr};
+    u64 frameIndex{0};
+  };
+
+  struct Decoded {
+    StreamHandle handle;
+    bool ok{false};
+  };
+
+  // Frames to wait before reusing memory when sync objects are not supported
+  static constexpr u64 MaxFramesInFlight = 3;
+  // Keeps every range aligned for any pixel format
+  static constexpr u64 StagingAlignment = 256;
+
+  void create_ring() {
+    glGenBuffers(1, &m_Buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffer);
+    if (glBufferStorage) {
+      GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)m_RingSize, nullptr,
+                      flags);
+      m_Mapped = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                        (GLsizeiptr)m_RingSize, flags);
+    } else {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)m_RingSize, nullptr,
+                   GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    Memory::track_gpu_buffer((i64)m_RingSize);
+
+    if (!m_Placeholder) {
+      u32 grey = 0xFF808080;
+      m_Placeholder = m_Context.create_texture(1, 1, &grey);
+      m_OwnsPlaceholder = true;
+    }
+  }
+
+  // Bump allocation in the ring, wraps to the start when the end is full.
+  bool allocate(u64 size, u64 &offset) {
+    if (m_Staging.empty()) m_Head = 0;
+    auto tail = m_Staging.empty() ? 0 : m_Staging.front().offset;
+    if (m_Staging.empty() || m_Head > tail) {
+      if (m_RingSize - m_Head < size) {
+        if (tail < size) return false;
+        m_Head = 0;
+      }
+    } else if (tail - m_Head < size) {
+      return false;
+    }
+
+    offset = m_Head;
+    m_Head += size;
+    return true;
+  }
+
+  void finish_staging(Entry &entry, u64 frameIndex) {
+    auto &staging = m_Staging[entry.staging - m_FirstStaging];
+    staging.done = true;
+    staging.frameIndex = frameIndex;
+  }
+
+  void reclaim_staging() {
+    while (!m_Fences.empty()) {
+      auto &frame = m_Fences.front();
+      if (frame.fence) {
+        auto result = glClientWaitSync(frame.fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+          break;
+        glDeleteSync(frame.fence);
+      } else if (m_FrameIndex - frame.frameIndex < MaxFramesInFlight) {
+        break;
+      }
+      m_CompletedFrame = frame.frameIndex;
+      m_Fences.pop_front();
+    }
+
+    while (!m_Staging.empty() && m_Staging.front().done &&
+           m_Staging.front().frameIndex <= m_CompletedFrame) {
+      m_Staging.pop_front();
+      ++m_FirstStaging;
+    }
+  }
+
+  void upload() {
+    m_UploadedBytes = 0;
+    auto budget = m_FrameBudget;
+    while (budget && !m_Ready.empty()) {
+      auto handle = m_Ready.front();
+      auto entry = m_Entries.get(handle);
+      if (!entry || entry->state != e_Uploading) {
+        m_Ready.pop_front();
+        continue;
+      }
+
+      auto &source = entry->source;
+      // Allocated while no unpack buffer is bound, a null pointer would
+      // be read as offset zero otherwise
+      if (!entry->texture)
+        entry->texture = m_Context.create_texture(
+            e_RGBA8, source.width, source.height, source.levels, {});
+
+      // Big textures go up in bands of rows over several frames, one
+      // level after the other
+      auto level = entry->uploadedLevel;
+      auto width = Mip::level_size(source.width, level);
+      auto height = Mip::level_size(source.height, level);
+      auto rowBytes = (u64)width * 4;
+      auto first = entry->uploadedRows;
+      auto rows = (u32)std::clamp<u64>(budget / rowBytes, 1, height - first);
+      auto bytes = rows * rowBytes;
+      auto start = Mip::level_offset(source.width, source.height, level) +
+                   first * rowBytes;
+      auto offset = m_Staging[entry->staging - m_FirstStaging].offset + start;
+
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffer);
+      if (!m_Mapped) {
+        // The range is not read by any pending GPU work, so there is
+        // nothing to synchronize with
+        auto dst = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!dst) {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+          break;
+        }
+        std::memcpy(dst, entry->pixels.data() + start, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      }
+      auto texture = m_Context.get_texture(entry->texture);
+      ::glBindTexture(GL_TEXTURE_2D, texture->texture);
+      ::glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, (GLint)first,
+                        (GLsizei)width, (GLsizei)rows, GL_RGBA,
+                        GL_UNSIGNED_BYTE, (const void *)(uintptr_t)offset);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      budget -= std::min(budget, bytes);
+      m_UploadedBytes += bytes;
+      entry->uploadedRows += rows;
+      entry->frameIndex = m_FrameIndex;
+      if (entry->uploadedRows == height) {
+        entry->uploadedRows = 0;
+        ++entry->uploadedLevel;
+      }
+      if (entry->uploadedLevel == source.levels) {
+        finish_staging(*entry, m_FrameIndex);
+        entry->pixels = {};
+        entry->state = e_Resident;
+        m_Ready.pop_front();
+      }
+    }
+
+    if (m_UploadedBytes) {
+      FrameFence frame;
+      frame.frameIndex = m_FrameIndex;
+      if (glFenceSync)
+        frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      m_Fences.push_back(frame);
+    }
+  }
+
+  // Oldest first, stops at the first texture which does not fit yet.
+  void start_decodes() {
+    while (!m_Queued.empty()) {
+      auto handle = m_Queued.front();
+      auto entry = m_Entries.get(handle);
+      if (!entry || entry->state != e_Queued) {
+        m_Queued.pop_front();
+        continue;
+      }
+
+      auto &source = entry->source;
+      auto pitch = source.width * 4;
+      auto bytes = Mip::level_offset(source.width, source.height,
+                                     source.levels);
+      auto size = (bytes + StagingAlignment - 1) & ~(StagingAlignment - 1);
+      if (size > m_RingSize || pitch / 4 != source.width) {
+        entry->state = e_Failed;
+        m_Queued.pop_front();
+        continue;
+      }
+
+      u64 offset;
+      if (!allocate(size, offset)) break;
+      entry->staging = m_FirstStaging + m_Staging.size();
+      m_Staging.push_back({offset, size});
+
+      u8 *pixels = m_Mapped + offset;
+      if (!m_Mapped) {
+        entry->pixels.resize(bytes);
+        pixels = entry->pixels.data();
+      }
+      entry->state = e_Decoding;
+      m_Queued.pop_front();
+
+      // Levels are made from the ones before them. The mapping is write
+      // only, so a chain is built in CPU memory and copied into it.
+      auto direct = !m_Mapped || source.levels == 1;
+      m_Decoding.fetch_add(1, std::memory_order_relaxed);
+      m_Jobs.run_background([this, handle, pixels, pitch, bytes, direct,
+                             source] {
+        Memory::Vector<u8, Memory::e_Assets> chain;
+        if (!direct) chain.resize(bytes);
+        auto out = direct ? pixels : chain.data();
+        auto ok = source.decode(out, pitch);
+        if (ok && source.levels > 1) {
+          Mip::generate(out, source.width, source.height, source.levels,
+                        source.filter, m_Jobs);
+          if (!direct) std::memcpy(pixels, out, bytes);
+        }
+        m_Decoded.push({handle, ok});
+        m_Decoding.fetch_sub(1, std::memory_order_release);
+      });
+    }
+  }
+
+  GLContext &m_Context;
+  JobSystem &m_Jobs;
+
+  SlotMap<Entry, StreamTag> m_Entries;
+  std::deque<StreamHandle> m_Queued;
+  std::deque<StreamHandle> m_Ready;
+  MpscQueue<Decoded> m_Decoded;
+  std::atomic<u32> m_Decoding{0};
+
+  GLuint m_Buffer{0};
+  u8 *m_Mapped{nullptr};
+  u64 m_RingSize;
+  u64 m_Head{0};
+  std::deque<Staging> m_Staging;
+  // Index of m_Staging.front() among all ranges ever allocated
+  u64 m_FirstStaging{0};
+  std::deque<FrameFence> m_Fences;
+  u64 m_FrameIndex{0};
+  u64 m_CompletedFrame{0};
+
+  u64 m_FrameBudget;
+  u64 m_UploadedBytes{0};
+  TextureHandle m_Placeholder;
+  bool m_OwnsPlaceholder{false};
+};
+}  // namespace Alien
+
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright(c) 2022 Furkan Fatih Cetindil
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this softwareand associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright noticeand this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifdef _WIN32
+#pragma once
+#endif
+#ifndef ALIEN_VERTEX_LAYOUT_HPP
+#define ALIEN_VERTEX_LAYOUT_HPP
+
+#include <cstddef>
+#include <iterator>
+
+#include "base.hpp"
+
+namespace Alien {
+// Attribute formats, each backend maps them to its own enums (GL type and
+// normalization, DXGI format).
+enum VertexFormat : u32 {
+  e_Float2,
+  e_Float3,
+  e_Float4,
+  // Converted to float without normalization, e.g. fixed point positions.
+  // GL converts in the fetch, HLSL takes an int2 and converts with float()
+  e_Short2,
+  e_Short2Norm,
+  e_UShort2Norm,
+  e_UByte4Norm
+};
+
+constexpr u32 vertex_format_components(VertexFormat format) {
+  switch (format) {
+    case e_Float3:
+      return 3;
+    case e_Float4:
+    case e_UByte4Norm:
+      return 4;
+    default:
+      return 2;
+  }
+}
+
+constexpr u32 vertex_format_size(VertexFormat format) {
+  switch (format) {
+    case e_Float2:
+      return 8;
+    case e_Float3:
+      return 12;
+    case e_Float4:
+      return 16;
+    default:
+      return 4;
+  }
+}
+
+struct VertexAttribute {
+  // HLSL semantic, GL uses the position in the layout as the location
+  const char *semantic;
+  VertexFormat format;
+  u32 offset;
+
+  // A field which does not have the size of its format stops the build.
+  template <typename Field>
+  static consteval VertexAttribute make(const char *semantic,
+                                        VertexFormat format,
+                                        std::size_t offset) {
+    if (sizeof(Field) != vertex_format_size(format))
+      throw "Vertex attribute format does not match its field!";
+    return {semantic, format, (u32)offset};
+  }
+};
+
+// Specialized next to every vertex type with a static constexpr array of
+// attributes, in shader location order:
+//
+//   template <>
+//   struct VertexLayout<MyVertex> {
+//     static constexpr VertexAttribute attributes[] = {
+//         ALIEN_VERTEX_ATTRIBUTE(MyVertex, position, "POS", e_Float2)};
+//   };
+template <typename Vertex>
+struct VertexLayout;
+
+#define ALIEN_VERTEX_ATTRIBUTE(Vertex, field, semantic, format)  \
+  ::Alien::VertexAttribute::make<decltype(Vertex::field)>(       \
+      semantic, ::Alien::format, offsetof(Vertex, field))
+
+template <typename Vertex>
+constexpr u32 vertex_attribute_count() {
+  return (u32)std::size(VertexLayout<Vertex>::attributes);
+}
+
+// Attributes are in offset order, do not overlap and fit in the vertex.
+template <typename Vertex>
+consteval bool is_valid_vertex_layout() {
+  u32 end = 0;
+  for (const auto &attribute : VertexLayout<Vertex>::attributes) {
+    if (attribute.offset < end) return false;
+    end = attribute.offset + vertex_format_size(attribute.format);
+  }
+  return end <= sizeof(Vertex);
+}
+}  // namespace Alien
+
+#endif
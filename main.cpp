@@ -4,9 +4,9 @@
 
 int main() {
   Alien::App app("Alien Test",800,600);
-  auto ctx = app.get_context();
+  auto &ctx = app.get_context();
 
-  Alien::Renderer renderer = Alien::Renderer::instance();
+  auto &renderer = Alien::Renderer::instance();
   renderer.set_context(&ctx);
 
   Alien::Sprite sprite;
@@ -0,0 +1,202 @@
+// Converts PNG files to the engine texture format (.ati) next to them, and
+// compares how fast both formats decode. With --bc1 or --bc3 they are block
+// compressed (.btx) instead, for upload as they are, and --mips adds every
+// mipmap level made with the box or Kaiser filter.
+//
+//   ati_convert [--tile N] [--bc1 | --bc3 [--mips box|kaiser]] [--bench]
+//               file.png...
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "ati.hpp"
+#include "bc.hpp"
+#include "mip.hpp"
+#include "png.hpp"
+
+namespace {
+using Bytes = Alien::Memory::Vector<u8, Alien::Memory::e_Assets>;
+using Clock = std::chrono::steady_clock;
+
+bool read_file(const std::string &path, Bytes &bytes) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f) return false;
+  bytes.resize((u64)f.tellg());
+  f.seekg(0, std::ios::beg);
+  return (bool)f.read((char *)bytes.data(), (std::streamsize)bytes.size());
+}
+
+bool write_file(const std::string &path, const Bytes &bytes) {
+  std::ofstream f(path, std::ios::binary);
+  return f && f.write((const char *)bytes.data(),
+                      (std::streamsize)bytes.size());
+}
+
+// Whole number in [min, max], false for anything else.
+bool parse_u32(const char *text, u32 min, u32 max, u32 &value) {
+  auto end = text + std::strlen(text);
+  auto [last, error] = std::from_chars(text, end, value);
+  return error == std::errc() && last == end && value >= min && value <= max;
+}
+
+// Milliseconds of the fastest of a few runs of f.
+template <typename F>
+double best_of(F &&f) {
+  double best = 1e30;
+  for (int i = 0; i < 5; ++i) {
+    auto start = Clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  u32 tileSize = Alien::Ati::DefaultTileSize;
+  auto format = Alien::e_RGBA8;
+  auto filter = Alien::Mip::e_Kaiser;
+  bool mips = false;
+  bool bench = false;
+  double pngTotal = 0, serialTotal = 0, parallelTotal = 0;
+  u64 pngBytes = 0, atiBytes = 0;
+  int failed = 0;
+
+  // Serial runs show the per-core speed, the shared pool the load time
+  Alien::JobSystem serial(0);
+  auto &jobs = Alien::JobSystem::instance();
+
+  auto usage = [] {
+    std::cerr << "usage: ati_convert [--tile N] [--bc1 | --bc3 "
+                 "[--mips box|kaiser]] [--bench] file.png...\n";
+    return 1;
+  };
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    std::string arg = argv[first];
+    if (arg == "--bench") {
+      bench = true;
+    } else if (arg == "--bc1" || arg == "--bc3") {
+      format = arg == "--bc1" ? Alien::e_BC1 : Alien::e_BC3;
+    } else if ((arg == "--mips" || arg == "--tile") && first + 1 == argc) {
+      std::cerr << arg << ": needs a value\n";
+      return usage();
+    } else if (arg == "--mips") {
+      std::string name = argv[++first];
+      if (name != "box" && name != "kaiser") {
+        std::cerr << name << ": unknown filter\n";
+        return usage();
+      }
+      mips = true;
+      filter = name == "box" ? Alien::Mip::e_Box : Alien::Mip::e_Kaiser;
+    } else if (arg == "--tile") {
+      // The encoder takes tiles of 16 to 4096 pixels
+      if (!parse_u32(argv[++first], 16, 4096, tileSize)) {
+        std::cerr << argv[first] << ": tile size must be 16 to 4096\n";
+        return usage();
+      }
+    } else {
+      std::cerr << arg << ": unknown option\n";
+      return usage();
+    }
+  }
+  if (mips && format == Alien::e_RGBA8) {
+    std::cerr << "--mips needs --bc1 or --bc3\n";
+    return usage();
+  }
+  if (first == argc) return usage();
+
+  for (int i = first; i < argc; ++i) {
+    std::string arg = argv[i];
+    Bytes png;
+    Alien::Image image;
+    if (!read_file(arg, png) ||
+        !Alien::Png::load(png.data(), png.size(), image)) {
+      std::cerr << arg << ": could not read the PNG\n";
+      ++failed;
+      continue;
+    }
+
+    auto pitch = image.width * 4;
+    if (format != Alien::e_RGBA8) {
+      auto width = image.width, height = image.height;
+      auto levels = mips ? Alien::Mip::level_count(width, height) : 1;
+      Bytes chain, btx;
+      auto convert = [&] {
+        chain.resize(Alien::Mip::level_offset(width, height, levels));
+        std::memcpy(chain.data(), image.pixels.data(), image.pixels.size());
+        Alien::Mip::generate(chain.data(), width, height, levels, filter,
+                             jobs);
+        Alien::Bc::encode_file(format, chain.data(), width, height, levels,
+                               btx, jobs);
+      };
+      convert();
+      auto out = arg.substr(0, arg.find_last_of('.')) + ".btx";
+      if (!write_file(out, btx)) {
+        std::cerr << out << ": could not write\n";
+        ++failed;
+        continue;
+      }
+      std::cout << out << ": " << png.size() << " -> " << btx.size()
+                << " bytes\n";
+      if (!bench) continue;
+      auto time = best_of(convert);
+      std::cout << "  " << levels << " levels encoded in " << time
+                << " ms on " << jobs.thread_count() << "\n";
+      continue;
+    }
+
+    Bytes ati;
+    if (!Alien::Ati::encode(image.pixels.data(), image.width, image.height,
+                            pitch, ati, tileSize)) {
+      std::cerr << arg << ": could not encode\n";
+      ++failed;
+      continue;
+    }
+    auto out = arg.substr(0, arg.find_last_of('.')) + ".ati";
+    if (!write_file(out, ati)) {
+      std::cerr << out << ": could not write\n";
+      ++failed;
+      continue;
+    }
+    std::cout << out << ": " << png.size() << " -> " << ati.size()
+              << " bytes\n";
+    if (!bench) continue;
+
+    Bytes pixels(image.pixels.size());
+    auto pngTime = best_of([&] {
+      Alien::Png::decode(png.data(), png.size(), pixels.data(), pitch);
+    });
+    auto serialTime = best_of([&] {
+      Alien::Ati::decode(ati.data(), ati.size(), pixels.data(), pitch,
+                         serial);
+    });
+    auto parallelTime = best_of([&] {
+      Alien::Ati::decode(ati.data(), ati.size(), pixels.data(), pitch, jobs);
+    });
+    if (pixels != image.pixels) {
+      std::cerr << out << ": decoded pixels differ\n";
+      ++failed;
+    }
+    std::cout << "  png " << pngTime << " ms, ati " << serialTime
+              << " ms on one thread, " << parallelTime << " ms on "
+              << jobs.thread_count() << "\n";
+    pngTotal += pngTime;
+    serialTotal += serialTime;
+    parallelTotal += parallelTime;
+    pngBytes += png.size();
+    atiBytes += ati.size();
+  }
+
+  if (bench && pngTotal > 0) {
+    std::cout << "total: png " << pngTotal << " ms (" << pngBytes
+              << " bytes), ati " << serialTotal << " ms on one thread, "
+              << parallelTotal << " ms on " << jobs.thread_count() << " ("
+              << atiBytes << " bytes)\n";
+  }
+  return failed ? 1 : 0;
+}
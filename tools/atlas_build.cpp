@@ -0,0 +1,158 @@
+// Packs sprite images into atlas pages (out_0.ati, out_1.ati, ...) and the
+// table which maps their names to the pages (out.atl). Directories are
+// walked, their images are named by the path below the directory without
+// the extension, with '/' separators; files given directly are named by
+// their file name without the extension.
+//
+//   atlas_build [--size N] [--padding N] [--rotate] [--no-trim] out
+//               sprites/ icon.png...
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "ati.hpp"
+#include "atlas.hpp"
+#include "jpeg.hpp"
+#include "png.hpp"
+
+namespace {
+using Bytes = Alien::Memory::Vector<u8, Alien::Memory::e_Assets>;
+namespace fs = std::filesystem;
+
+bool read_file(const fs::path &path, Bytes &bytes) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f) return false;
+  bytes.resize((u64)f.tellg());
+  f.seekg(0, std::ios::beg);
+  return (bool)f.read((char *)bytes.data(), (std::streamsize)bytes.size());
+}
+
+bool write_file(const std::string &path, std::span<const u8> bytes) {
+  std::ofstream f(path, std::ios::binary);
+  return f && f.write((const char *)bytes.data(),
+                      (std::streamsize)bytes.size());
+}
+
+// Whole number in [min, max], false for anything else.
+bool parse_u32(const char *text, u32 min, u32 max, u32 &value) {
+  auto end = text + std::strlen(text);
+  auto [last, error] = std::from_chars(text, end, value);
+  return error == std::errc() && last == end && value >= min && value <= max;
+}
+
+bool is_image(const fs::path &path) {
+  auto ext = path.extension().string();
+  return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".ati";
+}
+
+bool add_image(Alien::Atlas::Builder &builder, const fs::path &path,
+               const std::string &name) {
+  Bytes bytes;
+  Alien::Image image;
+  if (!read_file(path, bytes) ||
+      !(Alien::Png::load(bytes.data(), bytes.size(), image) ||
+        Alien::Ati::load(bytes.data(), bytes.size(), image) ||
+        Alien::Jpeg::load(bytes.data(), bytes.size(), image))) {
+    std::cerr << path.string() << ": could not read the image\n";
+    return false;
+  }
+  builder.add(name, std::move(image));
+  return true;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  Alien::Atlas::Builder::Options options;
+  Alien::Atlas::Builder builder;
+  std::string out;
+  u32 count = 0;
+  int failed = 0;
+
+  auto usage = [] {
+    std::cerr << "usage: atlas_build [--size N] [--padding N] [--rotate] "
+                 "[--no-trim] out images...\n";
+    return 1;
+  };
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    std::string arg = argv[first];
+    if (arg == "--rotate") {
+      options.rotate = true;
+    } else if (arg == "--no-trim") {
+      options.trim = false;
+    } else if ((arg == "--size" || arg == "--padding") &&
+               first + 1 == argc) {
+      std::cerr << arg << ": needs a value\n";
+      return usage();
+    } else if (arg == "--size") {
+      // Page sides are stored in 16 bits
+      if (!parse_u32(argv[++first], 1, 0xFFFF, options.pageSize)) {
+        std::cerr << argv[first] << ": page size must be 1 to 65535\n";
+        return usage();
+      }
+    } else if (arg == "--padding") {
+      if (!parse_u32(argv[++first], 0, 0xFFFF, options.padding)) {
+        std::cerr << argv[first] << ": padding must be 0 to 65535\n";
+        return usage();
+      }
+    } else {
+      std::cerr << arg << ": unknown option\n";
+      return usage();
+    }
+  }
+  if (first == argc) return usage();
+  out = argv[first];
+
+  for (int i = first + 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    fs::path path(arg);
+    if (!fs::is_directory(path)) {
+      failed += !add_image(builder, path, path.stem().string());
+      ++count;
+      continue;
+    }
+    for (auto &entry : fs::recursive_directory_iterator(path)) {
+      if (!entry.is_regular_file() || !is_image(entry.path())) continue;
+      auto name = entry.path().lexically_relative(path);
+      name.replace_extension();
+      failed += !add_image(builder, entry.path(), name.generic_string());
+      ++count;
+    }
+  }
+
+  if (count == 0) return usage();
+  if (failed) return 1;
+  if (!builder.build(options)) {
+    std::cerr << out << ": an image does not fit a page, or two names "
+                        "collide\n";
+    return 1;
+  }
+
+  auto &pages = builder.pages();
+  u64 used = 0, total = 0;
+  for (u32 i = 0; i < pages.size(); ++i) {
+    auto &page = pages[i];
+    Bytes ati;
+    auto path = out + "_" + std::to_string(i) + ".ati";
+    if (!Alien::Ati::encode(page.pixels.data(), page.width, page.height,
+                            page.width * 4, ati) ||
+        !write_file(path, ati)) {
+      std::cerr << path << ": could not write\n";
+      return 1;
+    }
+    total += (u64)page.width * page.height;
+    for (u64 p = 3; p < page.pixels.size(); p += 4) used += page.pixels[p] != 0;
+    std::cout << path << ": " << page.width << "x" << page.height << "\n";
+  }
+  if (!write_file(out + ".atl", builder.table())) {
+    std::cerr << out << ".atl: could not write\n";
+    return 1;
+  }
+  std::cout << out << ".atl: " << count << " images in " << pages.size()
+            << " pages, " << used * 100 / std::max<u64>(total, 1)
+            << "% of the pixels visible\n";
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Packs files into an asset pack (.pak). Directories are walked, their
+// files are named by the path below the directory with '/' separators.
+// Entries are compressed unless --raw is given; --bench reads the pack
+// back and prints the throughput. Block compressed textures (.btx) are
+// recorded with their format.
+//
+//   pack_build [--raw] [--bench] out.pak shaders textures/ui.ati...
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "bc.hpp"
+#include "pack.hpp"
+
+namespace {
+using Bytes = Alien::Memory::Vector<u8, Alien::Memory::e_Assets>;
+using Clock = std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+bool read_file(const fs::path &path, Bytes &bytes) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f) return false;
+  bytes.resize((u64)f.tellg());
+  f.seekg(0, std::ios::beg);
+  return (bool)f.read((char *)bytes.data(), (std::streamsize)bytes.size());
+}
+
+bool add_file(Alien::Pack::Builder &builder, const fs::path &path,
+              const std::string &name, bool compress) {
+  Bytes bytes;
+  if (!read_file(path, bytes)) {
+    std::cerr << path.string() << ": could not read\n";
+    return false;
+  }
+  Alien::Bc::Texture texture;
+  auto format = Alien::Bc::parse(bytes.data(), bytes.size(), texture)
+                    ? texture.format
+                    : Alien::e_UnknownFormat;
+  builder.add(name, bytes, compress, format);
+  return true;
+}
+
+// Milliseconds of the fastest of a few runs of f.
+template <typename F>
+double best_of(F &&f) {
+  double best = 1e30;
+  for (int i = 0; i < 5; ++i) {
+    auto start = Clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Reads every entry of the pack, once on one thread and once on the
+// shared pool. The file is in the page cache by then, so this is the
+// decompression cost; on a cold load the disk reads stored bytes only.
+int bench(const char *path) {
+  Alien::Pack::Archive archive;
+  if (!archive.open(path)) {
+    std::cerr << path << ": could not open\n";
+    return 1;
+  }
+
+  u64 size = 0, compressed = 0;
+  for (u32 i = 0; i < archive.entry_count(); ++i) {
+    size += archive.entry_size(i);
+    compressed += archive.entry_compressed(i);
+  }
+  std::cout << path << ": " << archive.entry_count() << " entries, "
+            << compressed << " compressed\n";
+
+  Bytes out;
+  auto read_all = [&](Alien::JobSystem &jobs) {
+    bool ok = true;
+    for (u32 i = 0; i < archive.entry_count(); ++i) {
+      out.resize(archive.entry_size(i));
+      ok &= archive.read(i, out.data(), jobs);
+    }
+    return ok;
+  };
+
+  Alien::JobSystem serial(0);
+  auto &jobs = Alien::JobSystem::instance();
+  if (!read_all(serial)) {
+    std::cerr << path << ": corrupt entries\n";
+    return 1;
+  }
+  std::error_code error;
+  auto stored = fs::file_size(path, error);
+  auto serialTime = best_of([&] { read_all(serial); });
+  auto parallelTime = best_of([&] { read_all(jobs); });
+  auto mb = (double)size / (1 << 20);
+  std::cout << "  " << mb << " MiB in " << (double)stored / (1 << 20)
+            << " MiB of file\n"
+            << "  one thread " << mb / serialTime * 1000 << " MiB/s, "
+            << jobs.thread_count() << " threads "
+            << mb / parallelTime * 1000 << " MiB/s\n";
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  auto usage = [] {
+    std::cerr << "usage: pack_build [--raw] [--bench] out.pak files or "
+                 "directories...\n";
+    return 1;
+  };
+  bool compress = true, benchmark = false;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    std::string arg = argv[first];
+    if (arg == "--raw") {
+      compress = false;
+    } else if (arg == "--bench") {
+      benchmark = true;
+    } else {
+      std::cerr << arg << ": unknown option\n";
+      return usage();
+    }
+  }
+  if (argc - first < 2) return usage();
+
+  const char *out = argv[first];
+  Alien::Pack::Builder builder;
+  int failed = 0;
+  for (int i = first + 1; i < argc; ++i) {
+    fs::path root = argv[i];
+    std::error_code error;
+    if (!fs::is_directory(root, error)) {
+      failed += !add_file(builder, root, root.filename().generic_string(),
+                          compress);
+      continue;
+    }
+    for (auto &entry : fs::recursive_directory_iterator(root, error)) {
+      if (!entry.is_regular_file()) continue;
+      auto name = fs::relative(entry.path(), root).generic_string();
+      failed += !add_file(builder, entry.path(), name, compress);
+    }
+  }
+
+  if (!builder.write(out)) {
+    std::cerr << out << ": could not write, or a name is used twice\n";
+    return 1;
+  }
+  std::cout << out << ": " << builder.entry_count() << " entries\n";
+  if (benchmark && bench(out)) return 1;
+  return failed ? 1 : 0;
+}